@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootcache.h"
+
+// Blocks are held in an open addressed table; when it fills, it is simply
+// emptied, since any block can be fetched again from the host (or from the
+// cache directory).
+
+#define TBL_SIZE 4096
+
+static struct
+  {
+    bool used;
+    uint8_t hash[BC_HASH_SZ];
+    uint64_t words[BC_WORDS];
+  } tbl[TBL_SIZE];
+
+static size_t nused;
+static char * cacheDir;
+
+// SHA-256 (FIPS 180-4)
+
+static const uint32_t sha256K[64] =
+  {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+  };
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256Block (uint32_t * h, const uint8_t * p)
+  {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i ++)
+      w[i] = ((uint32_t) p[4 * i] << 24) | ((uint32_t) p[4 * i + 1] << 16) |
+             ((uint32_t) p[4 * i + 2] << 8) | p[4 * i + 3];
+    for (int i = 16; i < 64; i ++)
+      {
+        uint32_t s0 = ROR32 (w[i - 15], 7) ^ ROR32 (w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR32 (w[i - 2], 17) ^ ROR32 (w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+      }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for (int i = 0; i < 64; i ++)
+      {
+        uint32_t t1 = k + (ROR32 (e, 6) ^ ROR32 (e, 11) ^ ROR32 (e, 25)) +
+                      ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+        uint32_t t2 = (ROR32 (a, 2) ^ ROR32 (a, 13) ^ ROR32 (a, 22)) +
+                      ((a & b) ^ (a & c) ^ (b & c));
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+      }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+  }
+
+// The digest of the block's words, each as 8 bytes big-endian
+void bootcache_hash (const uint64_t * block, uint8_t * hash)
+  {
+    uint32_t h[8] =
+      {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+      };
+    // 512 bytes of message, 8 blocks exactly, then a block of padding
+    uint8_t buf[64];
+    for (int i = 0; i < BC_WORDS; i ++)
+      {
+        for (int j = 0; j < 8; j ++)
+          buf[(i % 8) * 8 + j] = (uint8_t) (block[i] >> (56 - 8 * j));
+        if (i % 8 == 7)
+          sha256Block (h, buf);
+      }
+    uint64_t bits = BC_WORDS * 64;
+    memset (buf, 0, sizeof (buf));
+    buf[0] = 0x80;
+    for (int j = 0; j < 8; j ++)
+      buf[56 + j] = (uint8_t) (bits >> (56 - 8 * j));
+    sha256Block (h, buf);
+    for (int i = 0; i < 8; i ++)
+      for (int j = 0; j < 4; j ++)
+        hash[4 * i + j] = (uint8_t) (h[i] >> (24 - 8 * j));
+  }
+
+static int probe (const uint8_t * hash)
+  {
+    uint32_t x;
+    memcpy (& x, hash, sizeof (x));
+    int i = (int) (x % TBL_SIZE);
+    while (tbl[i].used && memcmp (tbl[i].hash, hash, BC_HASH_SZ))
+      i = (i + 1) % TBL_SIZE;
+    return i;
+  }
+
+static void blockPath (char * path, size_t sz, const uint8_t * hash)
+  {
+    char hex[2 * BC_HASH_SZ + 1];
+    for (int i = 0; i < BC_HASH_SZ; i ++)
+      sprintf (hex + 2 * i, "%02x", hash[i]);
+    snprintf (path, sz, "%s/%s", cacheDir, hex);
+  }
+
+bool bootcache_get (const uint8_t * hash, uint64_t * block)
+  {
+    int i = probe (hash);
+    if (tbl[i].used)
+      {
+        memcpy (block, tbl[i].words, sizeof (tbl[i].words));
+        return true;
+      }
+    if (! cacheDir)
+      return false;
+
+    char path[4096];
+    blockPath (path, sizeof (path), hash);
+    FILE * f = fopen (path, "rb");
+    if (! f)
+      return false;
+    size_t n = fread (block, sizeof (uint64_t), BC_WORDS, f);
+    fclose (f);
+    uint8_t check[BC_HASH_SZ];
+    if (n != BC_WORDS)
+      return false;
+    bootcache_hash (block, check);
+    if (memcmp (check, hash, BC_HASH_SZ))
+      return false;
+    bootcache_put (hash, block);
+    return true;
+  }
+
+void bootcache_put (const uint8_t * hash, const uint64_t * block)
+  {
+    if (nused >= TBL_SIZE * 3 / 4)
+      bootcache_clear ();
+    int i = probe (hash);
+    if (tbl[i].used)
+      return;
+    tbl[i].used = true;
+    memcpy (tbl[i].hash, hash, BC_HASH_SZ);
+    memcpy (tbl[i].words, block, sizeof (tbl[i].words));
+    nused ++;
+
+    if (! cacheDir)
+      return;
+    char path[4096];
+    blockPath (path, sizeof (path), hash);
+    FILE * f = fopen (path, "wb");
+    if (! f)
+      return;
+    fwrite (block, sizeof (uint64_t), BC_WORDS, f);
+    fclose (f);
+  }
+
+int bootcache_set_dir (const char * dir)
+  {
+    free (cacheDir);
+    cacheDir = dir ? strdup (dir) : NULL;
+    return dir && ! cacheDir ? -1 : 0;
+  }
+
+const char * bootcache_dir (void)
+  {
+    return cacheDir;
+  }
+
+void bootcache_clear (void)
+  {
+    memset (tbl, 0, sizeof (tbl));
+    nused = 0;
+  }
+
+size_t bootcache_count (void)
+  {
+    return nused;
+  }
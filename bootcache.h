@@ -0,0 +1,38 @@
+// Content addressed cache of bootload image blocks
+//
+// Images are handled in blocks of 64 words, matching the mod 64 padding of
+// the load_fnp_ segment; each block is known by the SHA-256 digest of its
+// contents, so a cached block can be trusted to be the one asked for.
+// For a delta boot the host sends a manifest of block hashes, the FNP asks
+// only for the blocks it does not already hold, and the host sends those.
+//
+//   manifest  0330 1 nblk(2) nwords(4) addr(4) hash(32) * nblk
+//   need      0330 2 nblk(2) bitmap, bit set (msb first) = send the block
+//   block     0330 3 index(2) 64 words, in the negotiated word36 encoding
+//
+// Multi-byte fields are big-endian. The image is loaded at FNP word 'addr',
+// two 18-bit words for each 36-bit word. A digest is taken over the
+// block's words, each as 8 bytes big-endian.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BC_MAGIC     0330
+#define BC_MANIFEST  1
+#define BC_NEED      2
+#define BC_BLOCK     3
+#define BC_WORDS     64
+#define BC_MAXBLK    256   // all of FNP memory
+#define BC_HASH_SZ   32
+
+void bootcache_hash (const uint64_t * block, uint8_t * hash);
+
+bool bootcache_get (const uint8_t * hash, uint64_t * block);
+void bootcache_put (const uint8_t * hash, const uint64_t * block);
+
+// Also keep blocks as files in dir; NULL to stop
+int bootcache_set_dir (const char * dir);
+const char * bootcache_dir (void);
+void bootcache_clear (void);
+size_t bootcache_count (void);
@@ -0,0 +1,257 @@
+#include <unistd.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "dn6600.h"
+#include "snapshot.h"
+#include "checkpoint.h"
+
+// Instructions between looks at the clock
+#define CKPT_POLL 100000
+
+static struct
+  {
+    uint32_t interval;    // seconds; 0 is off
+    uint32_t retain;
+    char path[PATH_MAX];
+    uint64_t seq;         // number of the next checkpoint
+    pid_t child;          // writer in progress
+    uint64_t childSeq;
+    time_t last;
+    uint64_t taken;
+    uint64_t failed;
+    uint64_t skipped;     // interval came round with a writer still going
+    double pauseUs;       // last fork
+    double maxPauseUs;
+  } ckpt =
+  {
+    .retain = 2,
+    .path = "dn6600",
+  };
+
+static void ckptName (char * buf, size_t sz, uint64_t seq, bool tmp)
+  {
+    snprintf (buf, sz, "%s.%llu.snap%s", ckpt.path, (unsigned long long) seq,
+              tmp ? ".tmp" : "");
+  }
+
+static double nowUs (void)
+  {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, & ts);
+    return (double) ts.tv_sec * 1e6 + (double) ts.tv_nsec / 1e3;
+  }
+
+// Collect a finished writer and drop the checkpoint that falls out of the
+// retention window.
+static void ckptReap (bool block)
+  {
+    if (! ckpt.child)
+      return;
+    int status;
+    pid_t pid = waitpid (ckpt.child, & status, block ? 0 : WNOHANG);
+    if (pid == 0)
+      return;
+    ckpt.child = 0;
+    if (pid < 0 || ! WIFEXITED (status) || WEXITSTATUS (status) != 0)
+      {
+        ckpt.failed ++;
+        sim_printf ("checkpoint %llu failed\n",
+                    (unsigned long long) ckpt.childSeq);
+        return;
+      }
+    ckpt.taken ++;
+    if (ckpt.retain && ckpt.childSeq >= ckpt.retain)
+      {
+        char name[PATH_MAX + 32];
+        ckptName (name, sizeof (name), ckpt.childSeq - ckpt.retain, false);
+        unlink (name);
+      }
+  }
+
+static void ckptTake (void)
+  {
+    char tmp[PATH_MAX + 32], name[PATH_MAX + 32];
+    uint64_t seq = ckpt.seq;
+    ckptName (tmp, sizeof (tmp), seq, true);
+    ckptName (name, sizeof (name), seq, false);
+
+    double t0 = nowUs ();
+    pid_t pid = fork ();
+    if (pid == 0)
+      {
+        // Child: only this thread exists; write and leave without running
+        // any of the parent's exit handlers.
+        signal (SIGINT, SIG_IGN);
+        if (snapshot_save (tmp) != SCPE_OK || rename (tmp, name) != 0)
+          {
+            unlink (tmp);
+            _exit (1);
+          }
+        _exit (0);
+      }
+    ckpt.pauseUs = nowUs () - t0;
+    if (ckpt.pauseUs > ckpt.maxPauseUs)
+      ckpt.maxPauseUs = ckpt.pauseUs;
+    if (pid < 0)
+      {
+        ckpt.failed ++;
+        return;
+      }
+    ckpt.child = pid;
+    ckpt.childSeq = seq;
+    ckpt.seq ++;
+  }
+
+static t_stat ckptSvc (UNIT * uptr)
+  {
+    ckptReap (false);
+    // A restored snapshot brings this event back whatever INTERVAL is here
+    if (! ckpt.interval)
+      return SCPE_OK;
+    // Requeue before forking, so the snapshot carries the next poll
+    sim_activate (uptr, CKPT_POLL);
+    time_t now = time (NULL);
+    if (now - ckpt.last < (time_t) ckpt.interval)
+      return SCPE_OK;
+    ckpt.last = now;
+    if (ckpt.child)
+      {
+        ckpt.skipped ++;
+        return SCPE_OK;
+      }
+    ckptTake ();
+    return SCPE_OK;
+  }
+
+static UNIT ckptUnit =
+  {
+    UDATA (& ckptSvc, 0, 0), 0, 0, 0, 0, 0, NULL, NULL
+  };
+
+static t_stat ckptReset (UNUSED DEVICE * dptr)
+  {
+    sim_cancel (& ckptUnit);
+    if (ckpt.interval)
+      {
+        ckpt.last = time (NULL);
+        sim_activate (& ckptUnit, CKPT_POLL);
+      }
+    return SCPE_OK;
+  }
+
+static t_stat ckptSetInterval (UNUSED UNIT * uptr, UNUSED int32 value,
+                               char * cptr, UNUSED void * desc)
+  {
+    if (! cptr)
+      return SCPE_ARG;
+    t_stat rc;
+    uint32_t n = (uint32_t) get_uint (cptr, 10, 86400, & rc);
+    if (rc != SCPE_OK)
+      return rc;
+    ckpt.interval = n;
+    return ckptReset (& ckptDev);
+  }
+
+static t_stat ckptSetRetain (UNUSED UNIT * uptr, UNUSED int32 value,
+                             char * cptr, UNUSED void * desc)
+  {
+    if (! cptr)
+      return SCPE_ARG;
+    t_stat rc;
+    uint32_t n = (uint32_t) get_uint (cptr, 10, 1000, & rc);
+    if (rc != SCPE_OK)
+      return rc;
+    ckpt.retain = n;
+    return SCPE_OK;
+  }
+
+static t_stat ckptSetPath (UNUSED UNIT * uptr, UNUSED int32 value,
+                           char * cptr, UNUSED void * desc)
+  {
+    if (! cptr || ! * cptr || strlen (cptr) >= sizeof (ckpt.path))
+      return SCPE_ARG;
+    ckptReap (true);
+    strcpy (ckpt.path, cptr);
+    ckpt.seq = 0;
+    return SCPE_OK;
+  }
+
+static t_stat ckptShowConfig (FILE * st, UNUSED UNIT * uptr,
+                              UNUSED int32 val, UNUSED void * desc)
+  {
+    if (ckpt.interval)
+      fprintf (st, "interval=%us", ckpt.interval);
+    else
+      fprintf (st, "off");
+    fprintf (st, ", retain=%u, path=%s", ckpt.retain, ckpt.path);
+    return SCPE_OK;
+  }
+
+static t_stat ckptShowStats (FILE * st, UNUSED UNIT * uptr,
+                             UNUSED int32 val, UNUSED void * desc)
+  {
+    ckptReap (false);
+    fprintf (st, "taken:     %llu\n", (unsigned long long) ckpt.taken);
+    fprintf (st, "failed:    %llu\n", (unsigned long long) ckpt.failed);
+    fprintf (st, "skipped:   %llu\n", (unsigned long long) ckpt.skipped);
+    fprintf (st, "writing:   %s\n", ckpt.child ? "yes" : "no");
+    fprintf (st, "pause:     %.0f us last, %.0f us max\n", ckpt.pauseUs,
+             ckpt.maxPauseUs);
+    return SCPE_OK;
+  }
+
+// Take one now, outside the schedule
+static t_stat ckptSetNow (UNUSED UNIT * uptr, UNUSED int32 value,
+                          UNUSED char * cptr, UNUSED void * desc)
+  {
+    ckptReap (true);
+    uint64_t failed = ckpt.failed;
+    ckptTake ();
+    ckptReap (true);
+    return ckpt.failed != failed ? SCPE_IERR : SCPE_OK;
+  }
+
+static MTAB ckptMod [] =
+  {
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "INTERVAL", ckptSetInterval, NULL, NULL, "Seconds between checkpoints; 0 turns them off" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "RETAIN", ckptSetRetain, NULL, NULL, "Number of checkpoints to keep; 0 keeps them all" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR | MTAB_NC, 0, NULL, "PATH", ckptSetPath, NULL, NULL, "Checkpoint file name prefix" },
+    { MTAB_XTD | MTAB_VDV, 0, "CONFIG", NULL, NULL, ckptShowConfig, NULL, "Checkpoint settings" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "STATS", NULL, NULL, ckptShowStats, NULL, "Checkpoint counters and fork pause" },
+    { MTAB_XTD | MTAB_VDV, 0, NULL, "NOW", ckptSetNow, NULL, NULL, "Take a checkpoint and wait for it" },
+    { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+  };
+
+DEVICE ckptDev =
+  {
+    "CKPT",           /* name */
+    & ckptUnit,       /* units */
+    NULL,             /* registers */
+    ckptMod,          /* modifiers */
+    1,                /* #units */
+    10,               /* address radix */
+    1,                /* address width */
+    1,                /* address increment */
+    10,               /* data radix */
+    1,                /* data width */
+    NULL,             /* examine routine */
+    NULL,             /* deposit routine */
+    ckptReset,        /* reset routine */
+    NULL,             /* boot routine */
+    NULL,             /* attach routine */
+    NULL,             /* detach routine */
+    NULL,             /* context */
+    0,                /* flags */
+    0,                /* debug control flags */
+    NULL,             /* debug flag names */
+    NULL,             /* memory size change */
+    NULL,             /* logical name */
+    NULL,             // attach help
+    NULL,             // help
+    NULL,             // help context
+    NULL,             // device description
+  };
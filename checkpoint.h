@@ -0,0 +1,12 @@
+// Periodic checkpoints
+//
+// Every INTERVAL seconds the emulator forks at an instruction boundary and
+// the child writes a snapshot (see snapshot.h) while the parent carries on,
+// so the pause is the cost of the fork rather than of the write. The last
+// RETAIN snapshots are kept, as <PATH>.<n>.snap.
+//
+//   SET CKPT PATH=/var/fnp/a
+//   SET CKPT RETAIN=4
+//   SET CKPT INTERVAL=60
+
+extern DEVICE ckptDev;
@@ -1,8 +1,23 @@
 #include <unistd.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 #include "dn6600.h"
+#include "dn6600_caf.h"
 #include "coupler.h"
+#include "ipc.h"
 #include "udplib.h"
+#include "shmlib.h"
+#include "rlink.h"
+#include "pack36.h"
+#include "bootcache.h"
+#include "replay.h"
 
 // dd01 pg 5-14 DATANET FNP Interface
 //
@@ -36,13 +51,43 @@ static struct
         word1 BT_INH; // Bootload Inhibit  60132445 pg 33
         word1 STORED_BOOT; // 60132445 pg 33
       } task_register;
+    enum { transportUDP, transportSHM, transportDirect } transport;
     int32 link;
-  } coupler_data;
+    coupler_direct_fn directSend; // transportDirect: hand packets to the host
+    void * directCtx;
+    rlink * rl;          // reliable framing, if enabled
+    int lossPercent;     // injected loss for testing
+    volatile int peerCaps; // as announced by the other end
+    volatile bool capsAgreed; // the exchange has been acknowledged
+    pthread_mutex_t txLock;
+  } coupler_data = { .link = NOLINK, .txLock = PTHREAD_MUTEX_INITIALIZER };
+
+// SET COUPLER RELIABLE frames UDP traffic with sequence numbers and
+// selective acks (see rlink.h); the peer must do the same. shm: is
+// reliable already and is never framed.
+#define UNIT_V_RELIABLE (UNIT_V_UF + 0)
+#define UNIT_RELIABLE   (1u << UNIT_V_RELIABLE)
+
+// SET COUPLER NOPACK36 stops us offering the packed word36 encoding.
+#define UNIT_V_NOPACK   (UNIT_V_UF + 1)
+#define UNIT_NOPACK     (1u << UNIT_V_NOPACK)
+
+static void udpXmit (void * ctx, uint8_t * frame, int sz);
+static void rxDeliver (void * ctx, uint8_t * data, int sz);
+
+static void rxInit (void);
+static void rxStart (void);
+static void rxStop (void);
+static void rxKick (void);
+static void rxDirect (bool on);
 
 static t_stat couplerReset (DEVICE *dptr)
   {
     coupler_data.task_register.BT_INH = 0;
     coupler_data.task_register.STORED_BOOT = 0;
+    // Replay draws on the receive pool with nothing attached
+    if (! (dptr -> units -> flags & UNIT_ATT))
+      rxInit ();
     return SCPE_OK;
   }
 
@@ -54,6 +99,7 @@ static t_stat couplerAttach (UNIT * uptr, char * cptr)
     //
     //    ATTACH -p MIn COMnn          - attach MIn to a physical COM port
     //    ATTACH MIn llll:w.x.y.z:rrrr - connect via UDP to a remote simh host
+    //    ATTACH COUPLER shm:name      - share memory with a co-located host
     //
     t_stat ret;
     char * pfn;
@@ -72,16 +118,47 @@ static t_stat couplerAttach (UNIT * uptr, char * cptr)
       return SCPE_MEM;
     strncpy (pfn, cptr, CBUFSIZE);
 
-    // Create the UDP connection.
-    ret = udp_create (cptr, & coupler_data.link);
-    if (ret != SCPE_OK)
+    rxInit ();
+    if (strncmp (cptr, "shm:", 4) == 0)
       {
-        free (pfn);
-        return ret;
-      };
+        // The shared memory rings are read directly; no receive thread.
+        if (shmlib_create (cptr + 4, shmSideFNP, & coupler_data.link))
+          {
+            free (pfn);
+            return SCPE_OPENERR;
+          }
+        coupler_data.transport = transportSHM;
+      }
+    else
+      {
+        // Create the UDP connection.
+        ret = udp_create (cptr, & coupler_data.link);
+        if (ret != SCPE_OK)
+          {
+            free (pfn);
+            return ret;
+          };
+        coupler_data.transport = transportUDP;
+        if (uptr -> flags & UNIT_RELIABLE)
+          {
+            coupler_data.rl = rlink_create (udpXmit, rxDeliver, NULL);
+            if (! coupler_data.rl)
+              {
+                udp_release (coupler_data.link);
+                free (pfn);
+                return SCPE_MEM;
+              }
+            rlink_set_loss (coupler_data.rl, coupler_data.lossPercent);
+          }
+      }
     // Reset the flags and start polling ...
     uptr -> flags |= UNIT_ATT;
     uptr -> filename = pfn;
+    coupler_data.peerCaps = 0;
+    coupler_data.capsAgreed = false;
+    if (coupler_data.transport == transportUDP)
+      rxStart ();
+    announce_coupler ();
     //return couplerReset (find_dev_from_unit(uptr));
     return SCPE_OK;
   }
@@ -96,10 +173,29 @@ t_stat couplerDetach (UNIT * uptr)
     t_stat ret;
     if ((uptr -> flags & UNIT_ATT) == 0)
       return SCPE_OK;
-    ret = udp_release (coupler_data.link);
+    if (coupler_data.transport == transportSHM)
+      {
+        shmlib_shutdown (coupler_data.link);
+        ret = shmlib_release (coupler_data.link) ? SCPE_IERR : SCPE_OK;
+      }
+    else if (coupler_data.transport == transportDirect)
+      {
+        rxDirect (false);
+        coupler_data.directSend = NULL;
+        ret = SCPE_OK;
+      }
+    else
+      {
+        rxStop ();
+        rlink_destroy (coupler_data.rl);
+        coupler_data.rl = NULL;
+        ret = udp_release (coupler_data.link);
+      }
     if (ret != SCPE_OK)
       return ret;
     coupler_data.link = NOLINK;
+    coupler_data.peerCaps = 0;
+    coupler_data.capsAgreed = false;
     uptr -> flags &= ~UNIT_ATT;
     free (uptr -> filename);
     uptr -> filename = NULL;
@@ -119,8 +215,96 @@ static UNIT couplerUnit =
     UDATA (NULL, UNIT_FIX|UNIT_BINK, MEM_SIZE), 0, 0, 0, 0, 0, NULL, NULL
   };
 
+static t_stat couplerSetLoss (UNUSED UNIT * uptr, UNUSED int32 value,
+                              char * cptr, UNUSED void * desc)
+  {
+    if (! cptr)
+      return SCPE_ARG;
+    t_stat rc;
+    int n = (int) get_uint (cptr, 10, 100, & rc);
+    if (rc != SCPE_OK)
+      return rc;
+    coupler_data.lossPercent = n;
+    if (coupler_data.rl)
+      rlink_set_loss (coupler_data.rl, n);
+    return SCPE_OK;
+  }
+
+static t_stat couplerShowLoss (FILE * st, UNUSED UNIT * uptr,
+                               UNUSED int32 val, UNUSED void * desc)
+  {
+    fprintf (st, "loss=%d%%", coupler_data.lossPercent);
+    return SCPE_OK;
+  }
+
+static t_stat couplerShowStats (FILE * st, UNUSED UNIT * uptr,
+                                UNUSED int32 val, UNUSED void * desc)
+  {
+    if (! coupler_data.rl)
+      {
+        fprintf (st, "reliable framing not active\n");
+        return SCPE_OK;
+      }
+    rlink_stats s;
+    rlink_get_stats (coupler_data.rl, & s);
+    fprintf (st, "sent:      %llu frames, %llu bytes\n",
+             (unsigned long long) s.framesSent, (unsigned long long) s.bytesSent);
+    fprintf (st, "resent:    %llu on timeout, %llu on selective ack\n",
+             (unsigned long long) s.retransmits, (unsigned long long) s.fastRetransmits);
+    fprintf (st, "received:  %llu frames, %llu duplicate, %llu out of order\n",
+             (unsigned long long) s.framesReceived, (unsigned long long) s.duplicates,
+             (unsigned long long) s.outOfOrder);
+    fprintf (st, "delivered: %llu packets, %llu bytes\n",
+             (unsigned long long) s.delivered, (unsigned long long) s.bytesDelivered);
+    fprintf (st, "acks:      %llu sent, %llu received\n",
+             (unsigned long long) s.acksSent, (unsigned long long) s.acksReceived);
+    fprintf (st, "dropped:   %llu (injected loss)\n",
+             (unsigned long long) s.injectedLoss);
+    fprintf (st, "epochs:    %llu syns sent, %llu peer restarts, %llu stale frames\n",
+             (unsigned long long) s.synsSent, (unsigned long long) s.restarts,
+             (unsigned long long) s.stale);
+    if (s.elapsed > 0)
+      fprintf (st, "rate:      %.0f bytes/s out, %.0f bytes/s in\n",
+               (double) s.bytesSent / s.elapsed, (double) s.bytesDelivered / s.elapsed);
+    return SCPE_OK;
+  }
+
+static t_stat couplerSetCache (UNUSED UNIT * uptr, UNUSED int32 value,
+                               char * cptr, UNUSED void * desc)
+  {
+    if (! cptr || ! * cptr)
+      return SCPE_ARG;
+    if (bootcache_set_dir (cptr))
+      return SCPE_MEM;
+    return SCPE_OK;
+  }
+
+static t_stat couplerShowCache (FILE * st, UNUSED UNIT * uptr,
+                                UNUSED int32 val, UNUSED void * desc)
+  {
+    fprintf (st, "bootcache=%s, %lu blocks",
+             bootcache_dir () ? bootcache_dir () : "(memory only)",
+             (unsigned long) bootcache_count ());
+    return SCPE_OK;
+  }
+
+static t_stat couplerClearCache (UNUSED UNIT * uptr, UNUSED int32 value,
+                                 UNUSED char * cptr, UNUSED void * desc)
+  {
+    bootcache_clear ();
+    return bootcache_set_dir (NULL) ? SCPE_IERR : SCPE_OK;
+  }
+
 static MTAB couplerMod [] =
   {
+    { UNIT_RELIABLE, UNIT_RELIABLE, "RELIABLE", "RELIABLE", NULL, NULL, NULL, "Frame UDP traffic with sequence numbers and acks" },
+    { UNIT_RELIABLE, 0, "UNRELIABLE", "UNRELIABLE", NULL, NULL, NULL, "Send bare UDP datagrams" },
+    { UNIT_NOPACK, 0, "PACK36", "PACK36", NULL, NULL, NULL, "Offer the packed word36 encoding" },
+    { UNIT_NOPACK, UNIT_NOPACK, "NOPACK36", "NOPACK36", NULL, NULL, NULL, "Always use 8 bytes per word36" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, "LOSS", "LOSS", couplerSetLoss, couplerShowLoss, NULL, "Percentage of outgoing frames to drop, for testing" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR | MTAB_NC, 0, "BOOTCACHE", "BOOTCACHE", couplerSetCache, couplerShowCache, NULL, "Directory for the delta boot block cache" },
+    { MTAB_XTD | MTAB_VDV, 0, NULL, "NOBOOTCACHE", couplerClearCache, NULL, NULL, "Empty the delta boot block cache" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "STATS", NULL, NULL, couplerShowStats, NULL, "Reliable framing counters" },
     { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
   };
 
@@ -154,22 +338,765 @@ DEVICE couplerDev =
     NULL,             // device description
   };
 
-#define psz 17000
-static uint8_t pkt[psz];
+#define psz COUPLER_PKT_SZ
 
-// warning: returns ptr to static buffer
-int poll_coupler (uint8_t * * pktp)
+static int ourCaps (void)
+  {
+    return (couplerUnit.flags & UNIT_NOPACK) ? 0 : capPack36;
+  }
+
+// Capabilities packets keep their place among the data (see ipc.h): with
+// RELIABLE they are framed like it. Returns true if the packet went.
+static bool sendCaps (int kind)
+  {
+    uint8_t caps[capsSz] = { capsMagic, capsVersion, (uint8_t) ourCaps (), (uint8_t) kind };
+    if (coupler_data.rl)
+      {
+        // Answers come from the receive thread, which must not wait on
+        // the window it is draining
+        if (rlink_send_nowait (coupler_data.rl, caps, capsSz))
+          return false;
+        rxKick ();
+        return true;
+      }
+    if (coupler_data.transport == transportSHM)
+      return dn_shm_send (coupler_data.link, caps, capsSz) == 0;
+    if (coupler_data.transport == transportDirect)
+      {
+        coupler_data.directSend (coupler_data.directCtx, caps, capsSz);
+        return true;
+      }
+    pthread_mutex_lock (& coupler_data.txLock);
+    int rc = dn_udp_send (coupler_data.link, caps, capsSz, PFLG_FINAL);
+    pthread_mutex_unlock (& coupler_data.txLock);
+    return rc == 0;
+  }
+
+// Once agreed there is nothing to announce; starting over under traffic
+// would have packets cross the switch back.
+void announce_coupler (void)
+  {
+    if ((couplerUnit.flags & UNIT_ATT) == 0 || coupler_data.capsAgreed)
+      return;
+    sendCaps (capsAnnounce);
+  }
+
+// Returns true if the packet was a capabilities packet, and consumes it
+static bool capsInput (uint8_t * data, int sz)
+  {
+    if (sz < capsSz || data[0] != capsMagic || data[1] != capsVersion)
+      return false;
+    coupler_data.peerCaps = data[2];
+    switch (data[3])
+      {
+        case capsAnnounce:
+          coupler_data.capsAgreed = false;
+          sendCaps (capsReply);
+          break;
+        case capsReply:
+          coupler_data.capsAgreed = sendCaps (capsAck);
+          break;
+        case capsAck:
+          coupler_data.capsAgreed = true;
+          break;
+      }
+    sim_debug (DBG_DEBUG, & couplerDev, "peer capabilities %o, %s\n", data[2],
+               coupler_data.capsAgreed ? "agreed" : "not agreed");
+    return true;
+  }
+
+bool coupler_packed (void)
+  {
+    return coupler_data.capsAgreed &&
+           (ourCaps () & coupler_data.peerCaps & capPack36) != 0;
+  }
+
+// Word36 payloads, in whichever encoding has been negotiated. Each returns
+// the number of bytes used.
+
+size_t coupler_size36 (size_t n)
+  {
+    return coupler_packed () ? pack36_size (n) : n * sizeof (word36);
+  }
+
+size_t coupler_put36 (uint8_t * dst, const word36 * src, size_t n)
+  {
+    if (coupler_packed ())
+      return pack36 (dst, src, n);
+    memcpy (dst, src, n * sizeof (word36));
+    return n * sizeof (word36);
+  }
+
+size_t coupler_get36 (word36 * dst, const uint8_t * src, size_t n)
+  {
+    if (coupler_packed ())
+      return unpack36 (dst, src, n);
+    memcpy (dst, src, n * sizeof (word36));
+    return n * sizeof (word36);
+  }
+
+// Receive queue
+//
+// A receive thread drains the coupler link and hands datagrams to the CPU
+// side through a small ring; the CPU side blocks on a condition variable
+// rather than sleeping between polls. The receive thread blocks in poll()
+// on the link's socket and a wakeup descriptor (an eventfd, or a pipe off
+// Linux), which rxStop rings to shut it down. With RELIABLE, the poll times
+// out when rlink next has something to resend.
+//
+// Packets live in a preallocated pool of reference counted buffers, so the
+// CPU side can hold several at once and nothing is copied on the way in.
+// The receive thread takes buffers from the pool, and publishes what it
+// receives into them, a batch at a time; a batch is a single recvmmsg.
+
+#define RXPOOL 64
+#define RX_BATCH 16
+
+static coupler_buf rxPool[RXPOOL];
+
+// The packet last handed out by poll_coupler/wait_coupler
+static coupler_buf * lastPkt;
+
+static struct
+  {
+    coupler_buf * ring[RXPOOL];
+    uint head, tail; // head == tail: empty
+    coupler_buf * freeList;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t bufFree;
+    pthread_t thread;
+    volatile bool running;
+    volatile bool direct; // waits block for coupler_inject
+    int sock;            // the link's socket (udp_fd)
+    int wake[2];         // read and write ends; the same eventfd on Linux
+    volatile bool idle;  // the thread may wait with no timeout
+  } rxq =
+  {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .notEmpty = PTHREAD_COND_INITIALIZER,
+    .bufFree = PTHREAD_COND_INITIALIZER,
+    .sock = -1,
+    .wake = { -1, -1 },
+  };
+
+static int wakeOpen (void)
+  {
+#ifdef __linux__
+    rxq.wake[0] = rxq.wake[1] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return rxq.wake[0] < 0 ? -1 : 0;
+#else
+    if (pipe (rxq.wake))
+      return -1;
+    fcntl (rxq.wake[0], F_SETFL, O_NONBLOCK);
+    fcntl (rxq.wake[1], F_SETFL, O_NONBLOCK);
+    return 0;
+#endif
+  }
+
+static void wakeClose (void)
+  {
+    if (rxq.wake[1] != rxq.wake[0])
+      close (rxq.wake[1]);
+    close (rxq.wake[0]);
+    rxq.wake[0] = rxq.wake[1] = -1;
+  }
+
+static void wakeRing (void)
+  {
+    uint64_t one = 1;
+    if (write (rxq.wake[1], & one, sizeof (one)) < 0)
+      return; // already rung
+  }
+
+// After an rlink send: the receive thread may be waiting with nothing to
+// resend
+static void rxKick (void)
+  {
+    if (rxq.idle)
+      wakeRing ();
+  }
+
+// Wait for the link to be readable, the wakeup to be rung, or ms to pass
+// (-1: no limit)
+static void rxWait (int ms)
+  {
+    struct pollfd p[2] =
+      {
+        { .fd = rxq.wake[0], .events = POLLIN },
+        { .fd = rxq.sock, .events = POLLIN }
+      };
+    if (poll (p, 2, ms) > 0 && (p[0].revents & POLLIN))
+      {
+        uint64_t buf[8];
+        while (read (rxq.wake[0], buf, sizeof (buf)) > 0)
+          ;
+      }
+  }
+
+// Take up to n buffers from the pool; if 'block', wait for at least one.
+// Called with rxq.lock held.
+static int bufAlloc (coupler_buf * * bufs, int n, bool block)
+  {
+    while (block && rxq.running && ! rxq.freeList)
+      pthread_cond_wait (& rxq.bufFree, & rxq.lock);
+    int got = 0;
+    while (got < n && rxq.freeList)
+      {
+        coupler_buf * bp = rxq.freeList;
+        rxq.freeList = bp -> next;
+        bp -> refs = 1;
+        bufs[got ++] = bp;
+      }
+    return got;
+  }
+
+// Called with rxq.lock held.
+static void bufFree (coupler_buf * bp)
+  {
+    bp -> next = rxq.freeList;
+    rxq.freeList = bp;
+    pthread_cond_signal (& rxq.bufFree);
+  }
+
+// Reliable framing: frames are received a batch at a time into scratch
+// buffers and rlink hands the packets up, in order, through rxDeliver. The
+// frames rlink sends from the receive thread (acks and resends) are
+// gathered and go out together at the end of each pass (txFlush); the CPU
+// thread's frames go straight out.
+
+static uint8_t rxFrames[RX_BATCH][RLINK_HDR_SZ + psz];
+static uint8_t txFrames[RX_BATCH][RLINK_HDR_SZ + psz];
+static uint16_t txSz[RX_BATCH];
+static int nTx;
+static coupler_buf * rxPending[RX_BATCH];
+static int nRxPending;
+
+static void rxPublish (void)
+  {
+    if (! nRxPending)
+      return;
+    pthread_mutex_lock (& rxq.lock);
+    for (int i = 0; i < nRxPending; i ++)
+      rxq.ring[rxq.tail ++ % RXPOOL] = rxPending[i];
+    pthread_cond_signal (& rxq.notEmpty);
+    pthread_mutex_unlock (& rxq.lock);
+    nRxPending = 0;
+  }
+
+static void rxDeliver (UNUSED void * ctx, uint8_t * data, int sz)
+  {
+    if (capsInput (data, sz))
+      return;
+    coupler_buf * bp;
+    pthread_mutex_lock (& rxq.lock);
+    int got = bufAlloc (& bp, 1, true);
+    pthread_mutex_unlock (& rxq.lock);
+    if (! got)
+      return; // shutting down
+    memcpy (bp -> data, data, (size_t) sz);
+    bp -> sz = sz;
+    rxPending[nRxPending ++] = bp;
+    if (nRxPending == RX_BATCH)
+      rxPublish ();
+  }
+
+static void txFlush (void)
+  {
+    if (! nTx)
+      return;
+    uint8_t * bufs[RX_BATCH];
+    for (int i = 0; i < nTx; i ++)
+      bufs[i] = txFrames[i];
+    pthread_mutex_lock (& coupler_data.txLock);
+    int rc = dn_udp_send_many (coupler_data.link, bufs, txSz, nTx, PFLG_FINAL);
+    pthread_mutex_unlock (& coupler_data.txLock);
+    nTx = 0;
+    if (rc)
+      sim_printf ("dn_udp_send_many failed: %d\n", rc);
+  }
+
+static void udpXmit (UNUSED void * ctx, uint8_t * frame, int sz)
+  {
+    if (rxq.running && pthread_equal (pthread_self (), rxq.thread))
+      {
+        if (nTx == RX_BATCH)
+          txFlush ();
+        memcpy (txFrames[nTx], frame, (size_t) sz);
+        txSz[nTx ++] = (uint16_t) sz;
+        return;
+      }
+    pthread_mutex_lock (& coupler_data.txLock);
+    int rc = dn_udp_send (coupler_data.link, frame, (uint16_t) sz, PFLG_FINAL);
+    pthread_mutex_unlock (& coupler_data.txLock);
+    if (rc)
+      sim_printf ("dn_udp_send failed: %d\n", rc);
+  }
+
+static void rxReliable (void)
+  {
+    uint8_t * bufs[RX_BATCH];
+    int szs[RX_BATCH];
+    for (int i = 0; i < RX_BATCH; i ++)
+      bufs[i] = rxFrames[i];
+    while (rxq.running)
+      {
+        int n = dn_udp_receive_many (coupler_data.link, bufs, sizeof (rxFrames[0]), szs, RX_BATCH);
+        if (n < 0)
+          {
+            sim_printf ("dn_udp_receive_many failed: %d\n", n);
+            n = 0;
+          }
+        for (int i = 0; i < n; i ++)
+          if (szs[i])
+            rlink_input (coupler_data.rl, rxFrames[i], szs[i]);
+        rxPublish ();
+        rlink_poll (coupler_data.rl);
+        txFlush ();
+        if (n < RX_BATCH)
+          {
+            // Set before asking rlink, so a send that rlink_timeout misses
+            // sees it and rings (see udpSend)
+            rxq.idle = true;
+            int ms = rlink_timeout (coupler_data.rl);
+            if (rxq.running)
+              rxWait (ms);
+            rxq.idle = false;
+          }
+      }
+  }
+
+static void * rxThread (UNUSED void * arg)
   {
-    int sz = dn_udp_receive (coupler_data.link, pkt, psz);
+    // Until rxStart has rxq.thread, which udpXmit goes by
+    pthread_mutex_lock (& rxq.lock);
+    pthread_mutex_unlock (& rxq.lock);
+
+    if (coupler_data.rl)
+      {
+        rxReliable ();
+        return NULL;
+      }
+
+    coupler_buf * batch[RX_BATCH];
+    while (rxq.running)
+      {
+        pthread_mutex_lock (& rxq.lock);
+        int nbufs = bufAlloc (batch, RX_BATCH, true);
+        pthread_mutex_unlock (& rxq.lock);
+        if (! rxq.running)
+          break;
+
+        // Drain the link into the buffers we were given, and move the
+        // packets to the front of the batch
+        uint8_t * bufs[RX_BATCH];
+        int szs[RX_BATCH];
+        for (int i = 0; i < nbufs; i ++)
+          bufs[i] = batch[i] -> data;
+        int got = dn_udp_receive_many (coupler_data.link, bufs, psz, szs, nbufs);
+        if (got < 0)
+          {
+            sim_printf ("dn_udp_receive_many failed: %d\n", got);
+            got = 0;
+          }
+        int n = 0;
+        for (int i = 0; i < got; i ++)
+          {
+            if (! szs[i] || capsInput (batch[i] -> data, szs[i]))
+              continue; // reuse the buffer
+            coupler_buf * bp = batch[i];
+            batch[i] = batch[n];
+            batch[n ++] = bp;
+            bp -> sz = szs[i];
+          }
+
+        pthread_mutex_lock (& rxq.lock);
+        for (int i = 0; i < n; i ++)
+          rxq.ring[rxq.tail ++ % RXPOOL] = batch[i];
+        for (int i = n; i < nbufs; i ++)
+          bufFree (batch[i]);
+        if (n)
+          pthread_cond_signal (& rxq.notEmpty);
+        pthread_mutex_unlock (& rxq.lock);
+
+        if (got < nbufs && rxq.running)
+          rxWait (-1);
+      }
+    return NULL;
+  }
+
+static void rxInit (void)
+  {
+    rxq.head = rxq.tail = 0;
+    rxq.freeList = NULL;
+    lastPkt = NULL;
+    for (int i = 0; i < RXPOOL; i ++)
+      bufFree (rxPool + i);
+  }
+
+static void rxStart (void)
+  {
+    if (wakeOpen ())
+      {
+        sim_printf ("coupler: unable to create the receive wakeup\n");
+        return;
+      }
+    rxq.sock = udp_fd (coupler_data.link);
+    rxq.running = true;
+    pthread_mutex_lock (& rxq.lock);
+    int rc = pthread_create (& rxq.thread, NULL, rxThread, NULL);
+    pthread_mutex_unlock (& rxq.lock);
+    if (rc)
+      {
+        sim_printf ("coupler: unable to start receive thread\n");
+        rxq.running = false;
+        wakeClose ();
+      }
+  }
+
+static void rxStop (void)
+  {
+    if (! rxq.running)
+      return;
+    pthread_mutex_lock (& rxq.lock);
+    rxq.running = false;
+    pthread_cond_broadcast (& rxq.bufFree);
+    pthread_cond_broadcast (& rxq.notEmpty);
+    pthread_mutex_unlock (& rxq.lock);
+    wakeRing ();
+    pthread_join (rxq.thread, NULL);
+    wakeClose ();
+    rxq.sock = -1;
+  }
+
+// Take the packet at the head of the queue; wait for one if 'block'.
+// Returns NULL if the queue is empty (or the link has been shut down).
+static coupler_buf * rxDequeue (bool block)
+  {
+    coupler_buf * bp = NULL;
+    pthread_mutex_lock (& rxq.lock);
+    while (block && (rxq.running || rxq.direct) && rxq.head == rxq.tail)
+      pthread_cond_wait (& rxq.notEmpty, & rxq.lock);
+    if (rxq.head != rxq.tail)
+      bp = rxq.ring[rxq.head ++ % RXPOOL];
+    pthread_mutex_unlock (& rxq.lock);
+    return bp;
+  }
+
+static int shmReceive (uint8_t * * pktp, bool block)
+  {
+    if ((couplerUnit.flags & UNIT_ATT) == 0)
+      return 0;
+    int sz;
+    do
+      sz = dn_shm_receive (coupler_data.link, pktp, block);
+    while (sz > 0 && capsInput (* pktp, sz));
     if (sz < 0)
       {
-        sim_printf ("dn_udp_receive failed: %d\n", sz);
+        sim_printf ("dn_shm_receive failed: %d\n", sz);
         sz = 0;
       }
-    * pktp = pkt;
     return sz;
   }
 
+// Returns the next packet, holding one reference for the caller, or NULL if
+// there is none and !block. shm: records are copied out of the ring, since
+// the ring slot is reused once the next record is read.
+static coupler_buf * linkGet (bool block)
+  {
+    if (coupler_data.transport == transportSHM)
+      {
+        uint8_t * p;
+        int sz = shmReceive (& p, block);
+        if (! sz)
+          return NULL;
+        coupler_buf * bp;
+        pthread_mutex_lock (& rxq.lock);
+        int got = bufAlloc (& bp, 1, false);
+        pthread_mutex_unlock (& rxq.lock);
+        if (! got)
+          {
+            sim_printf ("coupler: buffer pool exhausted; packet dropped\n");
+            return NULL;
+          }
+        memcpy (bp -> data, p, (size_t) sz);
+        bp -> sz = sz;
+        return bp;
+      }
+    return rxDequeue (block);
+  }
+
+static coupler_buf * replayGet (bool block)
+  {
+    uint8_t * p;
+    int sz = rr_take (rrCoupler, 0, & p, block);
+    if (sz < 0)
+      return NULL;
+    coupler_buf * bp;
+    pthread_mutex_lock (& rxq.lock);
+    int got = bufAlloc (& bp, 1, false);
+    pthread_mutex_unlock (& rxq.lock);
+    if (! got)
+      return NULL;
+    memcpy (bp -> data, p, (size_t) sz);
+    bp -> sz = sz;
+    return bp;
+  }
+
+coupler_buf * get_coupler (bool block)
+  {
+    if (rr_replaying ())
+      return replayGet (block);
+    coupler_buf * bp = linkGet (block);
+    if (bp)
+      rr_record (rrCoupler, 0, bp -> data, bp -> sz);
+    return bp;
+  }
+
+void hold_coupler (coupler_buf * bp)
+  {
+    __atomic_add_fetch (& bp -> refs, 1, __ATOMIC_RELAXED);
+  }
+
+void release_coupler (coupler_buf * bp)
+  {
+    if (__atomic_sub_fetch (& bp -> refs, 1, __ATOMIC_ACQ_REL))
+      return;
+    pthread_mutex_lock (& rxq.lock);
+    bufFree (bp);
+    pthread_mutex_unlock (& rxq.lock);
+  }
+
+static int pollOrWait (uint8_t * * pktp, bool block)
+  {
+    if (lastPkt)
+      {
+        release_coupler (lastPkt);
+        lastPkt = NULL;
+      }
+    if (coupler_data.transport == transportSHM && ! rr_replaying ())
+      {
+        int sz = shmReceive (pktp, block);
+        if (sz)
+          rr_record (rrCoupler, 0, * pktp, sz);
+        return sz;
+      }
+    lastPkt = get_coupler (block);
+    if (! lastPkt)
+      return 0;
+    * pktp = lastPkt -> data;
+    return lastPkt -> sz;
+  }
+
+// warning: the packet is valid only until the next call; use get_coupler to
+// hold on to packets.
+int poll_coupler (uint8_t * * pktp)
+  {
+    return pollOrWait (pktp, false);
+  }
+
+// As poll_coupler, but waits for a packet to arrive
+int wait_coupler (uint8_t * * pktp)
+  {
+    return pollOrWait (pktp, true);
+  }
+
+static int udpSend (uint8_t * data, int sz)
+  {
+    if (coupler_data.rl)
+      {
+        int rc = rlink_send (coupler_data.rl, data, sz);
+        rxKick ();
+        return rc;
+      }
+    pthread_mutex_lock (& coupler_data.txLock);
+    int rc = dn_udp_send (coupler_data.link, data, (uint16_t) sz, PFLG_FINAL);
+    pthread_mutex_unlock (& coupler_data.txLock);
+    return rc;
+  }
+
+int send_coupler (uint8_t * data, int sz)
+  {
+    if (rr_replaying ())
+      return 0; // the host's answers are in the log
+    if (coupler_data.transport == transportSHM)
+      return dn_shm_send (coupler_data.link, data, (uint16_t) sz);
+    if (coupler_data.transport == transportDirect)
+      {
+        coupler_data.directSend (coupler_data.directCtx, data, sz);
+        return 0;
+      }
+    return udpSend (data, sz);
+  }
+
+// Direct coupling (see coupler.h)
+//
+// There is no receive thread: the host queues packets with coupler_inject,
+// and a wait blocks until it does or the coupler is detached.
+
+static void rxDirect (bool on)
+  {
+    pthread_mutex_lock (& rxq.lock);
+    rxq.direct = on;
+    pthread_cond_broadcast (& rxq.notEmpty);
+    pthread_mutex_unlock (& rxq.lock);
+  }
+
+t_stat coupler_attach_direct (coupler_direct_fn send, void * ctx)
+  {
+    UNIT * uptr = & couplerUnit;
+    if (uptr -> flags & UNIT_ATT)
+      detach_unit (uptr);
+    char * pfn = strdup ("direct");
+    if (! pfn)
+      return SCPE_MEM;
+    rxInit ();
+    coupler_data.transport = transportDirect;
+    coupler_data.directSend = send;
+    coupler_data.directCtx = ctx;
+    coupler_data.peerCaps = 0;
+    coupler_data.capsAgreed = false;
+    uptr -> flags |= UNIT_ATT;
+    uptr -> filename = pfn;
+    rxDirect (true);
+    announce_coupler ();
+    return SCPE_OK;
+  }
+
+int coupler_inject (const uint8_t * data, int sz)
+  {
+    if (coupler_data.transport != transportDirect ||
+        ! (couplerUnit.flags & UNIT_ATT))
+      return -1;
+    if (sz < 0 || sz > COUPLER_PKT_SZ)
+      return -1;
+    if (capsInput ((uint8_t *) data, sz))
+      return 0;
+    coupler_buf * bp;
+    pthread_mutex_lock (& rxq.lock);
+    int got = bufAlloc (& bp, 1, false);
+    if (got)
+      {
+        memcpy (bp -> data, data, (size_t) sz);
+        bp -> sz = sz;
+        rxq.ring[rxq.tail ++ % RXPOOL] = bp;
+        pthread_cond_signal (& rxq.notEmpty);
+      }
+    pthread_mutex_unlock (& rxq.lock);
+    return got ? 0 : -1;
+  }
+
+// Delta boot (see bootcache.h)
+
+static uint32_t get16 (uint8_t * p)
+  {
+    return ((uint32_t) p[0] << 8) | p[1];
+  }
+
+static uint32_t get32 (uint8_t * p)
+  {
+    return (get16 (p) << 16) | get16 (p + 2);
+  }
+
+static void sendNeed (bool * have, uint nblk)
+  {
+    uint8_t need[4 + BC_MAXBLK / 8];
+    memset (need, 0, sizeof (need));
+    need[0] = BC_MAGIC;
+    need[1] = BC_NEED;
+    need[2] = (uint8_t) (nblk >> 8);
+    need[3] = (uint8_t) nblk;
+    for (uint b = 0; b < nblk; b ++)
+      if (! have[b])
+        need[4 + b / 8] |= (uint8_t) (0200 >> (b % 8));
+    int rc = send_coupler (need, (int) (4 + (nblk + 7) / 8));
+    if (rc)
+      sim_printf ("send_coupler need list returned %d\r\n", rc);
+  }
+
+// Assemble the image from the cache and whatever blocks the host has to
+// send, then load it into memory.
+static bool deltaBoot (uint8_t * pktp, int sz)
+  {
+    static word36 image[BC_MAXBLK * BC_WORDS];
+    static uint8_t hashes[BC_MAXBLK][BC_HASH_SZ];
+    static bool have[BC_MAXBLK];
+
+    if (sz < 12)
+      return false;
+    uint nblk = get16 (pktp + 2);
+    uint32_t nwords = get32 (pktp + 4);
+    uint32_t addr = get32 (pktp + 8);
+    if (nblk > BC_MAXBLK || nblk != ((uint64_t) nwords + BC_WORDS - 1) / BC_WORDS ||
+        (uint) sz < 12 + BC_HASH_SZ * nblk || addr >= MEM_SIZE ||
+        2 * (uint64_t) nwords > MEM_SIZE - addr)
+      {
+        sim_printf ("delta boot: bad manifest\r\n");
+        return false;
+      }
+
+    uint missing = 0;
+    for (uint b = 0; b < nblk; b ++)
+      {
+        memcpy (hashes[b], pktp + 12 + BC_HASH_SZ * b, BC_HASH_SZ);
+        have[b] = bootcache_get (hashes[b], image + b * BC_WORDS);
+        if (! have[b])
+          missing ++;
+      }
+    sim_printf ("delta boot: %u of %u blocks cached\r\n", nblk - missing, nblk);
+    sendNeed (have, nblk);
+
+    size_t blksz = coupler_size36 (BC_WORDS);
+    while (missing)
+      {
+        uint8_t * p;
+        int n = wait_coupler (& p);
+        if (! n)
+          return false;
+        if (n < 4 || p[0] != BC_MAGIC || p[1] != BC_BLOCK)
+          {
+            sim_printf ("delta boot: unexpected cmd %u\r\n", p[0]);
+            continue;
+          }
+        uint b = get16 (p + 2);
+        if (b >= nblk || have[b] || (size_t) (n - 4) < blksz)
+          continue;
+        word36 blk[BC_WORDS];
+        uint8_t hash[BC_HASH_SZ];
+        coupler_get36 (blk, p + 4, BC_WORDS);
+        bootcache_hash (blk, hash);
+        if (memcmp (hash, hashes[b], BC_HASH_SZ))
+          {
+            sim_printf ("delta boot: block %u fails its hash\r\n", b);
+            continue;
+          }
+        memcpy (image + b * BC_WORDS, blk, sizeof (blk));
+        bootcache_put (hashes[b], blk);
+        have[b] = true;
+        missing --;
+      }
+
+    for (uint32_t i = 0; i < nwords; i ++)
+      {
+        cpu.M[addr + 2 * i] = (word18) (image[i] >> 18) & BITS18;
+        cpu.M[addr + 2 * i + 1] = (word18) image[i] & BITS18;
+      }
+    markDirtyRange ((word15) addr, 2 * nwords);
+    return true;
+  }
+
+uint32_t coupler_get_state (void)
+  {
+    return (uint32_t) (coupler_data.task_register.BT_INH << 1) |
+           coupler_data.task_register.STORED_BOOT;
+  }
+
+void coupler_set_state (uint32_t state)
+  {
+    coupler_data.task_register.BT_INH = (state >> 1) & 1;
+    coupler_data.task_register.STORED_BOOT = state & 1;
+  }
+
 void wait_for_boot (void)
   {
 sim_printf ("waiting for boot signal\n");
@@ -181,15 +1108,18 @@ sim_printf ("waiting for boot signal\n");
         sim_printf ("WARNING: coupler waiting for boot with boot inhibit set\r\n");
       }
 
+    // Let the host know what we can do before it starts sending
+    announce_coupler ();
+
     uint8_t * pktp; 
     while (1)
       {
-        int sz = poll_coupler (& pktp);
-//sim_printf ("poll_coupler return %d\n", sz);
+        int sz = wait_coupler (& pktp);
+//sim_printf ("wait_coupler return %d\n", sz);
         if (! sz)
           {
-            sleep (1);
-            continue;
+            sim_printf ("coupler detached while waiting for boot\r\n");
+            return;
           }
 
 #if 1
@@ -197,9 +1127,16 @@ sim_printf ("waiting for boot signal\n");
         sim_printf ("sz: %d\n", sz);
         for (int i = 0; i < sz; i ++) sim_printf (" %03o", pktp[i]); sim_printf ("\r\n");
 #endif
-        if (pkt[0] != dn_cmd_bootload)
+        if (pktp[0] != dn_cmd_bootload)
+          {
+            sim_printf ("got cmd %u; expected 1\r\n", pktp[0]);
+            continue;
+          }
+        // The PCW must all be there (see below)
+        int need = coupler_packed () ? 1 + (int) coupler_size36 (1) : (int) sizeof (dn_bootload);
+        if (sz < need)
           {
-            sim_printf ("got cmd %u; expected 1\r\n", pkt[0]);
+            sim_printf ("bootload of %d bytes; expected %d\r\n", sz, need);
             continue;
           }
         break;
@@ -213,8 +1150,13 @@ sim_printf ("waiting for boot signal\n");
 //  the L66 address for the Bootload, the address plus one of the above
 //  Transfer Control Word"
 
-    dn_bootload * p = (dn_bootload *) pktp;
-//sim_printf ("dia_pcw: %12lo\r\n", p->dia_pcw);
+    // Packed, the PCW follows the command byte directly
+    word36 dia_pcw;
+    if (coupler_packed ())
+      coupler_get36 (& dia_pcw, pktp + 1, 1);
+    else
+      dia_pcw = ((dn_bootload *) pktp) -> dia_pcw;
+    sim_debug (DBG_DEBUG, & couplerDev, "dia_pcw: %012lo\n", dia_pcw);
 
     // The real coupler would at this point boot the DN CPU; it would run
     // it's boot PROM, and eventually:
@@ -244,10 +1186,10 @@ sim_printf ("waiting for boot signal\n");
 
     dn_ids_iold pkt;
     pkt.cmd = dn_cmd_ISB_IOLD;
-    int rc = dn_udp_send (coupler_data.link, (uint8_t *) & pkt, sizeof (pkt), PFLG_FINAL);
+    int rc = send_coupler ((uint8_t *) & pkt, sizeof (pkt));
     if (rc)
       {
-        sim_printf ("dn_udp_send dn_cmd_ISB_IOLD returned %d\r\n", rc);
+        sim_printf ("send_coupler dn_cmd_ISB_IOLD returned %d\r\n", rc);
       }
 
 // Wait for GICB
@@ -255,12 +1197,12 @@ sim_printf ("waiting for boot signal\n");
 sim_printf ("waiting for buffer\n");
     while (1)
       {
-        int sz = poll_coupler (& pktp);
-//sim_printf ("poll_coupler return %d\n", sz);
+        int sz = wait_coupler (& pktp);
+//sim_printf ("wait_coupler return %d\n", sz);
         if (! sz)
           {
-            sleep (1);
-            continue;
+            sim_printf ("coupler detached while waiting for buffer\r\n");
+            return;
           }
 
 #if 1
@@ -268,6 +1210,12 @@ sim_printf ("waiting for buffer\n");
         sim_printf ("sz: %d\n", sz);
         for (int i = 0; i < sz; i ++) sim_printf (" %03o", pktp[i]); sim_printf ("\r\n");
 #endif
+        if (sz >= 2 && pktp[0] == BC_MAGIC && pktp[1] == BC_MANIFEST)
+          {
+            if (deltaBoot (pktp, sz))
+              break;
+            continue;
+          }
         if (pktp[0] != dn_cmd_buffer)
           {
             sim_printf ("got cmd %u; expected 1\r\n", pktp[0]);
@@ -1,4 +1,38 @@
 extern DEVICE couplerDev;
+
+#define COUPLER_PKT_SZ 17000
+
+typedef struct coupler_buf
+  {
+    int sz;
+    int refs;
+    struct coupler_buf * next;
+    uint8_t data[COUPLER_PKT_SZ];
+  } coupler_buf;
+
+coupler_buf * get_coupler (bool block);
+void hold_coupler (coupler_buf * bp);
+void release_coupler (coupler_buf * bp);
 int poll_coupler (uint8_t * * pktp);
+int wait_coupler (uint8_t * * pktp);
+int send_coupler (uint8_t * data, int sz);
+void announce_coupler (void);
+bool coupler_packed (void);
+size_t coupler_size36 (size_t n);
+size_t coupler_put36 (uint8_t * dst, const word36 * src, size_t n);
+size_t coupler_get36 (word36 * dst, const uint8_t * src, size_t n);
 void wait_for_boot (void);
 
+// Direct coupling, for an emulator linked in the same process
+// (libdn6600.h): packets for the host are handed to 'send', which must copy
+// what it wants to keep, and the host queues its packets with
+// coupler_inject. Returns -1 if the pool is full; the host retries later.
+// wait_coupler blocks until a packet is injected or the coupler detached.
+typedef void (* coupler_direct_fn) (void * ctx, uint8_t * data, int sz);
+t_stat coupler_attach_direct (coupler_direct_fn send, void * ctx);
+int coupler_inject (const uint8_t * data, int sz);
+
+// Task register, for snapshots
+uint32_t coupler_get_state (void);
+void coupler_set_state (uint32_t state);
+
@@ -1,11 +1,24 @@
 #include <unistd.h>
 #include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "dn6600.h"
 #include "dn6600_caf.h"
 #include "coupler.h"
 #include "iom.h"
 #include "utils.h"
+#include "pack36.h"
+#include "snapshot.h"
+#include "checkpoint.h"
+#include "replay.h"
+#include "reverse.h"
+#include "fnps.h"
+#include "timer.h"
+#include "hsla.h"
+#include "lsla.h"
+#include "psa.h"
+#include "tcu.h"
 
 char sim_name [] = "dn6600";
 int32 sim_emax = 1;
@@ -138,6 +151,7 @@ static DEBTAB cpu_dt[] =
   };
 
 static t_stat cpu_boot (UNUSED int32 unit_num, UNUSED DEVICE * dptr);
+static t_stat cpu_reset (DEVICE * dptr);
 
 DEVICE cpuDev =
   {
@@ -153,7 +167,7 @@ DEVICE cpuDev =
     WSZ,            /* data width */
     NULL /*&cpu_ex*/,        /* examine routine */
     NULL /*&cpu_dep*/,       /* deposit routine */
-    NULL /*&cpu_reset*/,     /* reset routine */
+    & cpu_reset,    /* reset routine */
     & cpu_boot,     /* boot routine */
     NULL,           /* attach routine */
     NULL,           /* detach routine */
@@ -256,18 +270,138 @@ DEVICE * sim_devices [] =
   {
     & cpuDev,
     & couplerDev,
+    & ckptDev,
+    & revDev,
+    & fnpsDev,
+    & timerDev,
+    & hslaDev[0],
+    & hslaDev[1],
+    & hslaDev[2],
+    & lslaDev,
+    & psaDev,
+    & tcuDev,
     NULL
   };
 
+static CTAB dn6600_cmds [] =
+  {
+    { "SAVE", snapshot_save_cmd, 0, "sa{ve} <file>          save a snapshot of the FNP\n"
+                                    "sa{ve} -S <file>       save in the standard simh format\n" },
+    { "RESTORE", snapshot_restore_cmd, 0, "re{store} <file>       restore a snapshot or saved state\n" },
+    { "RECORD", rr_record_cmd, 0, "record <file>          log external input for replay\n"
+                                  "record off             stop logging\n" },
+    { "REPLAY", rr_replay_cmd, 0, "replay <file>          feed logged input back in place of the link\n"
+                                  "replay off             stop replaying\n" },
+    { "STEP", rev_step_cmd, RU_STEP, "s{tep} {n}             simulate n instructions\n"
+                                     "s{tep} -n              go back n instructions\n",
+      NULL, & run_cmd_message },
+    { "LASTWRITE", rev_lastwrite_cmd, 0, "lastwrite <addr>       go back to the last store to addr\n",
+      NULL, & run_cmd_message },
+    { NULL, NULL, 0, NULL }
+  };
+
+// scp.c defines sim_vm_init itself, so the command table is installed by
+// the reset that scp runs at startup.
+static t_stat cpu_reset (UNUSED DEVICE * dptr)
+  {
+    sim_vm_cmd = dn6600_cmds;
+    sim_brk_types = SWMASK ('E') | SWMASK ('R') | SWMASK ('W');
+    sim_brk_dflt = SWMASK ('E');
+    return SCPE_OK;
+  }
+
 const char * sim_stop_messages [] =
   {
-    "Stop"
+    "Stop",
+    "Breakpoint",
+    "Watchpoint"
   };
 
-t_stat sim_load (FILE * fileref, char * cptr, char * fnam, int flag)
+// LOAD a load_fnp_ boot segment, as extracted from Multics: 36-bit words
+// packed two to 9 bytes (see pack36.h).
+//
+//   word 0          boot DCW: bits 0-17 start address, bits 24-35 tally
+//   words 1-tally   GICB
+//   pad to mod 64
+//   core image      to the end of the file, loaded at FNP address 0
+//
+// The core image is what the GICB would have fetched over the DIA, so
+// loading it directly and starting at the DCW address boots the FNP with
+// no host attached. LOAD -G loads only the GICB, at the DCW address, to run
+// the real two stage boot against a host.
+
+t_stat sim_load (FILE * fileref, UNUSED char * cptr, UNUSED char * fnam,
+                 int flag)
   {
-// XXX
-    return SCPE_UNK;
+    if (flag)
+      return SCPE_NOFNC; // no DUMP
+
+    struct stat sb;
+    int fd = fileno (fileref);
+    if (fstat (fd, & sb) < 0)
+      return SCPE_IOERR;
+    size_t nwords = ((size_t) sb.st_size * 2) / 9;
+    if (nwords < 2)
+      return SCPE_FMT;
+
+    uint8_t * seg = mmap (NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE,
+                          fd, 0);
+    if (seg == MAP_FAILED)
+      return SCPE_IOERR;
+#ifdef MADV_SEQUENTIAL
+    madvise (seg, (size_t) sb.st_size, MADV_SEQUENTIAL);
+#endif
+
+    word36 dcw;
+    unpack36 (& dcw, seg, 1);
+    word18 start = (word18) (dcw >> 18) & BITS18;
+    size_t tally = dcw & 07777;
+    size_t imageOff = (tally + 64) & ~ (size_t) 077;
+
+    t_stat rc = SCPE_OK;
+    if (tally == 0 || tally + 1 > nwords || start >= MEM_SIZE)
+      {
+        rc = SCPE_FMT;
+        goto done;
+      }
+
+    // Word n starts 4.5n bytes in; the offsets used here are all even.
+    if (sim_switches & SWMASK ('G'))
+      {
+        // GICB only; words 1 - tally. Word 1 shares its byte with the
+        // DCW, so take it from the first pair and unpack the rest.
+        if (start + 2 * tally > MEM_SIZE)
+          {
+            rc = SCPE_FMT;
+            goto done;
+          }
+        word36 w[2];
+        unpack36 (w, seg, 2);
+        cpu.M[start] = (word18) (w[1] >> 18) & BITS18;
+        cpu.M[start + 1] = (word18) w[1] & BITS18;
+        unpack36_18 (cpu.M + start + 2, seg + 9, tally - 1);
+        markDirtyRange (start, (unsigned int) (2 * tally));
+        sim_printf ("GICB %lu words at %06o\n", (unsigned long) tally, start);
+      }
+    else
+      {
+        if (imageOff >= nwords)
+          {
+            rc = SCPE_FMT;
+            goto done;
+          }
+        size_t n = nwords - imageOff;
+        if (n > MEM_SIZE / 2)
+          n = MEM_SIZE / 2;
+        unpack36_18 (cpu.M, seg + (imageOff / 2) * 9, n);
+        markDirtyRange (0, (unsigned int) (2 * n));
+        sim_printf ("core image %lu words\n", (unsigned long) n);
+      }
+    cpu.rIC = start;
+
+done:
+    munmap (seg, (size_t) sb.st_size);
+    return rc;
   }
 
 //Based on the switch variable, parse character string cptr for a symbolic 
@@ -498,11 +632,17 @@ static void doUnimp (word6 opc)
   }
 
 jmp_buf jmpMain;
+bool cpuDriven;
+
+extern t_bool sim_brk_pend [SIM_BKPT_N_SPC];
 
 t_stat sim_instr (void)
   {
     static int reason = 0;
 
+    watchSync ();
+    memWatchStop = 0;
+
     int val = setjmp (jmpMain);
     switch (val)
       {
@@ -523,7 +663,34 @@ t_stat sim_instr (void)
           {
             if ((reason = sim_process_event ()))
               break;
+            // A device store may have hit a watchpoint
+            if (memWatchArmed && memWatchStop)
+              {
+                reason = memWatchStop;
+                memWatchStop = 0;
+                break;
+              }
+          }
+
+        // Check for an instruction breakpoint. SCP has a comprehensive
+        // breakpoint facility. It allows a VM to define many different kinds
+        // of breakpoints. The VM checks for execution (type E) breakpoints
+        // during instruction fetch. 
+        //
+        // This is done before the instruction is counted, so that the
+        // instruction count stays exact for replay. SCP will not stop twice
+        // at the location it last stopped at until it has been asked about
+        // some other location; while that is pending every instruction is
+        // tested, not just those flagged in memAttr.
+
+        if (memWatchArmed && ! rev_rerunning &&
+            ((memAttr [cpu . rIC] & MA_EXEC) || sim_brk_pend [0]) &&
+            sim_brk_test (cpu . rIC, SWMASK ('E')))
+          {
+            reason = STOP_BKPT;
+            break;
           }
+
         sim_interval --;
 
         // Check for outstanding interrupts and process if required. 
@@ -535,13 +702,6 @@ t_stat sim_instr (void)
 
         // ... XXX
 
-        // Check for an instruction breakpoint. SCP has a comprehensive
-        // breakpoint facility. It allows a VM to define many different kinds
-        // of breakpoints. The VM checks for execution (type E) breakpoints
-        // during instruction fetch. 
-
-        // ... XXX
-
         // Fetch the next instruction, increment the PC, optionally decode the
         // address, and dispatch (via a switch statement) for execution.        
 
@@ -1414,7 +1574,8 @@ t_stat sim_instr (void)
 	    // Select Register. If the channel has a 6-, 9-, or 19-bit
 	    // interface, it uses only part of the word."
 
-              iomCIOC ();
+              if (iomCIOC ())
+                break;
               UNIMP;
 
             case 061: // CMPX3
@@ -1651,14 +1812,22 @@ t_stat sim_instr (void)
 
         cpu . rIC = cpu . NEXT_IC;
 
+        if (memWatchArmed && memWatchStop)
+          {
+            reason = memWatchStop;
+            memWatchStop = 0;
+          }
+
 // Instruction times vary from 1 us up.
-        usleep (1);
+        if (! rev_rerunning && ! cpuDriven)
+          usleep (1);
 
       }
     while (reason == 0);
 
 leave:
-    sim_printf("\nsimCycles = %0.0lf\n", sim_gtime ());
+    if (! rev_rerunning && ! cpuDriven)
+      sim_printf("\nsimCycles = %0.0lf\n", sim_gtime ());
 
     return reason;
   }
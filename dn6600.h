@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stdbool.h>
 #include <setjmp.h>
 #include "sim_defs.h"
 
@@ -161,6 +162,10 @@ enum
 #define JMP_REENTRY     1
 #define JMP_STOP        2
 
+// Simulator stop codes; index sim_stop_messages
+#define STOP_BKPT       1
+#define STOP_WATCH      2
+
 // DATANET FNP GENERAL MEMORY MAP
 //
 //  00000 00377 Interrupt vectors
@@ -168,12 +173,20 @@ enum
 //  00420 00436 IOM Fault status
 //  00440 00447 Processor fault vectors
 //  00450 00777 I/O Comm. Region
+//    00450 00451 TIMER elapsed and interval timers (SET TIMER CELL moves them)
+//    00500 00537 PSA drive command regions
+//    00540 00547 TCU command region
 //  01000 01777 HLSA #1 I/O Comm. Region
 //  02000 02777 #2
 //  03000 03777 #3
-//  04000 77777 Program area
+//  04000 71777 Program area
+//  72000 77777 LSLA #1-#6 I/O Comm. Regions (SET LSLA BASE moves them)
 
 extern jmp_buf jmpMain;
 extern DEVICE cpuDev;
 
+// Set while the CPU is run in measured bursts by something other than SCP
+// (libdn6600): no pacing to real time, and no cycle count on the way out.
+extern bool cpuDriven;
+
 void doFault (int f, const char * msg) NO_RETURN;
@@ -8,9 +8,11 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include "dn6600.h"
 #include "dn6600_caf.h"
+#include "reverse.h"
 
 
 // some char position defines
@@ -42,6 +44,134 @@ struct  cinfo_t
     {  0,       0,       0,  0 }    // 111 = illegal
 };
 
+uint64_t memDirty[MEM_DIRTY_WORDS] __attribute__ ((aligned (64)));
+
+void markDirtyRange(word15 addr, unsigned int n)
+{
+    if (! n)
+        return;
+    unsigned int last = (addr + n - 1) & BITS15;
+    for (unsigned int p = addr >> MEM_PAGE_SHIFT; ; p = (p + 1) % MEM_NPAGES)
+    {
+        memDirty[p >> 6] |= 1ull << (p & 63);
+        if (p == last >> MEM_PAGE_SHIFT)
+            break;
+    }
+}
+
+void markAllDirty(void)
+{
+    for (int i = 0; i < MEM_DIRTY_WORDS; i ++)
+        __atomic_store_n(&memDirty[i], ~0ull, __ATOMIC_RELAXED);
+}
+
+void snapDirty(uint64_t *bits)
+{
+    for (int i = 0; i < MEM_DIRTY_WORDS; i ++)
+        bits[i] = __atomic_exchange_n(&memDirty[i], 0, __ATOMIC_ACQ_REL);
+}
+
+uint8_t memAttr[MEM_SIZE];
+bool memWatchArmed;
+t_stat memWatchStop;
+
+static int nBreaks;
+static int nTraps;
+
+// Not in scp.h
+extern BRKTAB *sim_brk_tab;
+extern int32 sim_brk_ent;
+
+// The words the last watchSync flagged, so that the next clears only those;
+// -1 if they could not all be kept, and memory has to be swept
+static word15 *flagged;
+static int nFlagged, maxFlagged;
+
+void watchSync(void)
+{
+    if (nFlagged < 0)
+        for (int i = 0; i < MEM_SIZE; i ++)
+            memAttr[i] &= MA_TRAP;
+    for (int i = 0; i < nFlagged; i ++)
+        memAttr[flagged[i]] &= MA_TRAP;
+    nFlagged = 0;
+    if (sim_brk_ent > maxFlagged)
+    {
+        word15 *p = realloc(flagged, sizeof(word15) * (size_t) sim_brk_ent);
+        if (p)
+        {
+            flagged = p;
+            maxFlagged = sim_brk_ent;
+        }
+    }
+    nBreaks = 0;
+    for (BRKTAB *bp = sim_brk_tab; bp < sim_brk_tab + sim_brk_ent; bp ++)
+    {
+        if (bp->addr >= MEM_SIZE)
+            continue;
+        uint8_t a = 0;
+        if (bp->typ & SWMASK('E'))
+            a |= MA_EXEC;
+        if (bp->typ & SWMASK('R'))
+            a |= MA_READ;
+        if (bp->typ & SWMASK('W'))
+            a |= MA_WRITE;
+        if (! a)
+            continue;
+        nBreaks ++;
+        memAttr[bp->addr] |= a;
+        if (nFlagged >= 0 && nFlagged < maxFlagged)
+            flagged[nFlagged ++] = (word15) bp->addr;
+        else
+            nFlagged = -1;
+    }
+    memWatchArmed = nBreaks || nTraps;
+}
+
+void memTrapSet(word15 addr, bool on)
+{
+    addr &= BITS15;
+    if (on && ! (memAttr[addr] & MA_TRAP))
+    {
+        memAttr[addr] |= MA_TRAP;
+        nTraps ++;
+    }
+    else if (! on && (memAttr[addr] & MA_TRAP))
+    {
+        memAttr[addr] &= ~MA_TRAP;
+        nTraps --;
+    }
+    memWatchArmed = nBreaks || nTraps;
+}
+
+// The slow path; only reached for a word with an attribute set
+void watchHit(word15 addr, uint8_t kind)
+{
+    if ((kind & MA_WRITE) && (memAttr[addr] & MA_TRAP))
+        rev_write_hit();
+    if (rev_rerunning || ! (memAttr[addr] & kind & (MA_READ | MA_WRITE)))
+        return;
+    if (sim_brk_test(addr, SWMASK(kind == MA_READ ? 'R' : 'W')))
+    {
+        sim_printf("%s of %05o\n", kind == MA_READ ? "Read" : "Write", addr);
+        memWatchStop = STOP_WATCH;
+    }
+}
+
+static inline void noteLoad(word15 addr)
+{
+    if (memWatchArmed && (memAttr[addr] & MA_READ))
+        watchHit(addr, MA_READ);
+}
+
+// Every store: mark the page, and check for a watchpoint
+static inline void noteStore(word15 addr)
+{
+    markDirty(addr);
+    if (memWatchArmed && (memAttr[addr] & (MA_WRITE | MA_TRAP)))
+        watchHit(addr, MA_WRITE);
+}
+
 word18 fromMemory(cpu_t *cpu, word15 addr, int charaddr)
 {
     // we're reading from memory, so, we need look at charAddr to see what kind of data to present to the processor or IOM
@@ -52,6 +182,7 @@ word18 fromMemory(cpu_t *cpu, word15 addr, int charaddr)
     switch (charaddr)
     {
         case 0: // word addressing
+            noteLoad(addr);
             sim_debug(DBG_FINAL, &cpuDev, "Read Addr: %05o Data: %06o\n", 
                       addr, cpu->M[addr] & BITS18);
             return cpu->M[addr] & BITS18;
@@ -80,6 +211,7 @@ word18 fromMemory(cpu_t *cpu, word15 addr, int charaddr)
     struct cinfo_t *ci = cinfo + charaddr;      // get mask & shifting info
     
     word18 data = cpu->M[addr] & BITS18;        // get 18-bits of data from memory
+    noteLoad(addr);
     
     data &= ci->mask2;                          // mask off unneeded bits
     
@@ -100,6 +232,7 @@ word36 fromMemory36(cpu_t *cpu, word15 addr, int charaddr)
     switch (charaddr)
     {
         case 0: // word addressing
+            noteLoad(addr);
             sim_debug(DBG_FINAL, &cpuDev, "Read Addr: %05o Data: %06o\n", 
                       addr, cpu->M[addr] & BITS18);
             return cpu->M[addr] & BITS18;
@@ -111,9 +244,11 @@ word36 fromMemory36(cpu_t *cpu, word15 addr, int charaddr)
             // an even word is the most significant part of a double-precision number
             // the memory location with the lower (even) address contains the most significant part of a double-word address
             word36 even = cpu->M[addr & 077776] & BITS18; // this will force an odd even (Y-1) and leave even alone (Y)
+            noteLoad(addr & 077776);
             sim_debug(DBG_FINAL, &cpuDev, "Read Addr: %05o Data: %06o\n", 
                       addr & 077776, (word18)even);
             word36 odd  = cpu->M[addr | 000001] & BITS18; // this will force an even odd (Y+1) and leave an odd alone (Y)
+            noteLoad(addr | 000001);
             sim_debug(DBG_FINAL, &cpuDev, "Read Addr: %05o Data: %06o\n", 
                       addr | 000001, (word18)odd);
 
@@ -132,6 +267,7 @@ word36 fromMemory36(cpu_t *cpu, word15 addr, int charaddr)
     struct cinfo_t *ci = cinfo + charaddr;      // get mask & shifting info
     
     word18 data = cpu->M[addr] & BITS18;        // get 18-bits of data from memory
+    noteLoad(addr);
     
     data &= ci->mask2;                          // mask off unneeded bits
     
@@ -142,6 +278,23 @@ word36 fromMemory36(cpu_t *cpu, word15 addr, int charaddr)
     return data & ci->mask1;                    // and present it to the CPU/IOM
 }
 
+// Device stores take the CPU's path for watchpoints and LASTWRITE, so a
+// BREAK -W fires on DMA and a word last stored by DMA is found
+void dmaToMemory(word15 addr, const word18 *data, unsigned int n)
+{
+    for (unsigned int i = 0; i < n; i ++)
+        cpu.M[(addr + i) & BITS15] = data[i] & BITS18;
+    markDirtyRange(addr, n);
+    if (! memWatchArmed)
+        return;
+    for (unsigned int i = 0; i < n; i ++)
+    {
+        word15 a = (addr + i) & BITS15;
+        if (memAttr[a] & (MA_WRITE | MA_TRAP))
+            watchHit(a, MA_WRITE);
+    }
+}
+
 void toMemory(cpu_t *cpu, word18 data, word15 addr, word3 charaddr)
 {
     // we're writing to memory, so, we need look at charaddr to see what kind of data to put where
@@ -151,6 +304,7 @@ void toMemory(cpu_t *cpu, word18 data, word15 addr, word3 charaddr)
     {
         case 0:
             cpu->M[addr & BITS15] = data & BITS18;
+            noteStore(addr & BITS15);
             sim_debug(DBG_FINAL, &cpuDev, "Write Addr: %05o Data: %06o\n", 
                       addr & BITS15, data & BITS18);
             return;
@@ -192,6 +346,7 @@ void toMemory(cpu_t *cpu, word18 data, word15 addr, word3 charaddr)
     word18 newM = (oldM & ~ci->mask2) | data; // mask out previous bits, 'or' in new data
     
     cpu->M[addr] = newM & BITS18;            // write out modified data back to memory
+    noteStore(addr);
     sim_debug(DBG_FINAL, &cpuDev, "Write Addr: %05o Data: %06o\n", 
               addr, newM & BITS18);
 }
@@ -205,6 +360,7 @@ void toMemory36(cpu_t *cpu, word36 data36, word15 addr, word3 charaddr)
     {
         case 0:
             cpu->M[addr & BITS15] = data36 & BITS18;
+            noteStore(addr & BITS15);
             sim_debug(DBG_FINAL, &cpuDev, "Write Addr: %05o Data: %06o\n", 
                       addr & BITS15, (word18) (data36 & BITS18));
             return;
@@ -217,10 +373,12 @@ void toMemory36(cpu_t *cpu, word36 data36, word15 addr, word3 charaddr)
             // the memory location with the lower (even) address contains the most significant part of a double-word address
             word36 even = (data36 >> 18LL) & BITS18;
             cpu->M[addr & 077776] = (word18)even; // this will force an odd even (Y-1) and leave even alone (Y)
+            noteStore(addr & 077776);
             sim_debug(DBG_FINAL, &cpuDev, "Write Addr: %05o Data: %06o\n", 
                       addr & 077776, (word18)even);
             word36 odd  =  data36 & BITS18;
             cpu->M[addr | 000001] = (word18)odd;  // this will force an even odd (Y+1) and leave an odd alone (Y)
+            noteStore(addr | 000001);
             sim_debug(DBG_FINAL, &cpuDev, "Write Addr: %05o Data: %06o\n", 
                       addr | 000001, (word18)odd);
             return;
@@ -250,6 +408,7 @@ void toMemory36(cpu_t *cpu, word36 data36, word15 addr, word3 charaddr)
     word18 newM = (oldM & ~ci->mask2) | data18; // mask out previous bits, 'or' in new data
     
     cpu->M[addr] = newM & BITS18;            // write out modified data back to memory
+    noteStore(addr);
     sim_debug(DBG_FINAL, &cpuDev, "Write Addr: %05o Data: %06o\n", 
               addr, newM & BITS18);
 }
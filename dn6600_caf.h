@@ -19,6 +19,47 @@ word36 fromMemory36(cpu_t *cpu, word15 addr, int charaddr);
 void toMemory  (cpu_t *cpu, word18 data, word15 addr, word3 charaddr);
 void toMemory36(cpu_t *cpu, word36 data, word15 addr, word3 charaddr);
 
+// Block store for IOM/DMA transfers and loaders
+void dmaToMemory(word15 addr, const word18 *data, unsigned int n);
+
+// Dirty page tracking: one bit per 64 words of M, set by every store path.
+// Anything that writes M directly must mark what it wrote.
+#define MEM_PAGE_SHIFT  6
+#define MEM_PAGE        (1 << MEM_PAGE_SHIFT)
+#define MEM_NPAGES      (MEM_SIZE / MEM_PAGE)
+#define MEM_DIRTY_WORDS (MEM_NPAGES / 64)
+
+extern uint64_t memDirty[MEM_DIRTY_WORDS];
+
+static inline void markDirty(word15 addr)
+{
+    memDirty[addr >> (MEM_PAGE_SHIFT + 6)] |= 1ull << ((addr >> MEM_PAGE_SHIFT) & 63);
+}
+
+void markDirtyRange(word15 addr, unsigned int n);
+void markAllDirty(void);
+
+// Copy out the bitmap and clear it; no bit set meanwhile is lost
+void snapDirty(uint64_t *bits);
+
+// Watchpoints: an attribute byte per word, brought up to date with the SCP
+// breakpoint table (BREAK -E/-R/-W addr) each time the CPU starts; only the
+// words flagged before and those in the table are touched. The access paths,
+// DMA included, look no further than memWatchArmed unless something is set.
+#define MA_EXEC         1
+#define MA_READ         2
+#define MA_WRITE        4
+#define MA_TRAP         8   // LASTWRITE (see reverse.h)
+
+extern uint8_t memAttr[MEM_SIZE];
+extern bool memWatchArmed;
+extern t_stat memWatchStop;     // set when a watchpoint fires; the CPU
+                                // stops after the current instruction
+
+void watchSync(void);
+void watchHit(word15 addr, uint8_t kind);
+void memTrapSet(word15 addr, bool on);
+
 bool doCAF(cpu_t *cpu, bool i, word2 t, word9 d, word15 *w, word3 *c);
 
 word18 readITD  (cpu_t *cpu, bool i, word2 t, word9 d);
@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "dn6600.h"
+#include "evq.h"
+
+// Children per heap node; four keeps a node's children in one cache line
+// and halves the depth of a binary heap.
+#define EVQ_D 4
+
+typedef struct
+  {
+    uint64_t due;   // instruction count, on sim_gtime
+    uint64_t seq;   // activation order, to break ties
+    UNIT * uptr;
+  } evqEntry;
+
+static struct
+  {
+    evqEntry * heap;
+    int n;
+    int size;
+    uint64_t seq;
+    bool servicing;  // the driver sets itself on the way out
+  } evq;
+
+static t_stat evqSvc (UNIT * uptr);
+
+// Not a device unit, so snapshots pass it over; they save the events it
+// stands for instead.
+static UNIT evqUnit = { UDATA (& evqSvc, 0, 0) };
+
+static uint64_t evqNow (void)
+  {
+    return (uint64_t) sim_gtime ();
+  }
+
+static bool before (const evqEntry * a, const evqEntry * b)
+  {
+    return a -> due < b -> due || (a -> due == b -> due && a -> seq < b -> seq);
+  }
+
+static void place (int i, evqEntry e)
+  {
+    evq.heap[i] = e;
+    e.uptr -> time = i + 1;
+  }
+
+static void siftUp (int i, evqEntry e)
+  {
+    while (i > 0)
+      {
+        int parent = (i - 1) / EVQ_D;
+        if (! before (& e, & evq.heap[parent]))
+          break;
+        place (i, evq.heap[parent]);
+        i = parent;
+      }
+    place (i, e);
+  }
+
+static void siftDown (int i, evqEntry e)
+  {
+    for (;;)
+      {
+        int first = i * EVQ_D + 1;
+        if (first >= evq.n)
+          break;
+        int end = first + EVQ_D < evq.n ? first + EVQ_D : evq.n;
+        int min = first;
+        for (int c = first + 1; c < end; c ++)
+          if (before (& evq.heap[c], & evq.heap[min]))
+            min = c;
+        if (! before (& evq.heap[min], & e))
+          break;
+        place (i, evq.heap[min]);
+        i = min;
+      }
+    place (i, e);
+  }
+
+static void removeAt (int i)
+  {
+    evq.heap[i].uptr -> time = 0;
+    evqEntry last = evq.heap[-- evq.n];
+    if (i == evq.n)
+      return;
+    if (i > 0 && before (& last, & evq.heap[(i - 1) / EVQ_D]))
+      siftUp (i, last);
+    else
+      siftDown (i, last);
+  }
+
+// Set the driver for the earliest event
+static void arm (void)
+  {
+    if (evq.servicing)
+      return;
+    sim_cancel (& evqUnit);
+    if (! evq.n)
+      return;
+    uint64_t now = evqNow ();
+    uint64_t due = evq.heap[0].due;
+    uint64_t d = due > now ? due - now : 0;
+    sim_activate (& evqUnit, d > INT32_MAX ? INT32_MAX : (int32) d);
+  }
+
+// Run everything that is due, as sim_process_event does: in order, until
+// an action returns other than SCPE_OK.
+static t_stat evqSvc (UNUSED UNIT * uptr)
+  {
+    t_stat reason = SCPE_OK;
+    uint64_t now = evqNow ();
+    evq.servicing = true;
+    while (reason == SCPE_OK && evq.n && evq.heap[0].due <= now)
+      {
+        UNIT * u = evq.heap[0].uptr;
+        removeAt (0);
+        if (u -> action)
+          reason = u -> action (u);
+      }
+    evq.servicing = false;
+    arm ();
+    return reason;
+  }
+
+bool evq_is_active (UNIT * uptr)
+  {
+    int i = uptr -> time - 1;
+    return i >= 0 && i < evq.n && evq.heap[i].uptr == uptr;
+  }
+
+t_stat evq_activate (UNIT * uptr, int32 delay)
+  {
+    if (evq_is_active (uptr))
+      return SCPE_OK;
+    if (evq.n == evq.size)
+      {
+        int size = evq.size ? evq.size * 2 : 64;
+        evqEntry * heap = realloc (evq.heap, (size_t) size * sizeof (evqEntry));
+        if (! heap)
+          return SCPE_MEM;
+        evq.heap = heap;
+        evq.size = size;
+      }
+    evqEntry e =
+      {
+        .due = evqNow () + (uint64_t) (delay > 0 ? delay : 0),
+        .seq = evq.seq ++,
+        .uptr = uptr
+      };
+    siftUp (evq.n ++, e);
+    if (uptr -> time == 1)
+      arm ();
+    return SCPE_OK;
+  }
+
+t_stat evq_cancel (UNIT * uptr)
+  {
+    if (! evq_is_active (uptr))
+      return SCPE_OK;
+    int i = uptr -> time - 1;
+    removeAt (i);
+    if (i == 0)
+      arm ();
+    return SCPE_OK;
+  }
+
+t_stat evq_activate_abs (UNIT * uptr, int32 delay)
+  {
+    evq_cancel (uptr);
+    return evq_activate (uptr, delay);
+  }
+
+int32 evq_activate_time (UNIT * uptr)
+  {
+    if (! evq_is_active (uptr))
+      return 0;
+    uint64_t now = evqNow ();
+    uint64_t due = evq.heap[uptr -> time - 1].due;
+    return (int32) (due > now ? due - now : 0) + 1;
+  }
+
+// Sort the heap in place, earliest first; a sorted array is still a heap.
+// A heapsort, as this runs in forked checkpoint writers, which must not
+// allocate.
+static void sortHeap (void)
+  {
+    int n = evq.n;
+    while (evq.n > 1)
+      {
+        evqEntry top = evq.heap[0];
+        evqEntry last = evq.heap[evq.n - 1];
+        evq.n --;
+        siftDown (0, last);
+        evq.heap[evq.n] = top;
+      }
+    evq.n = n;
+    for (int i = 0, j = n - 1; i < j; i ++, j --)
+      {
+        evqEntry t = evq.heap[i];
+        evq.heap[i] = evq.heap[j];
+        evq.heap[j] = t;
+      }
+    for (int i = 0; i < n; i ++)
+      evq.heap[i].uptr -> time = i + 1;
+  }
+
+int evq_get (UNIT * * units, int32 * delays, int max)
+  {
+    if (evq.n > max)
+      return -1;
+    sortHeap ();
+    uint64_t now = evqNow ();
+    for (int i = 0; i < evq.n; i ++)
+      {
+        uint64_t due = evq.heap[i].due;
+        units[i] = evq.heap[i].uptr;
+        delays[i] = (int32) (due > now ? due - now : 0);
+      }
+    return evq.n;
+  }
+
+void evq_clear (void)
+  {
+    for (int i = 0; i < evq.n; i ++)
+      evq.heap[i].uptr -> time = 0;
+    evq.n = 0;
+    arm ();
+  }
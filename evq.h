@@ -0,0 +1,24 @@
+// Event queue for many units
+//
+// SCP keeps its events on a delta list, so sim_activate walks the queue;
+// with a unit per communications line that walk dominates. Line units are
+// scheduled here instead, on a 4-ary heap ordered by due time, with ties
+// in activation order as on SCP's list; the heap is driven by one unit on
+// SCP's queue, set for the earliest event. For a handful of units SCP's
+// list is as quick or quicker; evqbench compares the two.
+//
+// The calls behave as their SCP namesakes. A unit is scheduled on one
+// queue or the other, never both: while it is on this one its 'time'
+// field, which SCP uses only for units on its own queue, holds its heap
+// slot.
+
+t_stat evq_activate (UNIT * uptr, int32 delay);
+t_stat evq_activate_abs (UNIT * uptr, int32 delay);
+t_stat evq_cancel (UNIT * uptr);
+bool evq_is_active (UNIT * uptr);
+int32 evq_activate_time (UNIT * uptr); // delay + 1; 0 if not queued
+
+// The queued units in the order they will run, with their delays from
+// now, for snapshots; -1 if there are more than 'max'.
+int evq_get (UNIT * * units, int32 * delays, int max);
+void evq_clear (void);
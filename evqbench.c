@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "dn6600.h"
+#include "evq.h"
+
+// Event queue stress: n units, each rescheduling itself with a random
+// delay as it fires, first on SCP's queue and then on evq. Delays average
+// n instructions, so about one event is due per instruction. Both runs
+// draw the same delays, so if the queues agree on the order events fire
+// in, the two orders checksum the same.
+//
+//   evqbench [units [events]]
+
+static uint32_t rnd;
+static int32 maxDelay;
+static uint64_t fired, target, sum;
+static double base;
+static bool onEvq;
+static UNIT * units;
+
+static int32 nextDelay (void)
+  {
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return 1 + (int32) (rnd % (uint32_t) maxDelay);
+  }
+
+static t_stat fire (UNIT * uptr)
+  {
+    fired ++;
+    sum = sum * 31 + (uint64_t) (uptr - units) * 7 + (uint64_t) (sim_gtime () - base);
+    int32 d = nextDelay ();
+    return onEvq ? evq_activate (uptr, d) : sim_activate (uptr, d);
+  }
+
+static double nowSec (void)
+  {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, & ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+  }
+
+// Returns ns per event
+static double run (int n, bool useEvq, uint64_t * check)
+  {
+    onEvq = useEvq;
+    rnd = 2463534242u;
+    fired = 0;
+    sum = 0;
+    base = sim_gtime ();
+    for (int i = 0; i < n; i ++)
+      {
+        int32 d = nextDelay ();
+        if (useEvq)
+          evq_activate (units + i, d);
+        else
+          sim_activate (units + i, d);
+      }
+    double t0 = nowSec ();
+    while (fired < target)
+      {
+        if (-- sim_interval <= 0)
+          sim_process_event ();
+      }
+    double t1 = nowSec ();
+    for (int i = 0; i < n; i ++)
+      {
+        if (useEvq)
+          evq_cancel (units + i);
+        else
+          sim_cancel (units + i);
+      }
+    * check = sum;
+    return (t1 - t0) * 1e9 / (double) fired;
+  }
+
+static void bench (int n)
+  {
+    units = calloc ((size_t) n, sizeof (UNIT));
+    if (! units)
+      exit (1);
+    for (int i = 0; i < n; i ++)
+      units[i].action = fire;
+    maxDelay = 2 * n;
+    uint64_t scpSum, evqSum;
+    double scpNs = run (n, false, & scpSum);
+    double evqNs = run (n, true, & evqSum);
+    printf ("%8d %12.1f %12.1f %8.1fx   %s\n", n, scpNs, evqNs, scpNs / evqNs,
+            scpSum == evqSum ? "same" : "DIFFERENT");
+    free (units);
+  }
+
+int main (int argc, char * argv [])
+  {
+    target = argc > 2 ? strtoull (argv[2], NULL, 0) : 200000;
+    printf ("   units  scp ns/event evq ns/event  speedup   order\n");
+    if (argc > 1)
+      {
+        bench (atoi (argv[1]));
+        return 0;
+      }
+    for (int n = 10; n <= 10000; n *= 10)
+      bench (n);
+    return 0;
+  }
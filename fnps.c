@@ -0,0 +1,387 @@
+#include <unistd.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "dn6600.h"
+#include "coupler.h"
+#include "fnps.h"
+
+t_stat detach_all (int32 start_device, t_bool shutdown);
+
+#define FNPS_MAX 8
+#define STOP_GRACE_MS 1000
+
+static struct
+  {
+    pid_t pid;           // running, if not 0
+    bool pinned;
+    int core;
+    char ini[PATH_MAX];
+    bool exited;         // has run and finished
+    int status;          // wait status when it did
+  } fnps[FNPS_MAX];
+
+static uint32_t nFNPs;
+
+#define FNP_UNIT { UDATA (NULL, UNIT_DISABLE | UNIT_DIS, 0), 0, 0, 0, 0, 0, NULL, NULL }
+
+static UNIT fnpsUnits[FNPS_MAX] =
+  {
+    FNP_UNIT, FNP_UNIT, FNP_UNIT, FNP_UNIT,
+    FNP_UNIT, FNP_UNIT, FNP_UNIT, FNP_UNIT
+  };
+
+static t_stat fnpsAttach (UNIT * uptr, char * cptr);
+static t_stat fnpsDetach (UNIT * uptr);
+
+#define FNP_NAME(n) ((char) ('a' + (n)))
+
+static int fnpNum (UNIT * uptr)
+  {
+    return (int) (uptr - fnpsUnits);
+  }
+
+static void fnpReap (int n, bool block)
+  {
+    if (! fnps[n].pid)
+      return;
+    int status;
+    pid_t pid = waitpid (fnps[n].pid, & status, block ? 0 : WNOHANG);
+    if (pid == 0)
+      return;
+    fnps[n].pid = 0;
+    fnps[n].exited = true;
+    fnps[n].status = pid < 0 ? -1 : status;
+  }
+
+static bool anyRunning (void)
+  {
+    bool running = false;
+    for (int n = 0; n < FNPS_MAX; n ++)
+      {
+        fnpReap (n, false);
+        if (fnps[n].pid)
+          running = true;
+      }
+    return running;
+  }
+
+// The child: everything in this process is now FNP n's alone. The exit
+// status carries the SCP status the FNP finished with.
+static void fnpChild (int n) NO_RETURN;
+static void fnpChild (int n)
+  {
+#ifdef __linux__
+    prctl (PR_SET_PDEATHSIG, SIGKILL);
+    if (fnps[n].pinned)
+      {
+        cpu_set_t set;
+        CPU_ZERO (& set);
+        CPU_SET (fnps[n].core, & set);
+        if (sched_setaffinity (0, sizeof (set), & set))
+          sim_printf ("FNP %c: unable to pin to core %d\n", FNP_NAME (n),
+                      fnps[n].core);
+      }
+#endif
+    t_stat r = SCPE_OK;
+    UNIT * uptr = fnpsUnits + n;
+    if (uptr -> flags & UNIT_ATT)
+      r = couplerDev.attach (couplerDev.units, uptr -> filename);
+    if (r == SCPE_OK)
+      {
+        if (fnps[n].ini[0])
+          r = do_cmd (0, fnps[n].ini);
+        else
+          r = run_cmd (RU_BOOT, "CPU");
+      }
+    detach_all (0, TRUE);
+    fflush (NULL);
+    _exit (SCPE_BARE_STATUS (r) & 0377);
+  }
+
+static t_stat fnpStart (int n)
+  {
+    fnpReap (n, false);
+    if (fnps[n].pid)
+      return SCPE_OK;
+    fflush (NULL);
+    pid_t pid = fork ();
+    if (pid < 0)
+      {
+        sim_printf ("FNP %c: fork failed\n", FNP_NAME (n));
+        return SCPE_IERR;
+      }
+    if (pid == 0)
+      fnpChild (n);
+    fnps[n].pid = pid;
+    fnps[n].exited = false;
+    return SCPE_OK;
+  }
+
+// SCP stops a running CPU on SIGTERM at its next event; an FNP that has
+// not stopped within the grace period, or is waiting for its host, is
+// killed.
+static void fnpStop (int n)
+  {
+    fnpReap (n, false);
+    if (! fnps[n].pid)
+      return;
+    kill (fnps[n].pid, SIGTERM);
+    struct timespec tick = { 0, 10000000 };
+    for (int i = 0; i < STOP_GRACE_MS / 10 && fnps[n].pid; i ++)
+      {
+        nanosleep (& tick, NULL);
+        fnpReap (n, false);
+      }
+    if (fnps[n].pid)
+      {
+        kill (fnps[n].pid, SIGKILL);
+        fnpReap (n, true);
+      }
+  }
+
+static t_stat fnpsAttach (UNIT * uptr, char * cptr)
+  {
+    if (! cptr || ! * cptr)
+      return SCPE_ARG;
+    if (uptr -> flags & UNIT_ATT)
+      detach_unit (uptr);
+    char * pfn = strdup (cptr);
+    if (! pfn)
+      return SCPE_MEM;
+    uptr -> filename = pfn;
+    uptr -> flags |= UNIT_ATT;
+    return SCPE_OK;
+  }
+
+static t_stat fnpsDetach (UNIT * uptr)
+  {
+    if ((uptr -> flags & UNIT_ATT) == 0)
+      return SCPE_OK;
+    fnpStop (fnpNum (uptr));
+    free (uptr -> filename);
+    uptr -> filename = NULL;
+    uptr -> flags &= ~UNIT_ATT;
+    return SCPE_OK;
+  }
+
+static t_stat fnpsSetCount (UNUSED UNIT * uptr, UNUSED int32 value,
+                            char * cptr, UNUSED void * desc)
+  {
+    if (! cptr)
+      return SCPE_ARG;
+    t_stat rc;
+    uint32_t n = (uint32_t) get_uint (cptr, 10, FNPS_MAX, & rc);
+    if (rc != SCPE_OK)
+      return rc;
+    if (anyRunning ())
+      {
+        sim_printf ("FNPs are running; SET FNP STOP first\n");
+        return SCPE_ALATT;
+      }
+    for (uint32_t i = 0; i < FNPS_MAX; i ++)
+      {
+        if (i < n)
+          fnpsUnits[i].flags &= ~UNIT_DIS;
+        else
+          {
+            detach_unit (fnpsUnits + i);
+            fnpsUnits[i].flags |= UNIT_DIS;
+          }
+      }
+    nFNPs = n;
+    return SCPE_OK;
+  }
+
+static t_stat fnpsShowCount (FILE * st, UNUSED UNIT * uptr,
+                             UNUSED int32 val, UNUSED void * desc)
+  {
+    fprintf (st, "count=%u", nFNPs);
+    return SCPE_OK;
+  }
+
+static t_stat fnpsSetCore (UNIT * uptr, UNUSED int32 value, char * cptr,
+                           UNUSED void * desc)
+  {
+    if (! cptr)
+      return SCPE_ARG;
+    t_stat rc;
+    long ncpu = sysconf (_SC_NPROCESSORS_CONF);
+    int core = (int) get_uint (cptr, 10, ncpu > 0 ? (t_value) ncpu - 1 : 0, & rc);
+    if (rc != SCPE_OK)
+      return rc;
+    fnps[fnpNum (uptr)].core = core;
+    fnps[fnpNum (uptr)].pinned = true;
+    return SCPE_OK;
+  }
+
+static t_stat fnpsClrCore (UNIT * uptr, UNUSED int32 value,
+                           UNUSED char * cptr, UNUSED void * desc)
+  {
+    fnps[fnpNum (uptr)].pinned = false;
+    return SCPE_OK;
+  }
+
+static t_stat fnpsShowCore (FILE * st, UNIT * uptr, UNUSED int32 val,
+                            UNUSED void * desc)
+  {
+    int n = fnpNum (uptr);
+    if (fnps[n].pinned)
+      fprintf (st, "core=%d", fnps[n].core);
+    else
+      fprintf (st, "not pinned");
+    return SCPE_OK;
+  }
+
+static t_stat fnpsSetIni (UNIT * uptr, UNUSED int32 value, char * cptr,
+                          UNUSED void * desc)
+  {
+    int n = fnpNum (uptr);
+    if (! cptr || ! * cptr)
+      {
+        fnps[n].ini[0] = 0;
+        return SCPE_OK;
+      }
+    if (strlen (cptr) >= sizeof (fnps[n].ini))
+      return SCPE_ARG;
+    strcpy (fnps[n].ini, cptr);
+    return SCPE_OK;
+  }
+
+static t_stat fnpsShowIni (FILE * st, UNIT * uptr, UNUSED int32 val,
+                           UNUSED void * desc)
+  {
+    int n = fnpNum (uptr);
+    if (fnps[n].ini[0])
+      fprintf (st, "ini=%s", fnps[n].ini);
+    else
+      fprintf (st, "boots");
+    return SCPE_OK;
+  }
+
+static t_stat fnpsShowState (FILE * st, UNUSED UNIT * uptr,
+                             UNUSED int32 val, UNUSED void * desc)
+  {
+    for (uint32_t n = 0; n < nFNPs; n ++)
+      {
+        fnpReap ((int) n, false);
+        fprintf (st, "FNP %c: ", FNP_NAME (n));
+        if (fnps[n].pid)
+          fprintf (st, "running, pid %d", (int) fnps[n].pid);
+        else if (! fnps[n].exited)
+          fprintf (st, "not started");
+        else if (fnps[n].status < 0)
+          fprintf (st, "lost");
+        else if (WIFSIGNALED (fnps[n].status))
+          fprintf (st, "killed by signal %d", WTERMSIG (fnps[n].status));
+        else if (WEXITSTATUS (fnps[n].status) == 0)
+          fprintf (st, "finished");
+        else if (WEXITSTATUS (fnps[n].status) < SCPE_BASE)
+          fprintf (st, "stopped: %s",
+                   sim_stop_messages[WEXITSTATUS (fnps[n].status)]);
+        else
+          fprintf (st, "stopped: %s",
+                   sim_error_text (WEXITSTATUS (fnps[n].status)));
+        fprintf (st, "\n");
+      }
+    return SCPE_OK;
+  }
+
+static t_stat fnpsSetStart (UNUSED UNIT * uptr, UNUSED int32 value,
+                            UNUSED char * cptr, UNUSED void * desc)
+  {
+    if (! nFNPs)
+      {
+        sim_printf ("no FNPs; SET FNP COUNT=n\n");
+        return SCPE_ARG;
+      }
+    // A child inherits whatever we have attached: our coupler, disk and tape
+    // images and line sockets would be shared by all of them. Each brings
+    // up its own instead.
+    for (int i = 0; sim_devices[i]; i ++)
+      {
+        DEVICE * dptr = sim_devices[i];
+        if (dptr == & fnpsDev)
+          continue;
+        for (uint32 u = 0; u < dptr -> numunits; u ++)
+          if (dptr -> units[u].flags & UNIT_ATT)
+            {
+              sim_printf ("DETACH %s first; each FNP attaches its own\n",
+                          sim_dname (dptr));
+              return SCPE_ALATT;
+            }
+      }
+    for (uint32_t n = 0; n < nFNPs; n ++)
+      {
+        t_stat r = fnpStart ((int) n);
+        if (r != SCPE_OK)
+          return r;
+      }
+    return SCPE_OK;
+  }
+
+static t_stat fnpsSetStop (UNUSED UNIT * uptr, UNUSED int32 value,
+                           UNUSED char * cptr, UNUSED void * desc)
+  {
+    for (int n = 0; n < FNPS_MAX; n ++)
+      fnpStop (n);
+    return SCPE_OK;
+  }
+
+static t_stat fnpsSetWait (UNUSED UNIT * uptr, UNUSED int32 value,
+                           UNUSED char * cptr, UNUSED void * desc)
+  {
+    for (int n = 0; n < FNPS_MAX; n ++)
+      fnpReap (n, true);
+    return SCPE_OK;
+  }
+
+static MTAB fnpsMod [] =
+  {
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, "COUNT", "COUNT", fnpsSetCount, fnpsShowCount, NULL, "Number of FNPs, a onwards" },
+    { MTAB_XTD | MTAB_VUN | MTAB_VALR, 0, "CORE", "CORE", fnpsSetCore, fnpsShowCore, NULL, "Pin the FNP to a core" },
+    { MTAB_XTD | MTAB_VUN, 0, NULL, "NOCORE", fnpsClrCore, NULL, NULL, "Let the FNP run on any core" },
+    { MTAB_XTD | MTAB_VUN | MTAB_VALR | MTAB_NC, 0, "INI", "INI", fnpsSetIni, fnpsShowIni, NULL, "Commands for the FNP to run in place of booting" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "STATE", NULL, NULL, fnpsShowState, NULL, "What each FNP is doing" },
+    { MTAB_XTD | MTAB_VDV, 0, NULL, "START", fnpsSetStart, NULL, NULL, "Start the FNPs that are not running" },
+    { MTAB_XTD | MTAB_VDV, 0, NULL, "STOP", fnpsSetStop, NULL, NULL, "Stop the FNPs" },
+    { MTAB_XTD | MTAB_VDV, 0, NULL, "WAIT", fnpsSetWait, NULL, NULL, "Wait for the FNPs to finish" },
+    { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+  };
+
+DEVICE fnpsDev =
+  {
+    "FNP",            /* name */
+    fnpsUnits,        /* units */
+    NULL,             /* registers */
+    fnpsMod,          /* modifiers */
+    FNPS_MAX,         /* #units */
+    10,               /* address radix */
+    1,                /* address width */
+    1,                /* address increment */
+    10,               /* data radix */
+    1,                /* data width */
+    NULL,             /* examine routine */
+    NULL,             /* deposit routine */
+    NULL,             /* reset routine */
+    NULL,             /* boot routine */
+    fnpsAttach,       /* attach routine */
+    fnpsDetach,       /* detach routine */
+    NULL,             /* context */
+    0,                /* flags */
+    0,                /* debug control flags */
+    NULL,             /* debug flag names */
+    NULL,             /* memory size change */
+    NULL,             /* logical name */
+    NULL,             // attach help
+    NULL,             // help
+    NULL,             // help context
+    NULL,             // device description
+  };
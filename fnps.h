@@ -0,0 +1,29 @@
+// Several FNPs from one configuration
+//
+// A site runs up to eight FNPs, a-h. Each is started as a process of its
+// own, forked from this one and optionally pinned to a core, with its own
+// coupler endpoint. A child inherits this process's open files and
+// sockets, so START is refused while any device other than FNP is
+// attached; each FNP attaches its own, in its INI file. Those that
+// attach nothing in common run independently, and throughput scales with
+// the number of cores.
+//
+// This does not reduce the number of processes: eight FNPs are still eight
+// processes. The CPU, coupler and IOM state and simh's device tables are
+// process globals, so FNPs cannot share one. What it gives is a single
+// configuration and point of control for all of them.
+//
+//   SET FNP COUNT=8
+//   ATTACH FNP0 6632::4500       coupler endpoint of FNP a
+//   SET FNP0 CORE=2              pin FNP a to core 2
+//   SET FNP0 INI=fnpa.ini        commands FNP a runs instead of booting
+//   SET FNP START                start those not already running
+//   SHOW FNP STATE
+//   SET FNP WAIT                 wait for them all to finish
+//   SET FNP STOP
+//
+// An FNP attaches its coupler endpoint, then runs its INI file if it has
+// one, or boots and waits for the host if not. An INI file that should
+// boot must say BOOT CPU itself.
+
+extern DEVICE fnpsDev;
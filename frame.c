@@ -0,0 +1,326 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "frame.h"
+
+//
+// CRCs
+//
+
+// Table k gives the CRC of a byte followed by k zero bytes, so eight bytes
+// are taken in one step of eight lookups
+typedef uint16_t crcTable [8] [256];
+
+static crcTable ccittTable, crc16Table;
+
+static void build (crcTable t, uint16_t poly)
+  {
+    for (int i = 0; i < 256; i ++)
+      {
+        uint16_t c = (uint16_t) i;
+        for (int b = 0; b < 8; b ++)
+          c = (c & 1) ? (uint16_t) ((c >> 1) ^ poly) : (uint16_t) (c >> 1);
+        t[0][i] = c;
+      }
+    for (int i = 0; i < 256; i ++)
+      for (int k = 1; k < 8; k ++)
+        t[k][i] = (uint16_t) ((t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff]);
+  }
+
+static uint16_t slice8 (crcTable t, uint16_t crc, const uint8_t * p, size_t n)
+  {
+    while (n >= 8)
+      {
+        crc ^= (uint16_t) (p[0] | (p[1] << 8));
+        crc = t[7][crc & 0xff] ^ t[6][crc >> 8] ^ t[5][p[2]] ^ t[4][p[3]] ^
+              t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        p += 8;
+        n -= 8;
+      }
+    while (n --)
+      crc = (uint16_t) ((crc >> 8) ^ t[0][(crc ^ * p ++) & 0xff]);
+    return crc;
+  }
+
+static void tables (void)
+  {
+    static bool built = false;
+    if (built)
+      return;
+    build (ccittTable, 0x8408);
+    build (crc16Table, 0xa001);
+    built = true;
+  }
+
+uint16_t crc_ccitt (uint16_t crc, const uint8_t * p, size_t n)
+  {
+    tables ();
+    return slice8 (ccittTable, crc, p, n);
+  }
+
+uint16_t crc_16 (uint16_t crc, const uint8_t * p, size_t n)
+  {
+    tables ();
+    return slice8 (crc16Table, crc, p, n);
+  }
+
+//
+// HDLC
+//
+
+#define FLAG 0176
+
+typedef struct
+  {
+    uint8_t * p;
+    size_t max, bits;
+  } bitWriter;
+
+static bool putBit (bitWriter * w, unsigned b)
+  {
+    size_t i = w -> bits >> 3;
+    if (i >= w -> max)
+      return false;
+    if (! (w -> bits & 7))
+      w -> p[i] = 0;
+    w -> p[i] |= (uint8_t) (b << (w -> bits & 7));
+    w -> bits ++;
+    return true;
+  }
+
+static bool putFlag (bitWriter * w)
+  {
+    for (int i = 0; i < 8; i ++)
+      if (! putBit (w, (FLAG >> i) & 1))
+        return false;
+    return true;
+  }
+
+static bool putStuffed (bitWriter * w, const uint8_t * p, size_t n,
+                        unsigned * ones)
+  {
+    for (size_t i = 0; i < n; i ++)
+      for (int b = 0; b < 8; b ++)
+        {
+          unsigned bit = (p[i] >> b) & 1;
+          if (! putBit (w, bit))
+            return false;
+          * ones = bit ? * ones + 1 : 0;
+          if (* ones == 5)
+            {
+              if (! putBit (w, 0))
+                return false;
+              * ones = 0;
+            }
+        }
+    return true;
+  }
+
+static size_t hdlcEncode (const uint8_t * in, size_t n, uint8_t * out,
+                          size_t max)
+  {
+    uint16_t fcs = (uint16_t) ~ crc_ccitt (0xffff, in, n);
+    uint8_t tail [2] = { (uint8_t) fcs, (uint8_t) (fcs >> 8) };
+    bitWriter w = { out, max, 0 };
+    unsigned ones = 0;
+    if (! putFlag (& w) || ! putStuffed (& w, in, n, & ones) ||
+        ! putStuffed (& w, tail, 2, & ones) || ! putFlag (& w))
+      return 0;
+    while (w . bits & 7)
+      putBit (& w, 1);  // idle
+    return w . bits >> 3;
+  }
+
+static int hdlcDecode (const uint8_t * in, size_t n, uint8_t * out,
+                       size_t max, size_t * len)
+  {
+    * len = 0;
+    size_t i = 0;
+    unsigned shift = 0;
+    // The opening flag
+    for (; i < n * 8; i ++)
+      {
+        shift = (shift >> 1) | (((in[i >> 3] >> (i & 7)) & 1u) << 7);
+        if (i >= 7 && shift == FLAG)
+          break;
+      }
+    if (i ++ >= n * 8)
+      return frameBad;
+    // Skip flags shared or repeated between frames
+    while (i + 8 <= n * 8)
+      {
+        unsigned f = 0;
+        for (int b = 0; b < 8; b ++)
+          f |= ((in[(i + b) >> 3] >> ((i + b) & 7)) & 1u) << b;
+        if (f != FLAG)
+          break;
+        i += 8;
+      }
+    bitWriter w = { out, max, 0 };
+    unsigned ones = 0;
+    for (; i < n * 8; i ++)
+      {
+        unsigned bit = (in[i >> 3] >> (i & 7)) & 1;
+        if (bit)
+          {
+            if (++ ones == 7)
+              return frameBad;  // abort
+          }
+        else
+          {
+            if (ones == 6)
+              {
+                // The closing flag; its first seven bits went in as data
+                if (w . bits < 7 || ((w . bits - 7) & 7))
+                  return frameBad;
+                size_t bytes = (w . bits - 7) >> 3;
+                if (bytes < 2)
+                  return frameBad;
+                uint16_t fcs = (uint16_t) ~ crc_ccitt (0xffff, out, bytes - 2);
+                * len = bytes - 2;
+                if (out[bytes - 2] != (uint8_t) fcs ||
+                    out[bytes - 1] != (uint8_t) (fcs >> 8))
+                  return frameBadCRC;
+                return frameOK;
+              }
+            bool stuffed = ones == 5;
+            ones = 0;
+            if (stuffed)
+              continue;
+          }
+        if (! putBit (& w, bit))
+          return frameBad;
+      }
+    return frameBad;
+  }
+
+//
+// BSC
+//
+
+enum
+  {
+    STX = 0x02,
+    ETX = 0x03,
+    DLE = 0x10,
+    SYN = 0x32,
+    PAD = 0xff
+  };
+
+static size_t bscEncode (const uint8_t * in, size_t n, uint8_t * out,
+                         size_t max)
+  {
+    size_t o = 0;
+#define PUT(c) do { if (o >= max) return 0; out[o ++] = (uint8_t) (c); } while (0)
+    PUT (SYN);
+    PUT (SYN);
+    if (n && n <= 2)
+      {
+        for (size_t i = 0; i < n; i ++)
+          PUT (in[i]);
+        PUT (PAD);
+        return o;
+      }
+    PUT (DLE);
+    PUT (STX);
+    for (size_t i = 0; i < n; i ++)
+      {
+        if (in[i] == DLE)
+          PUT (DLE);
+        PUT (in[i]);
+      }
+    PUT (DLE);
+    PUT (ETX);
+    uint8_t etx = ETX;
+    uint16_t crc = crc_16 (crc_16 (0, in, n), & etx, 1);
+    PUT (crc);
+    PUT (crc >> 8);
+    PUT (PAD);
+#undef PUT
+    return o;
+  }
+
+static int bscDecode (const uint8_t * in, size_t n, uint8_t * out,
+                      size_t max, size_t * len)
+  {
+    * len = 0;
+    size_t i = 0;
+    while (i < n && in[i] == SYN)
+      i ++;
+    if (i + 1 < n && in[i] == DLE && in[i + 1] == STX)
+      {
+        size_t o = 0;
+        for (i += 2; i < n; i ++)
+          {
+            uint8_t c = in[i];
+            if (c == DLE && i + 1 < n)
+              {
+                c = in[++ i];
+                if (c == SYN)
+                  continue;  // transparent idle
+                if (c == ETX)
+                  break;
+                if (c != DLE)
+                  return frameBad;
+              }
+            if (o >= max)
+              return frameBad;
+            out[o ++] = c;
+          }
+        if (i + 2 >= n)
+          return frameBad;
+        * len = o;
+        uint8_t etx = ETX;
+        uint16_t crc = crc_16 (crc_16 (0, out, o), & etx, 1);
+        if (in[i + 1] != (uint8_t) crc || in[i + 2] != (uint8_t) (crc >> 8))
+          return frameBadCRC;
+        return frameOK;
+      }
+    // Line control
+    size_t o = 0;
+    for (; i < n && in[i] != PAD; i ++)
+      {
+        if (o >= max)
+          return frameBad;
+        out[o ++] = in[i];
+      }
+    * len = o;
+    return o ? frameOK : frameBad;
+  }
+
+//
+// Either
+//
+
+size_t frame_encode (int kind, const uint8_t * in, size_t n, uint8_t * out,
+                     size_t max)
+  {
+    switch (kind)
+      {
+        case frameHDLC:
+          return hdlcEncode (in, n, out, max);
+        case frameBSC:
+          return bscEncode (in, n, out, max);
+        default:
+          if (n > max)
+            return 0;
+          memcpy (out, in, n);
+          return n;
+      }
+  }
+
+int frame_decode (int kind, const uint8_t * in, size_t n, uint8_t * out,
+                  size_t max, size_t * len)
+  {
+    switch (kind)
+      {
+        case frameHDLC:
+          return hdlcDecode (in, n, out, max, len);
+        case frameBSC:
+          return bscDecode (in, n, out, max, len);
+        default:
+          * len = n < max ? n : max;
+          memcpy (out, in, * len);
+          return n <= max ? frameOK : frameBad;
+      }
+  }
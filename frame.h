@@ -0,0 +1,41 @@
+// Synchronous line framing
+//
+// What a synchronous line carries, from the FNP's block of characters:
+//
+//   HDLC  flag 0176, the block and its FCS (CRC-16/CCITT, X.25 form)
+//         bit-stuffed, least significant bit first, flag; padded to a byte
+//         with ones
+//   BSC   SYN SYN DLE STX, the block with DLE doubled, DLE ETX, CRC-16,
+//         PAD (EBCDIC transparent text). A block of one or two characters
+//         is line control - ENQ, EOT, NAK, ACK0 and so on - and goes as
+//         SYN SYN, the characters, PAD, without a CRC
+//
+// Each runs on whole frames, a frame a TMXR packet, so the far end may be
+// another emulated FNP or a gateway to real modems. The packets carry no
+// TMXR frame byte: the flags and SYNs are in the frame, and this TMXR's
+// tmxr_get_packet_ln_ex loses a packet's last byte when given one.
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum { frameRaw, frameHDLC, frameBSC };
+
+// Frame decode results
+enum { frameOK, frameBadCRC, frameBad };
+
+// CRC-16/CCITT as HDLC sends it: reflected 0x1021, preset and inverted
+uint16_t crc_ccitt (uint16_t crc, const uint8_t * p, size_t n);
+// CRC-16 as BSC sends it: reflected 0x8005, preset to 0
+uint16_t crc_16 (uint16_t crc, const uint8_t * p, size_t n);
+
+// Frame n characters into out; returns the frame size, 0 if it would not
+// fit in max. FRAME_MAX (n) is always enough.
+#define FRAME_MAX(n) (2 * (n) + 16)
+size_t frame_encode (int kind, const uint8_t * in, size_t n, uint8_t * out,
+                     size_t max);
+
+// Take the characters out of a frame into out, a buffer of max bytes (HDLC
+// uses three more than there are characters, for the FCS); sets * len and
+// returns frameOK, frameBadCRC or, for anything else wrong, frameBad
+int frame_decode (int kind, const uint8_t * in, size_t n, uint8_t * out,
+                  size_t max, size_t * len);
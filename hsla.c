@@ -0,0 +1,876 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "dn6600.h"
+#include "dn6600_caf.h"
+#include "sim_tmxr.h"
+#include "iom.h"
+#include "evq.h"
+#include "muxpoll.h"
+#include "lineout.h"
+#include "frame.h"
+#include "xlate.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "hsla.h"
+
+#define HSLA_UNITS     (1 + 2 * HSLA_LINES)
+#define HSLA_POLL      1000    // instructions between adapter polls, untimed
+#define HSLA_CHARTIME  100     // instructions per character sent
+#define HSLA_TXBUF     16384   // per line; TMXR drops the oldest past this
+
+// Subchannel communications region, words from 01000 * n + 040 * s
+enum
+  {
+    hsRxICW = 0,
+    hsRxNext = 2,
+    hsTxICW = 4,
+    hsTxNext = 6,
+    hsStatus = 010
+  };
+
+enum
+  {
+    hsRxFull  = 0400000,
+    hsRxEnd   = 0200000,
+    hsTxDone  = 0100000,
+    hsConn    = 0040000,
+    hsConnChg = 0020000,
+    hsOverrun = 0010000,
+    hsBadICW  = 0004000,
+    hsBadCRC  = 0002000
+  };
+
+enum
+  {
+    pcwReceive = 01,
+    pcwSend = 02,
+    pcwStop = 03,
+    pcwAsync = 04,
+    pcwSync = 05,
+    pcwHangup = 06,
+    pcwRaw = 07,
+    pcwHDLC = 010,
+    pcwBSC = 011,
+    pcwASCII = 012,
+    pcwEBCDIC = 013,
+    pcwBCD = 014,
+    pcwUpper = 015
+  };
+
+// Replay channels: input on subchannel s of adapter a is logged on
+// 32 * a + s, and the line connecting or disconnecting on that plus 0400.
+// An input record is a flags byte, then the characters or frame.
+#define RR_CONN  0400
+#define RR_MORE  1     // more input was waiting
+#define RR_BAD   2     // a frame that failed its CRC or was malformed
+
+// The receive units carry the line's mode, a sync line's framing, and the
+// line's character set
+#define UNIT_V_SYNC  (UNIT_V_UF + 0)
+#define UNIT_SYNC    (1u << UNIT_V_SYNC)
+#define UNIT_V_FRAME (UNIT_V_UF + 1)
+#define UNIT_FRAME   (3u << UNIT_V_FRAME)
+#define UNIT_HDLC    ((uint32) frameHDLC << UNIT_V_FRAME)
+#define UNIT_BSC     ((uint32) frameBSC << UNIT_V_FRAME)
+#define UNIT_V_XLATE (UNIT_V_UF + 3)
+#define UNIT_XLATE   (3u << UNIT_V_XLATE)
+#define UNIT_EBCDIC  ((uint32) xlateEBCDIC << UNIT_V_XLATE)
+#define UNIT_BCD     ((uint32) xlateBCD << UNIT_V_XLATE)
+#define UNIT_UPPER   ((uint32) xlateUpper << UNIT_V_XLATE)
+
+typedef struct
+  {
+    bool connected;
+    bool receiving;
+    bool sending;
+    bool txBusy;       // a send is under way; the send unit ends it
+    double rxSince;    // when input was first left waiting; 0 if none is
+    double txStart;
+    uint64_t rxBytes, rxFrames, rxInts, rxLatSum, rxLatMax;
+    uint64_t txBytes, txFrames, txDone, txLatSum, txLatMax, txDrops;
+    uint64_t rxBad;
+  } hslaLine;
+
+typedef struct
+  {
+    TMXR mux;
+    TMLN ldsc [HSLA_LINES];
+    hslaLine line [HSLA_LINES];
+    uint32_t waiting;  // lines with input left over for want of an ICW
+    uint32_t unsent;   // async lines with output queued for the network
+    int32 chan;        // IOM channel
+    int32 level;       // interrupt level
+    int32 charTime;
+    int32 registered;  // channel claimed with the IOM, or -1
+  } hslaAdapter;
+
+static hslaAdapter adapters [HSLA_ADAPTERS] =
+  {
+    { .chan = 06, .level = 4, .charTime = HSLA_CHARTIME, .registered = -1 },
+    { .chan = 07, .level = 4, .charTime = HSLA_CHARTIME, .registered = -1 },
+    { .chan = 010, .level = 4, .charTime = HSLA_CHARTIME, .registered = -1 },
+  };
+
+static UNIT hslaUnits [HSLA_ADAPTERS] [HSLA_UNITS];
+
+static int adapterOf (UNIT * uptr)
+  {
+    return (int) ((uptr - & hslaUnits[0][0]) / HSLA_UNITS);
+  }
+
+static int indexOf (UNIT * uptr)
+  {
+    return (int) ((uptr - & hslaUnits[0][0]) % HSLA_UNITS);
+  }
+
+static UNIT * rxUnit (int a, int s)
+  {
+    return & hslaUnits[a][1 + s];
+  }
+
+static UNIT * txUnit (int a, int s)
+  {
+    return & hslaUnits[a][1 + HSLA_LINES + s];
+  }
+
+static word15 region (int a, int s)
+  {
+    return (word15) (01000 * (a + 1) + 040 * s);
+  }
+
+static bool isSync (int a, int s)
+  {
+    return (rxUnit (a, s) -> flags & UNIT_SYNC) != 0;
+  }
+
+static int framing (int a, int s)
+  {
+    return (int) ((rxUnit (a, s) -> flags & UNIT_FRAME) >> UNIT_V_FRAME);
+  }
+
+static void setFraming (int a, int s, int kind)
+  {
+    UNIT * u = rxUnit (a, s);
+    u -> flags = (u -> flags & ~ UNIT_FRAME) | ((uint32) kind << UNIT_V_FRAME);
+  }
+
+static int charSet (int a, int s)
+  {
+    return (int) ((rxUnit (a, s) -> flags & UNIT_XLATE) >> UNIT_V_XLATE);
+  }
+
+static void setCharSet (int a, int s, int kind)
+  {
+    UNIT * u = rxUnit (a, s);
+    u -> flags = (u -> flags & ~ UNIT_XLATE) | ((uint32) kind << UNIT_V_XLATE);
+  }
+
+static int rrChan (int a, int s)
+  {
+    return HSLA_LINES * a + s;
+  }
+
+static void post (int a, int s, word18 bits)
+  {
+    word15 at = region (a, s) + hsStatus;
+    word18 st = (cpu . M[at] & ~ (word18) hsConn) | bits;
+    if (adapters[a] . line[s] . connected)
+      st |= hsConn;
+    dmaToMemory (at, & st, 1);
+    iom_interrupt (adapters[a] . level, a);
+  }
+
+// The ICW at 'at' has run out: move up the next one, if the FNP has set it
+static void moveUp (word15 at)
+  {
+    word18 next[2] = { cpu . M[at + 2], cpu . M[at + 3] };
+    if (! (next[1] & BITS12))
+      return;
+    dmaToMemory (at, next, 2);
+    next[1] &= ~ (word18) BITS12;
+    dmaToMemory (at + 3, & next[1], 1);
+  }
+
+static uint64_t since (double t)
+  {
+    double d = sim_gtime () - t;
+    return d > 0 ? (uint64_t) d : 0;
+  }
+
+//
+// Receive
+//
+
+// Put input into the receive ICW
+static void deliver (int a, int s, uint8_t flags, const uint8_t * data,
+                     unsigned n)
+  {
+    hslaLine * l = & adapters[a] . line[s];
+    word15 rx = region (a, s) + hsRxICW;
+    if (flags & RR_BAD)
+      {
+        l -> rxBad ++;
+        post (a, s, hsBadCRC);
+        return;
+      }
+    word18 st = 0;
+    unsigned done = 0;
+    // Into the receive ICW, and on into the next one when it runs out
+    for (;;)
+      {
+        iomICW icw;
+        iom_get_icw (rx, & icw);
+        if (! icw . tally)
+          break;
+        unsigned k = iom_store_chars (& icw, data + done, n - done);
+        iom_put_icw (rx, & icw);
+        if (! k && n > done)
+          {
+            l -> receiving = false;
+            post (a, s, st | hsBadICW);
+            return;
+          }
+        done += k;
+        if (icw . tally)
+          break;
+        st |= hsRxFull;
+        moveUp (rx);
+        if (done == n)
+          break;
+      }
+    if (done < n)
+      st |= hsOverrun;
+    if (isSync (a, s))
+      {
+        st |= hsRxEnd;
+        l -> rxFrames ++;
+      }
+    else if (! (flags & RR_MORE))
+      st |= hsRxEnd;
+    l -> rxBytes += done;
+    if (st & hsRxEnd)
+      {
+        uint64_t lat = l -> rxSince ? since (l -> rxSince) : 0;
+        l -> rxLatSum += lat;
+        if (lat > l -> rxLatMax)
+          l -> rxLatMax = lat;
+        l -> rxInts ++;
+        l -> rxSince = 0;
+      }
+    post (a, s, st);
+  }
+
+static void setConnected (int a, int s, bool on)
+  {
+    hslaLine * l = & adapters[a] . line[s];
+    if (l -> connected == on)
+      return;
+    l -> connected = on;
+    if (! on)
+      {
+        l -> rxSince = 0;
+        adapters[a] . waiting &= ~ (1u << s);
+      }
+    post (a, s, hsConnChg);
+  }
+
+// Replay: hand over whatever HSLA input is due now, in the order it was
+// taken
+static void replayInput (void)
+  {
+    bool took;
+    do
+      {
+        took = false;
+        for (int a = 0; a < HSLA_ADAPTERS; a ++)
+          {
+            if (hslaDev[a] . flags & DEV_DIS)
+              continue;
+            for (int s = 0; s < HSLA_LINES; s ++)
+              {
+                uint8_t * p;
+                int n = rr_take (rrLine, RR_CONN + rrChan (a, s), & p, false);
+                if (n >= 0)
+                  {
+                    setConnected (a, s, n > 0 && p[0]);
+                    took = true;
+                    continue;
+                  }
+                n = rr_take (rrLine, rrChan (a, s), & p, false);
+                if (n >= 1)
+                  {
+                    deliver (a, s, p[0], p + 1, (unsigned) n - 1);
+                    took = true;
+                  }
+              }
+          }
+      }
+    while (took && rr_replaying ());
+  }
+
+static void connChange (int a, int s, bool on)
+  {
+    uint8_t b = on ? 1 : 0;
+    rr_record (rrLine, RR_CONN + rrChan (a, s), & b, 1);
+    setConnected (a, s, on);
+  }
+
+// Take what the line has, as far as the receive ICWs go
+static void receive (int a, int s)
+  {
+    hslaAdapter * ap = & adapters[a];
+    hslaLine * l = & ap -> line[s];
+    TMLN * lp = & ap -> ldsc[s];
+    uint8_t rec [1 + 4096];
+    ap -> waiting &= ~ (1u << s);
+    while (lp -> conn)
+      {
+        const uint8_t * frame = NULL;
+        size_t fsz = 0;
+        if (isSync (a, s))
+          {
+            if (! l -> receiving || ! (cpu . M[region (a, s) + hsRxICW + 1] & BITS12))
+              {
+                if (tmxr_rqln (lp))
+                  ap -> waiting |= 1u << s;
+                return;
+              }
+            int kind = framing (a, s);
+            tmxr_get_packet_ln (lp, & frame, & fsz);
+            if (! frame)
+              return;
+            if (! l -> rxSince)
+              l -> rxSince = sim_gtime ();
+            rec[0] = 0;
+            if (kind == frameRaw)
+              {
+                if (fsz > sizeof (rec) - 1)
+                  fsz = sizeof (rec) - 1;
+                memcpy (rec + 1, frame, fsz);
+              }
+            else if (frame_decode (kind, frame, fsz, rec + 1, sizeof (rec) - 1,
+                                   & fsz) != frameOK)
+              {
+                rec[0] = RR_BAD;
+                fsz = 0;
+              }
+          }
+        else
+          {
+            if (! tmxr_rqln (lp))
+              return;
+            if (! l -> rxSince)
+              l -> rxSince = sim_gtime ();
+            unsigned tally = cpu . M[region (a, s) + hsRxICW + 1] & BITS12;
+            if (! l -> receiving || ! tally)
+              {
+                ap -> waiting |= 1u << s;
+                return;
+              }
+            int32 c;
+            while (fsz < tally && (c = tmxr_getc_ln (lp)) & TMXR_VALID)
+              rec[1 + fsz ++] = (uint8_t) c;
+            rec[0] = tmxr_rqln (lp) ? RR_MORE : 0;
+          }
+        xlate (xlate_in (charSet (a, s)), rec + 1, fsz);
+        rr_record (rrLine, rrChan (a, s), rec, (int) fsz + 1);
+        deliver (a, s, rec[0], rec + 1, (unsigned) fsz);
+        if (! l -> receiving)
+          return;
+      }
+  }
+
+static t_stat hslaRxSvc (UNIT * uptr)
+  {
+    if (rr_replaying ())
+      replayInput ();
+    else
+      receive (adapterOf (uptr), indexOf (uptr) - 1);
+    return SCPE_OK;
+  }
+
+//
+// Send
+//
+
+static void sendDone (int a, int s)
+  {
+    hslaLine * l = & adapters[a] . line[s];
+    word15 tx = region (a, s) + hsTxICW;
+    moveUp (tx);
+    l -> txDone ++;
+    uint64_t lat = since (l -> txStart);
+    l -> txLatSum += lat;
+    if (lat > l -> txLatMax)
+      l -> txLatMax = lat;
+    l -> txStart = sim_gtime ();
+    if (! (cpu . M[tx + 1] & BITS12))
+      l -> sending = false;
+    post (a, s, hsTxDone);
+  }
+
+static void flushLine (int a, int s)
+  {
+    TMLN * lp = & adapters[a] . ldsc[s];
+    if (lp -> conn && ! lineout_flush (lp))
+      adapters[a] . unsent &= ~ (1u << s);
+  }
+
+static t_stat hslaTxSvc (UNIT * uptr)
+  {
+    int a = adapterOf (uptr);
+    int s = indexOf (uptr) - 1 - HSLA_LINES;
+    hslaAdapter * ap = & adapters[a];
+    hslaLine * l = & ap -> line[s];
+    TMLN * lp = & ap -> ldsc[s];
+    if (l -> txBusy)
+      {
+        l -> txBusy = false;
+        sendDone (a, s);
+      }
+    if (! l -> sending)
+      return SCPE_OK;
+    word15 tx = region (a, s) + hsTxICW;
+    iomICW icw;
+    iom_get_icw (tx, & icw);
+    unsigned n;
+    if (isSync (a, s) || rr_replaying ())
+      {
+        static uint8_t buf [4096], framed [FRAME_MAX (4096)];
+        n = iom_load_chars (& icw, buf, icw . tally);
+        if (n && ! rr_replaying ())
+          {
+            xlate (xlate_out (charSet (a, s)), buf, n);
+            int kind = framing (a, s);
+            size_t m = frame_encode (kind, buf, n, framed, sizeof (framed));
+            if (tmxr_put_packet_ln (lp, framed, m) != SCPE_OK)
+              l -> txDrops ++;
+          }
+      }
+    else
+      {
+        // Sent at the next poll, with whatever else the line has by then,
+        // or now if that is a lot
+        n = lineout_put_chars (lp, & icw, icw . tally,
+                               xlate_out (charSet (a, s)));
+        ap -> unsent |= 1u << s;
+        if (lineout_due (lp))
+          flushLine (a, s);
+      }
+    if (! n && icw . tally)
+      {
+        l -> sending = false;
+        post (a, s, hsBadICW);
+        return SCPE_OK;
+      }
+    iom_put_icw (tx, & icw);
+    l -> txBytes += n;
+    if (isSync (a, s))
+      l -> txFrames ++;
+    l -> txBusy = true;
+    return evq_activate (uptr, (int32) n * ap -> charTime);
+  }
+
+//
+// PCWs
+//
+
+static void hslaConnect (word6 chan, word36 pcw)
+  {
+    int a;
+    for (a = 0; a < HSLA_ADAPTERS; a ++)
+      if (adapters[a] . registered == (int32) chan)
+        break;
+    if (a == HSLA_ADAPTERS)
+      return;
+    int s = (int) ((pcw >> 6) & 037);
+    hslaLine * l = & adapters[a] . line[s];
+    switch (pcw & 077)
+      {
+        case pcwReceive:
+          l -> receiving = true;
+          evq_activate (rxUnit (a, s), 0);
+          break;
+        case pcwSend:
+          if (! l -> sending)
+            {
+              l -> sending = true;
+              l -> txStart = sim_gtime ();
+              if (! l -> txBusy)
+                evq_activate (txUnit (a, s), 0);
+            }
+          break;
+        case pcwStop:
+          l -> receiving = false;
+          l -> sending = false;
+          break;
+        case pcwAsync:
+          rxUnit (a, s) -> flags &= ~ UNIT_SYNC;
+          break;
+        case pcwSync:
+          rxUnit (a, s) -> flags |= UNIT_SYNC;
+          break;
+        case pcwRaw:
+          setFraming (a, s, frameRaw);
+          break;
+        case pcwHDLC:
+          setFraming (a, s, frameHDLC);
+          break;
+        case pcwBSC:
+          setFraming (a, s, frameBSC);
+          break;
+        case pcwASCII:
+          setCharSet (a, s, xlateASCII);
+          break;
+        case pcwEBCDIC:
+          setCharSet (a, s, xlateEBCDIC);
+          break;
+        case pcwBCD:
+          setCharSet (a, s, xlateBCD);
+          break;
+        case pcwUpper:
+          setCharSet (a, s, xlateUpper);
+          break;
+        case pcwHangup:
+          if (adapters[a] . ldsc[s] . conn && ! rr_replaying ())
+            tmxr_reset_ln (& adapters[a] . ldsc[s]);
+          setConnected (a, s, false);
+          break;
+        default:
+          sim_debug (DBG_DEBUG, & hslaDev[a], "PCW %012llo?\n",
+                     (unsigned long long) pcw);
+          break;
+      }
+  }
+
+//
+// Adapter
+//
+
+static t_stat hslaPollSvc (UNIT * uptr)
+  {
+    int a = adapterOf (uptr);
+    hslaAdapter * ap = & adapters[a];
+    if (rr_replaying ())
+      replayInput ();
+    else if (uptr -> flags & UNIT_ATT)
+      {
+        int32 ln;
+        while ((ln = muxpoll_conn (& ap -> mux)) >= 0)
+          {
+            ap -> ldsc[ln] . rcve = 1;
+            connChange (a, ln, true);
+          }
+        muxpoll_rx (& ap -> mux);
+        for (int s = 0; s < HSLA_LINES; s ++)
+          if (ap -> line[s] . connected && ! ap -> ldsc[s] . conn)
+            connChange (a, s, false);
+        for (uint32_t w = ap -> waiting; w; w &= w - 1)
+          receive (a, __builtin_ctz (w));
+        for (uint32_t w = ap -> unsent; w; w &= w - 1)
+          flushLine (a, __builtin_ctz (w));
+      }
+    return sim_clock_coschedule (uptr, HSLA_POLL);
+  }
+
+// Snapshot state: what the FNP has asked of each subchannel, as a bit a
+// subchannel, and the modes set by PCW
+typedef struct
+  {
+    uint32_t receiving, sending, txBusy;
+    uint32 mode [HSLA_LINES];
+  } hslaState;
+
+#define UNIT_MODE (UNIT_SYNC | UNIT_FRAME | UNIT_XLATE)
+
+static void hslaGet (DEVICE * dptr, void * buf)
+  {
+    int a = (int) (dptr - hslaDev);
+    hslaState * st = buf;
+    for (int s = 0; s < HSLA_LINES; s ++)
+      {
+        hslaLine * l = & adapters[a] . line[s];
+        st -> receiving |= (uint32_t) l -> receiving << s;
+        st -> sending |= (uint32_t) l -> sending << s;
+        st -> txBusy |= (uint32_t) l -> txBusy << s;
+        st -> mode[s] = rxUnit (a, s) -> flags & UNIT_MODE;
+      }
+  }
+
+static void hslaPut (DEVICE * dptr, const void * buf)
+  {
+    int a = (int) (dptr - hslaDev);
+    const hslaState * st = buf;
+    for (int s = 0; s < HSLA_LINES; s ++)
+      {
+        hslaLine * l = & adapters[a] . line[s];
+        l -> receiving = (st -> receiving >> s) & 1;
+        l -> sending = (st -> sending >> s) & 1;
+        l -> txBusy = (st -> txBusy >> s) & 1;
+        UNIT * u = rxUnit (a, s);
+        u -> flags = (u -> flags & ~ (uint32) UNIT_MODE) | st -> mode[s];
+      }
+  }
+
+static t_stat hslaReset (DEVICE * dptr)
+  {
+    int a = (int) (dptr - hslaDev);
+    hslaAdapter * ap = & adapters[a];
+    UNIT * u = hslaUnits[a];
+    ap -> mux . lines = HSLA_LINES;
+    ap -> mux . ldsc = ap -> ldsc;
+    ap -> mux . dptr = dptr;
+    u[0] . action = hslaPollSvc;
+    u[0] . flags |= UNIT_ATTABLE | UNIT_IDLE;
+    for (int s = 0; s < HSLA_LINES; s ++)
+      {
+        u[1 + s] . action = hslaRxSvc;
+        u[1 + HSLA_LINES + s] . action = hslaTxSvc;
+        u[1 + HSLA_LINES + s] . flags |= UNIT_DIS;  // kept out of SHOW
+        tmxr_set_line_unit (& ap -> mux, s, rxUnit (a, s));
+        tmxr_set_line_output_unit (& ap -> mux, s, txUnit (a, s));
+        evq_cancel (rxUnit (a, s));
+        evq_cancel (txUnit (a, s));
+        hslaLine * l = & ap -> line[s];
+        l -> receiving = l -> sending = l -> txBusy = false;
+      }
+    ap -> waiting = 0;
+    if (ap -> registered >= 0)
+      iom_unregister ((word6) ap -> registered);
+    ap -> registered = -1;
+    sim_cancel (u);
+    t_stat r = snapshot_register (dptr, sizeof (hslaState), hslaGet, hslaPut);
+    if (r != SCPE_OK || (dptr -> flags & DEV_DIS))
+      return r;
+    if (! iom_register ((word6) ap -> chan, hslaConnect))
+      {
+        sim_printf ("%s: channel %o is in use\n", dptr -> name, ap -> chan);
+        return SCPE_ARG;
+      }
+    ap -> registered = ap -> chan;
+    return sim_clock_coschedule (u, HSLA_POLL);
+  }
+
+static t_stat hslaAttach (UNIT * uptr, char * cptr)
+  {
+    int a = adapterOf (uptr);
+    hslaAdapter * ap = & adapters[a];
+    if (indexOf (uptr) != 0)
+      return SCPE_NOATT;
+    if (! ap -> mux . buffered)
+      ap -> mux . buffered = HSLA_TXBUF;
+    t_stat r = tmxr_attach (& ap -> mux, uptr, cptr);
+    if (r != SCPE_OK)
+      return r;
+    return muxpoll_attach (& ap -> mux);
+  }
+
+static t_stat hslaDetach (UNIT * uptr)
+  {
+    int a = adapterOf (uptr);
+    hslaAdapter * ap = & adapters[a];
+    if (! (uptr -> flags & UNIT_ATT))
+      return SCPE_OK;
+    muxpoll_detach (& ap -> mux);
+    t_stat r = tmxr_detach (& ap -> mux, uptr);
+    for (int s = 0; s < HSLA_LINES; s ++)
+      if (ap -> line[s] . connected)
+        connChange (a, s, false);
+    return r;
+  }
+
+//
+// SET and SHOW
+//
+
+static t_stat hslaSetChannel (UNIT * uptr, UNUSED int32 value, char * cptr,
+                              UNUSED void * desc)
+  {
+    t_stat r;
+    if (! cptr)
+      return SCPE_ARG;
+    int32 n = (int32) get_uint (cptr, 8, 077, & r);
+    if (r != SCPE_OK)
+      return r;
+    int a = adapterOf (uptr);
+    if (n != adapters[a] . registered && iom_claimed ((word6) n))
+      return SCPE_ARG;
+    adapters[a] . chan = n;
+    return hslaReset (& hslaDev[a]);
+  }
+
+static t_stat hslaShowChannel (FILE * st, UNIT * uptr, UNUSED int32 val,
+                               UNUSED void * desc)
+  {
+    fprintf (st, "channel=%o", adapters[adapterOf (uptr)] . chan);
+    return SCPE_OK;
+  }
+
+static t_stat hslaSetLevel (UNIT * uptr, UNUSED int32 value, char * cptr,
+                            UNUSED void * desc)
+  {
+    t_stat r;
+    if (! cptr)
+      return SCPE_ARG;
+    int32 n = (int32) get_uint (cptr, 10, 15, & r);
+    if (r != SCPE_OK)
+      return r;
+    adapters[adapterOf (uptr)] . level = n;
+    return SCPE_OK;
+  }
+
+static t_stat hslaShowLevel (FILE * st, UNIT * uptr, UNUSED int32 val,
+                             UNUSED void * desc)
+  {
+    fprintf (st, "level=%d", adapters[adapterOf (uptr)] . level);
+    return SCPE_OK;
+  }
+
+static t_stat hslaSetCharTime (UNIT * uptr, UNUSED int32 value, char * cptr,
+                               UNUSED void * desc)
+  {
+    t_stat r;
+    if (! cptr)
+      return SCPE_ARG;
+    int32 n = (int32) get_uint (cptr, 10, 100000, & r);
+    if (r != SCPE_OK)
+      return r;
+    adapters[adapterOf (uptr)] . charTime = n;
+    return SCPE_OK;
+  }
+
+static t_stat hslaShowCharTime (FILE * st, UNIT * uptr, UNUSED int32 val,
+                                UNUSED void * desc)
+  {
+    fprintf (st, "chartime=%d", adapters[adapterOf (uptr)] . charTime);
+    return SCPE_OK;
+  }
+
+static t_stat hslaSetMode (UNIT * uptr, UNUSED int32 value,
+                           UNUSED char * cptr, UNUSED void * desc)
+  {
+    int i = indexOf (uptr);
+    return i >= 1 && i <= HSLA_LINES ? SCPE_OK : SCPE_NOFNC;
+  }
+
+static t_stat hslaShowConn (FILE * st, UNIT * uptr, int32 val,
+                            UNUSED void * desc)
+  {
+    return tmxr_show_cstat (st, uptr, val, & adapters[adapterOf (uptr)] . mux);
+  }
+
+static t_stat hslaDisconnect (UNIT * uptr, int32 val, char * cptr,
+                              UNUSED void * desc)
+  {
+    return tmxr_dscln (uptr, val, cptr, & adapters[adapterOf (uptr)] . mux);
+  }
+
+static t_stat hslaShowPoll (FILE * st, UNIT * uptr, UNUSED int32 val,
+                            UNUSED void * desc)
+  {
+    muxpoll_show (st, & adapters[adapterOf (uptr)] . mux);
+    return SCPE_OK;
+  }
+
+// Latencies are in instructions: for input, from its first being seen to
+// the interrupt that ends it; for output, from the send PCW, or the end of
+// the previous ICW, to the end of the ICW.
+static t_stat hslaShowCounters (FILE * st, UNIT * uptr, UNUSED int32 val,
+                                UNUSED void * desc)
+  {
+    int a = adapterOf (uptr);
+    bool any = false;
+    for (int s = 0; s < HSLA_LINES; s ++)
+      {
+        hslaLine * l = & adapters[a] . line[s];
+        if (! l -> rxBytes && ! l -> txBytes && ! l -> connected)
+          continue;
+        any = true;
+        static const char * frames [] = { " raw", " HDLC", " BSC" };
+        fprintf (st, "subchannel %2d %s%s %s%s\n", s, isSync (a, s) ? "sync" : "async",
+                 isSync (a, s) ? frames[framing (a, s)] : "",
+                 xlate_name (charSet (a, s)), l -> connected ? ", connected" : "");
+        fprintf (st, "  in  %llu bytes, %llu frames, %llu ends, latency avg %llu max %llu, %llu bad\n",
+                 (unsigned long long) l -> rxBytes, (unsigned long long) l -> rxFrames,
+                 (unsigned long long) l -> rxInts,
+                 (unsigned long long) (l -> rxInts ? l -> rxLatSum / l -> rxInts : 0),
+                 (unsigned long long) l -> rxLatMax, (unsigned long long) l -> rxBad);
+        fprintf (st, "  out %llu bytes, %llu frames, %llu ICWs, latency avg %llu max %llu, %llu dropped\n",
+                 (unsigned long long) l -> txBytes, (unsigned long long) l -> txFrames,
+                 (unsigned long long) l -> txDone,
+                 (unsigned long long) (l -> txDone ? l -> txLatSum / l -> txDone : 0),
+                 (unsigned long long) l -> txLatMax, (unsigned long long) l -> txDrops);
+      }
+    if (! any)
+      fprintf (st, "no traffic\n");
+    return SCPE_OK;
+  }
+
+static MTAB hslaMod [] =
+  {
+    { UNIT_SYNC, 0, "async", "ASYNC", hslaSetMode, NULL, NULL, "Character stream (receive units)" },
+    { UNIT_SYNC, UNIT_SYNC, "sync", "SYNC", hslaSetMode, NULL, NULL, "Frame per packet (receive units)" },
+    { UNIT_FRAME, 0, "raw", "RAW", hslaSetMode, NULL, NULL, "Sync frames as they are (receive units)" },
+    { UNIT_FRAME, UNIT_HDLC, "HDLC", "HDLC", hslaSetMode, NULL, NULL, "HDLC framing and FCS (receive units)" },
+    { UNIT_FRAME, UNIT_BSC, "BSC", "BSC", hslaSetMode, NULL, NULL, "BSC transparent text and CRC (receive units)" },
+    { UNIT_XLATE, 0, "ASCII", "ASCII", hslaSetMode, NULL, NULL, "Characters as they are (receive units)" },
+    { UNIT_XLATE, UNIT_EBCDIC, "EBCDIC", "EBCDIC", hslaSetMode, NULL, NULL, "EBCDIC on the line (receive units)" },
+    { UNIT_XLATE, UNIT_BCD, "BCD", "BCD", hslaSetMode, NULL, NULL, "GE BCD on the line (receive units)" },
+    { UNIT_XLATE, UNIT_UPPER, "UPPER", "UPPER", hslaSetMode, NULL, NULL, "Upper case ASCII only (receive units)" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, "CHANNEL", "CHANNEL", hslaSetChannel, hslaShowChannel, NULL, "IOM channel, octal" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, "LEVEL", "LEVEL", hslaSetLevel, hslaShowLevel, NULL, "Interrupt level" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, "CHARTIME", "CHARTIME", hslaSetCharTime, hslaShowCharTime, NULL, "Instructions per character sent" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 1, "CONNECTIONS", NULL, NULL, hslaShowConn, NULL, "Line connections" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "STATISTICS", NULL, NULL, hslaShowConn, NULL, "Line statistics" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "COUNTERS", NULL, NULL, hslaShowCounters, NULL, "Bytes and latencies by subchannel" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "POLL", NULL, NULL, hslaShowPoll, NULL, "How the lines are polled" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "DISCONNECT", hslaDisconnect, NULL, NULL, "Disconnect a line" },
+    { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+  };
+
+static DEBTAB hslaDebug [] =
+  {
+    { "DEBUG", DBG_DEBUG },
+    { "XMT", TMXR_DBG_XMT },
+    { "RCV", TMXR_DBG_RCV },
+    { "CONNECT", TMXR_DBG_CON },
+    { NULL, 0 }
+  };
+
+#define HSLA_DEV(n, flags)                                              \
+  {                                                                     \
+    "HSLA" #n,        /* name */                                        \
+    hslaUnits[n - 1], /* units */                                       \
+    NULL,             /* registers */                                   \
+    hslaMod,          /* modifiers */                                   \
+    HSLA_UNITS,       /* #units */                                      \
+    10,               /* address radix */                               \
+    1,                /* address width */                               \
+    1,                /* address increment */                           \
+    10,               /* data radix */                                  \
+    1,                /* data width */                                  \
+    NULL,             /* examine routine */                             \
+    NULL,             /* deposit routine */                             \
+    hslaReset,        /* reset routine */                               \
+    NULL,             /* boot routine */                                \
+    hslaAttach,       /* attach routine */                              \
+    hslaDetach,       /* detach routine */                              \
+    NULL,             /* context */                                     \
+    DEV_DISABLE | DEV_DEBUG | DEV_MUX | (flags), /* flags */            \
+    0,                /* debug control flags */                         \
+    hslaDebug,        /* debug flag names */                            \
+    NULL,             /* memory size change */                          \
+    NULL,             /* logical name */                                \
+    NULL,             /* attach help */                                 \
+    NULL,             /* help */                                        \
+    NULL,             /* help context */                                \
+    NULL,             /* device description */                          \
+  }
+
+DEVICE hslaDev [HSLA_ADAPTERS] =
+  {
+    HSLA_DEV (1, 0),
+    HSLA_DEV (2, DEV_DIS),
+    HSLA_DEV (3, DEV_DIS)
+  };
@@ -0,0 +1,65 @@
+// High-speed line adapters
+//
+// Up to three HSLAs, devices HSLA1-HSLA3, of 32 subchannels each, on telnet
+// lines (TMXR). ATTACH HSLA1 <port> listens for them. Unit 0 is the adapter;
+// units 1-32 receive and units 33-64 send for subchannels 0-31. A subchannel
+// is async, a stream of characters, or sync, a frame per TMXR packet:
+// SET HSLA1<1+n> SYNC, or the set mode PCW. A sync subchannel's frames are
+// sent as they are, or framed as HDLC or BSC with their CRCs (see frame.h):
+// SET HSLA1<1+n> RAW, HDLC or BSC, or the framing PCWs. A subchannel whose
+// line does not carry ASCII has its characters translated, whole buffers
+// at a time (see xlate.h): SET HSLA1<1+n> ASCII, EBCDIC, BCD or UPPER, or
+// the character set PCWs.
+//
+// The adapter's I/O communications region is 01000 * n (n = 1-3), 01000
+// words; subchannel s has the 32 words from 040 * s:
+//
+//   +000  receive ICW          +004  send ICW
+//   +002  next receive ICW     +006  next send ICW
+//   +010  status
+//
+// When an ICW runs out the adapter moves the next one into its place and
+// clears the next one's tally; the FNP refills it. Status bits are set by
+// the adapter, and cleared by the FNP, but for 'connected', which the
+// adapter keeps current:
+//
+//   400000  receive ICW ran out
+//   200000  end of input: the line has nothing more for now, or end of frame
+//   100000  send ICW ran out
+//   040000  connected
+//   020000  connected or disconnected
+//   010000  input longer than the receive ICW and the next; the rest is lost
+//   004000  the ICW's character address is not a character; the adapter
+//           stops receiving or sending
+//   002000  a frame failed its CRC or was malformed, and was dropped
+//
+// Each status change sets sublevel n - 1 of the adapter's interrupt level
+// (SET HSLA1 LEVEL=n, default 4).
+//
+// PCWs go to the adapter's IOM channel (SET HSLA1 CHANNEL=n; 6, 7 and 010
+// by default). Bits 30-35 are the command, bits 25-29 the subchannel:
+//
+//   01  start receiving into the receive ICW
+//   02  start sending from the send ICW
+//   03  stop receiving and sending
+//   04  async
+//   05  sync
+//   06  disconnect the line
+//   07  sync frames raw
+//   10  HDLC framing
+//   11  BSC framing
+//   12  ASCII
+//   13  EBCDIC
+//   14  BCD
+//   15  upper case ASCII
+//
+// Subchannels are scheduled on evq, and only when there is something for
+// them: input, found by muxpoll, or a PCW. The adapter polls muxpoll on
+// each TIMER tick (see timer.h). A send takes CHARTIME instructions a
+// character (SET HSLA1 CHARTIME=n), whatever the network does with it, so
+// that runs replay exactly.
+
+#define HSLA_ADAPTERS 3
+#define HSLA_LINES    32
+
+extern DEVICE hslaDev [HSLA_ADAPTERS];
@@ -1,9 +1,142 @@
 #include "dn6600.h"
 #include "dn6600_caf.h"
+#include "iom.h"
 
-void iomCIOC (void)
+static iomConnectFn channels [64];
+
+bool iom_register (word6 chan, iomConnectFn fn)
+  {
+    if (channels[chan & BITS6])
+      return false;
+    channels[chan & BITS6] = fn;
+    return true;
+  }
+
+bool iom_claimed (word6 chan)
+  {
+    return channels[chan & BITS6] != NULL;
+  }
+
+void iom_unregister (word6 chan)
+  {
+    channels[chan & BITS6] = NULL;
+  }
+
+bool iomCIOC (void)
   {
     word36 PCW = fromMemory36 (& cpu, cpu . W, 1);
-    sim_printf ("PCW %012lo S %o\n", PCW, cpu . rIR & 077);
+    word6 S = cpu . rIR & BITS6;
+    if (channels[S])
+      {
+        channels[S] (S, PCW);
+        return true;
+      }
+    sim_printf ("PCW %012lo S %o\n", PCW, S);
+    return false;
+  }
+
+void iom_interrupt (int level, int sublevel)
+  {
+    word15 addr = (word15) (0400 + (level & 017));
+    word18 cell = cpu . M[addr] | (BIT0 >> sublevel);
+    dmaToMemory (addr, & cell, 1);
+  }
+
+void iom_get_icw (word15 at, iomICW * icw)
+  {
+    icw -> addr = cpu . M[at & BITS15];
+    icw -> tally = cpu . M[(at + 1) & BITS15] & BITS12;
+  }
+
+void iom_put_icw (word15 at, const iomICW * icw)
+  {
+    word18 w[2] =
+      {
+        icw -> addr,
+        (cpu . M[(at + 1) & BITS15] & ~ (word18) BITS12) | icw -> tally
+      };
+    dmaToMemory (at, w, 2);
+  }
+
+// Character geometry by C: size, shift of the character in the word, next
+// C, and whether the next character is in the next word
+static const struct
+  {
+    unsigned bits, shift;
+    word3 next;
+    bool carry;
+  } charPos [8] =
+  {
+    [0] = { 9, 9, 3, false },
+    [2] = { 9, 9, 3, false },
+    [3] = { 9, 0, 2, true },
+    [4] = { 6, 12, 5, false },
+    [5] = { 6, 6, 6, false },
+    [6] = { 6, 0, 4, true },
+  };
+
+// Characters are assembled a word at a time and stored in runs, so a
+// transfer marks memory dirty once per run rather than once a character.
+#define RUN 256
+
+unsigned iom_store_chars (iomICW * icw, const uint8_t * buf, unsigned n)
+  {
+    if (n > icw -> tally)
+      n = icw -> tally;
+    word15 w = _W (icw -> addr);
+    word3 c = _C (icw -> addr);
+    word18 run [RUN];
+    word15 runStart = w;
+    unsigned nRun = 0;
+    word18 cur = cpu . M[w];
+    bool partial = false;  // cur has characters not yet in run
+    unsigned i;
+    for (i = 0; i < n && charPos[c] . bits; i ++)
+      {
+        unsigned shift = charPos[c] . shift;
+        word18 mask = ((1u << charPos[c] . bits) - 1) << shift;
+        cur = (cur & ~ mask) | (((word18) buf[i] << shift) & mask);
+        partial = true;
+        if (charPos[c] . carry)
+          {
+            run[nRun ++] = cur;
+            partial = false;
+            w = (w + 1) & BITS15;
+            if (nRun == RUN || w == 0)
+              {
+                dmaToMemory (runStart, run, nRun);
+                runStart = w;
+                nRun = 0;
+              }
+            cur = cpu . M[w];
+          }
+        c = charPos[c] . next;
+      }
+    if (partial)
+      run[nRun ++] = cur;
+    if (nRun)
+      dmaToMemory (runStart, run, nRun);
+    icw -> tally -= i;
+    icw -> addr = ((word18) c << 15) | w;
+    return i;
   }
 
+unsigned iom_load_chars (iomICW * icw, uint8_t * buf, unsigned n)
+  {
+    if (n > icw -> tally)
+      n = icw -> tally;
+    word15 w = _W (icw -> addr);
+    word3 c = _C (icw -> addr);
+    unsigned i;
+    for (i = 0; i < n && charPos[c] . bits; i ++)
+      {
+        unsigned bits = charPos[c] . bits, shift = charPos[c] . shift;
+        buf[i] = (uint8_t) ((cpu . M[w] >> shift) & ((1u << bits) - 1));
+        if (charPos[c] . carry)
+          w = (w + 1) & BITS15;
+        c = charPos[c] . next;
+      }
+    icw -> tally -= i;
+    icw -> addr = ((word18) c << 15) | w;
+    return i;
+  }
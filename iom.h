@@ -47,4 +47,42 @@
 //    0     6
 
 
-void iomCIOC (void);
+// Channels
+//
+// CIOC sends its PCW to the channel in the I/O channel select register (SEL,
+// IR bits 12-17). A device claims its channel number at reset; a PCW for a
+// channel nobody has claimed is only reported, and CIOC goes on to fail as
+// unimplemented.
+
+typedef void (* iomConnectFn) (word6 chan, word36 pcw);
+
+// False, leaving the channel as it was, if another device has claimed it
+bool iom_register (word6 chan, iomConnectFn fn);
+bool iom_claimed (word6 chan);
+void iom_unregister (word6 chan);
+bool iomCIOC (void);
+
+// Set sublevel 'sublevel' (0-17) pending in the cell of interrupt level
+// 'level' (0-15), M[0400 + level]
+void iom_interrupt (int level, int sublevel);
+
+// Indirect control word: two words in memory, the character address of the
+// next character (C and W, as in an index register) and, in the low 12 bits
+// of the second, the number of characters left. Characters are 9-bit
+// (C = 2, 3) or 6-bit (C = 4, 5, 6); C = 0 starts at 9-bit character 0 of
+// the word.
+
+typedef struct
+  {
+    word18 addr;
+    word12 tally;
+  } iomICW;
+
+void iom_get_icw (word15 at, iomICW * icw);
+void iom_put_icw (word15 at, const iomICW * icw);
+
+// Move up to n characters between buf and memory at the ICW, advancing it;
+// returns the number moved, which is short when the tally runs out or the
+// ICW's C is not a character position (1 or 7).
+unsigned iom_store_chars (iomICW * icw, const uint8_t * buf, unsigned n);
+unsigned iom_load_chars (iomICW * icw, uint8_t * buf, unsigned n);
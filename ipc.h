@@ -13,3 +13,26 @@
 
 enum { diaCmdDMA = 1 };
 
+// Capabilities exchange
+//
+// Each end announces what it can do with a short control packet, which
+// older peers ignore as an unknown command. An announcement is answered
+// with a reply, and the reply with an acknowledgement; an end takes up an
+// encoding both have offered once it has sent or received the
+// acknowledgement, so neither uses it before the other knows of it. An
+// announcement starts the exchange over, on the old encoding.
+//
+// With RELIABLE the packets are framed by rlink like the data, so the
+// switch falls at the same point in the stream at both ends. Over bare UDP
+// a lost acknowledgement leaves the ends disagreeing, as any loss there
+// loses data.
+//
+//   0  0327
+//   1  version
+//   2  capabilities
+//   3  capsAnnounce, capsReply or capsAck
+
+enum { capsMagic = 0327, capsVersion = 2, capsSz = 4 };
+enum { capsAnnounce = 0, capsReply = 1, capsAck = 2 };
+enum { capPack36 = 1 };   // word36 payloads packed as in pack36.h
+
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dn6600.h"
+#include "dn6600_caf.h"
+#include "sim_sock.h"
+#include "coupler.h"
+#include "iom.h"
+#include "libdn6600.h"
+
+t_stat sim_brk_init (void);
+t_stat detach_all (int32 start_device, t_bool shutdown);
+char * sim_trim_endspc (char * cptr);
+
+struct dn6600
+  {
+    dn6600_dia_fn toHost;
+    void * ctx;
+  };
+
+static dn6600 theFNP;
+static bool inUse;
+static bool scpReady;
+
+// Ends a burst of dn6600_step
+static t_stat stopSvc (UNUSED UNIT * uptr)
+  {
+    return SCPE_STOP;
+  }
+
+static UNIT stopUnit = { UDATA (& stopSvc, 0, 0) };
+
+// What SCP's main does before reading commands, less the console, the
+// banner and the startup files.
+static t_stat scpInit (void)
+  {
+    if (scpReady)
+      return SCPE_OK;
+    sim_quiet = 1;
+    sim_finit ();
+    sim_timer_init ();
+    sim_init_sock ();   // line devices listen for connections
+    sim_eval = (t_value *) calloc ((size_t) sim_emax, sizeof (t_value));
+    if (! sim_eval)
+      return SCPE_MEM;
+    t_stat r = reset_all_p (0);
+    if (r != SCPE_OK)
+      return r;
+    r = sim_brk_init ();
+    if (r != SCPE_OK)
+      return r;
+    if (sim_dflt_dev == NULL)
+      sim_dflt_dev = sim_devices[0];
+    scpReady = true;
+    return SCPE_OK;
+  }
+
+dn6600 * dn6600_create (dn6600_dia_fn toHost, void * ctx)
+  {
+    if (inUse || scpInit () != SCPE_OK)
+      return NULL;
+    dn6600 * fnp = & theFNP;
+    fnp -> toHost = toHost;
+    fnp -> ctx = ctx;
+    if (toHost && coupler_attach_direct (toHost, ctx) != SCPE_OK)
+      return NULL;
+    cpuDriven = true;
+    inUse = true;
+    return fnp;
+  }
+
+void dn6600_destroy (dn6600 * fnp)
+  {
+    if (fnp != & theFNP || ! inUse)
+      return;
+    detach_all (0, TRUE);
+    cpuDriven = false;
+    inUse = false;
+  }
+
+int dn6600_command (UNUSED dn6600 * fnp, const char * cmd)
+  {
+    char buf[CBUFSIZE], gbuf[CBUFSIZE];
+    strncpy (buf, cmd, sizeof (buf) - 1);
+    buf[sizeof (buf) - 1] = 0;
+    sim_trim_endspc (buf);
+    char * cptr = get_glyph (buf, gbuf, 0);
+    CTAB * cmdp = find_cmd (gbuf);
+    if (! cmdp)
+      return SCPE_UNK;
+    return SCPE_BARE_STATUS (cmdp -> action (cmdp -> arg, cptr));
+  }
+
+int dn6600_load (UNUSED dn6600 * fnp, const char * path, bool gicbOnly)
+  {
+    FILE * f = fopen (path, "rb");
+    if (! f)
+      return SCPE_OPENERR;
+    sim_switches = gicbOnly ? SWMASK ('G') : 0;
+    t_stat r = sim_load (f, NULL, (char *) path, 0);
+    sim_switches = 0;
+    fclose (f);
+    return r;
+  }
+
+int dn6600_step (UNUSED dn6600 * fnp, uint64_t n, uint64_t * done)
+  {
+    double start = sim_gtime ();
+    t_stat r = SCPE_OK;
+    for (;;)
+      {
+        uint64_t ran = (uint64_t) (sim_gtime () - start);
+        if (ran >= n)
+          break;
+        uint64_t left = n - ran;
+        sim_activate (& stopUnit, left > INT32_MAX ? INT32_MAX : (int32) left);
+        r = sim_instr ();
+        sim_cancel (& stopUnit);
+        if (r != SCPE_STOP)
+          break;
+        r = SCPE_OK;
+      }
+    if (done)
+      * done = (uint64_t) (sim_gtime () - start);
+    return r;
+  }
+
+int dn6600_dia_mailbox (UNUSED dn6600 * fnp, const uint8_t * data, int sz)
+  {
+    return coupler_inject (data, sz);
+  }
+
+int dn6600_interrupt (UNUSED dn6600 * fnp, int level, int sublevel)
+  {
+    if (level < 0 || level > 15 || sublevel < 0 || sublevel > 17)
+      return SCPE_ARG;
+    iom_interrupt (level, sublevel);
+    return SCPE_OK;
+  }
+
+int dn6600_read (UNUSED dn6600 * fnp, uint32_t addr, uint32_t * words,
+                 unsigned int n)
+  {
+    for (unsigned int i = 0; i < n; i ++)
+      words[i] = cpu . M[(addr + i) & BITS15];
+    return SCPE_OK;
+  }
+
+int dn6600_write (UNUSED dn6600 * fnp, uint32_t addr, const uint32_t * words,
+                  unsigned int n)
+  {
+    dmaToMemory ((word15) (addr & BITS15), words, n);
+    return SCPE_OK;
+  }
@@ -0,0 +1,65 @@
+// libdn6600: the FNP as a library
+//
+// For a host system emulator that wants to run the FNP in its own process,
+// from its own event loop: the coupler is replaced by direct calls, with
+// DIA traffic handed across in memory rather than over a socket.
+//
+//   make libdn6600.a
+//
+// The library carries its own copy of SCP (with SCP's main renamed), so
+// only one FNP can be created per process, and a host that is itself built
+// on SCP must keep the two apart, e.g. by loading the library into its own
+// symbol namespace.
+//
+// Calls are not thread safe, with the exception of dn6600_dia_mailbox,
+// which may be called from any thread while the FNP runs.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct dn6600 dn6600;
+
+// Packets from the FNP to the host, in the coupler's format; the packet is
+// valid only for the duration of the call.
+typedef void (* dn6600_dia_fn) (void * ctx, uint8_t * data, int sz);
+
+// Stop codes returned by dn6600_step
+enum { dn6600StopBreakpoint = 1, dn6600StopWatchpoint = 2 };
+
+// Returns NULL if an FNP already exists. toHost may be NULL, leaving the
+// coupler unattached until a command attaches it.
+dn6600 * dn6600_create (dn6600_dia_fn toHost, void * ctx);
+void dn6600_destroy (dn6600 * fnp);
+
+// Run one SCP command (SET, ATTACH, BREAK, ...); returns the SCP status,
+// 0 for success.
+int dn6600_command (dn6600 * fnp, const char * cmd);
+
+// Load a load_fnp_ boot segment (see sim_load in dn6600.c); 'gicbOnly'
+// loads just the GICB, for a two stage boot over the DIA.
+int dn6600_load (dn6600 * fnp, const char * path, bool gicbOnly);
+
+// Run n instructions. Returns 0 if all were run, otherwise the reason the
+// FNP stopped early: one of the stop codes above, or an SCP status. The
+// count actually run is returned through 'done', if not NULL.
+int dn6600_step (dn6600 * fnp, uint64_t n, uint64_t * done);
+
+// Queue a packet from the host, as the coupler would have received it.
+// Returns -1 if the receive pool is full; the host retries later.
+//
+// A boot (BOOT CPU, or a bootload over the DIA) waits in the coupler for
+// the host: for the Bootload, then, after handing the Input Stored Boot
+// IOLD to toHost, for the GICB. A wait blocks until a packet is queued, so
+// a host that boots from the thread that drives it must queue the Bootload
+// and the GICB, in that order, before the boot command; they are taken in
+// turn. Otherwise it runs the boot on a thread of its own and answers from
+// its own, as it would over a socket.
+int dn6600_dia_mailbox (dn6600 * fnp, const uint8_t * data, int sz);
+
+// Set the bit for 'sublevel' (0-17) in the interrupt cell of 'level'
+// (0-15), at 00400 + level.
+int dn6600_interrupt (dn6600 * fnp, int level, int sublevel);
+
+// FNP memory, 18 bit words; addresses wrap at 32K.
+int dn6600_read (dn6600 * fnp, uint32_t addr, uint32_t * words, unsigned int n);
+int dn6600_write (dn6600 * fnp, uint32_t addr, const uint32_t * words, unsigned int n);
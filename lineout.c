@@ -0,0 +1,176 @@
+#include <stdbool.h>
+#include <string.h>
+
+#if defined (__unix__) || defined (__APPLE__)
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#define LINEOUT_SENDMSG
+#endif
+
+#include "dn6600.h"
+#include "sim_tmxr.h"
+#include "iom.h"
+#include "lineout.h"
+#include "xlate.h"
+
+#define CHUNK 256
+#define TN_IAC 0xFF  // telnet's escape; a data byte of 0377 is sent twice
+
+static int32 queued (TMLN * lp)
+  {
+    int32 n = lp -> txbpi - lp -> txbpr;
+    return n < 0 ? n + lp -> txbsz : n;
+  }
+
+// Append to the ring; a buffered line loses its oldest output to make room
+static void ring (TMLN * lp, const uint8_t * buf, unsigned n)
+  {
+    while (n)
+      {
+        unsigned k = (unsigned) (lp -> txbsz - lp -> txbpi);
+        if (k > n)
+          k = n;
+        int32 before = queued (lp);
+        memcpy (lp -> txb + lp -> txbpi, buf, k);
+        lp -> txbpi = (lp -> txbpi + (int32) k) % lp -> txbsz;
+        if (before + (int32) k >= lp -> txbsz)
+          {
+            int32 lost = before + (int32) k - (lp -> txbsz - 1);
+            lp -> txbpr = (lp -> txbpi + 1) % lp -> txbsz;
+            lp -> txdrp += lost;
+          }
+        buf += k;
+        n -= k;
+      }
+  }
+
+unsigned lineout_put (TMLN * lp, const uint8_t * buf, unsigned n)
+  {
+    bool telnet = ! lp -> notelnet;
+    if (! lp -> conn && (! lp -> txbfd || ! telnet))
+      {
+        lp -> txdrp += (int32) n;
+        return n;
+      }
+    // Anything tmxr_putc_ln does besides queueing is left to it
+    if (lp -> txlog || lp -> expect . size)
+      {
+        unsigned i;
+        for (i = 0; i < n; i ++)
+          if (tmxr_putc_ln (lp, buf[i]) == SCPE_STALL)
+            break;
+        return i;
+      }
+    unsigned done = 0;
+    bool full = false;
+    while (done < n && ! full)
+      {
+        const uint8_t * iac = telnet ? memchr (buf + done, TN_IAC, n - done) : NULL;
+        unsigned k = iac ? (unsigned) (iac - buf) - done : n - done;
+        if (! lp -> txbfd)
+          {
+            // An unbuffered line keeps a slot free, as TMXR does
+            int32 room = lp -> txbsz - queued (lp) - 1;
+            if ((int32) k + (iac ? 2 : 0) > room)
+              {
+                if ((int32) k > room)
+                  k = room > 0 ? (unsigned) room : 0;
+                iac = NULL;
+                full = true;
+              }
+          }
+        ring (lp, buf + done, k);
+        done += k;
+        if (iac)
+          {
+            ring (lp, buf + done, 1);  // the IAC twice
+            ring (lp, buf + done, 1);
+            done ++;
+          }
+      }
+    if (! lp -> txbfd && (full || lp -> txbsz - queued (lp) <= TMXR_GUARD))
+      lp -> xmte = 0;
+    return done;
+  }
+
+unsigned lineout_put_chars (TMLN * lp, iomICW * icw, unsigned n,
+                            const uint8_t * table)
+  {
+    uint8_t buf [CHUNK];
+    unsigned done = 0;
+    while (done < n)
+      {
+        iomICW at = * icw;
+        unsigned want = n - done < CHUNK ? n - done : CHUNK;
+        unsigned k = iom_load_chars (icw, buf, want);
+        xlate (table, buf, k);
+        unsigned put = lineout_put (lp, buf, k);
+        if (put < k)
+          {
+            // Take back what did not fit
+            * icw = at;
+            iom_load_chars (icw, buf, put);
+            return done + put;
+          }
+        done += k;
+        if (k < want)
+          break;
+      }
+    return done;
+  }
+
+bool lineout_due (TMLN * lp)
+  {
+    return queued (lp) >= LINEOUT_HIGHWATER;
+  }
+
+// lineout_put stops the line when the ring fills; let it go again once
+// there is room, as tmxr_poll_tx does when the ring empties
+static int32 sent (TMLN * lp, int32 left)
+  {
+    if (! lp -> txbfd && lp -> txbsz - left > TMXR_GUARD)
+      lp -> xmte = 1;
+    return left;
+  }
+
+int32 lineout_flush (TMLN * lp)
+  {
+    int32 n = queued (lp);
+    if (! lp -> conn)
+      return n;
+    if (! n)
+      return sent (lp, 0);
+#ifdef LINEOUT_SENDMSG
+    if (lp -> sock && ! lp -> serport && ! lp -> loopback && ! lp -> datagram &&
+        ! (lp -> mp && lp -> mp -> dptr &&
+           (lp -> mp -> dptr -> dctrl & TMXR_DBG_XMT)))
+      {
+        struct iovec iov [2];
+        int cnt = 1;
+        iov[0] . iov_base = lp -> txb + lp -> txbpr;
+        if (lp -> txbpr < lp -> txbpi)
+          iov[0] . iov_len = (size_t) n;
+        else
+          {
+            iov[0] . iov_len = (size_t) (lp -> txbsz - lp -> txbpr);
+            iov[1] . iov_base = lp -> txb;
+            iov[1] . iov_len = (size_t) lp -> txbpi;
+            cnt = lp -> txbpi ? 2 : 1;
+          }
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = (size_t) cnt };
+        ssize_t w = sendmsg (lp -> sock, & msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w >= 0)
+          {
+            lp -> txbpr = (lp -> txbpr + (int32) w) % lp -> txbsz;
+            lp -> txcnt += (int32) w;
+            return sent (lp, n - (int32) w);
+          }
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+          return n;
+        // Let TMXR see the error and close the line
+      }
+#endif
+    return sent (lp, tmxr_send_buffered_data (lp));
+  }
@@ -0,0 +1,30 @@
+// Bulk output to TMXR lines
+//
+// tmxr_putc_ln queues a character at a time, and tmxr_send_buffered_data
+// writes the queue in up to two calls where it wraps; a device that sends
+// a character, then flushes, pays a system call per character. These put
+// a run of characters at once, straight from FNP memory through an ICW,
+// and leave the sending to lineout_flush, which writes the whole queue in
+// one scatter-gather call. A device calls it from its own tick for the
+// lines it has put to, or at once when lineout_put_chars says the queue is
+// past LINEOUT_HIGHWATER, so a screenful to many lines goes in a few large
+// writes rather than many small ones.
+//
+// Telnet IACs are doubled, buffered lines drop their oldest output when
+// full, and unbuffered lines take only what fits, as with tmxr_putc_ln.
+
+#define LINEOUT_HIGHWATER 1024
+
+// Queue up to n characters from the ICW, advancing it, translated by table
+// (see xlate.h) if it is not NULL; returns the number taken. Characters for
+// a line that is neither connected nor buffered are taken and lost.
+unsigned lineout_put_chars (TMLN * lp, iomICW * icw, unsigned n,
+                            const uint8_t * table);
+unsigned lineout_put (TMLN * lp, const uint8_t * buf, unsigned n);
+
+// Past the high-water mark, so worth flushing before the next tick
+bool lineout_due (TMLN * lp);
+
+// Send what the line has queued; returns the bytes still queued. Does
+// nothing on a line that is not connected.
+int32 lineout_flush (TMLN * lp);
@@ -0,0 +1,742 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "dn6600.h"
+#include "dn6600_caf.h"
+#include "sim_tmxr.h"
+#include "iom.h"
+#include "muxpoll.h"
+#include "lineout.h"
+#include "xlate.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "utils.h"
+#include "lsla.h"
+
+#define LSLA_ALL    (LSLA_ADAPTERS * LSLA_LINES)
+#define LSLA_TICK   1000    // instructions between scans, untimed
+#define LSLA_RATE   8       // characters a line sends in a scan
+#define LSLA_RXMAX  256     // characters a line takes in a scan
+#define LSLA_FLUSH  4       // scans between sends to the network
+#define LSLA_TXBUF  4096    // per line; TMXR drops the oldest past this
+#define LSLA_BASE   072000  // communications regions, to the top of memory
+
+// Line communications region, words from BASE + 01000 * a + 040 * s
+enum
+  {
+    lsRxICW = 0,
+    lsRxNext = 2,
+    lsTxICW = 4,
+    lsTxNext = 6,
+    lsStatus = 010
+  };
+
+enum
+  {
+    lsRxFull  = 0400000,
+    lsRxEnd   = 0200000,
+    lsTxDone  = 0100000,
+    lsConn    = 0040000,
+    lsConnChg = 0020000,
+    lsBadICW  = 0004000
+  };
+
+enum
+  {
+    pcwReceive = 01,
+    pcwSend = 02,
+    pcwStop = 03,
+    pcwHangup = 06,
+    pcwASCII = 012,
+    pcwEBCDIC = 013,
+    pcwBCD = 014,
+    pcwUpper = 015
+  };
+
+// A scan's input is logged for replay as one record on RR_LSLA: for each
+// line in turn, its number, what happened, and for input a count and the
+// characters.
+#define RR_LSLA  01000
+enum { evInput, evConnect, evDisconnect };
+
+// Lines by adapter, a bit a line
+typedef uint32_t lineMap [LSLA_ADAPTERS];
+
+static struct
+  {
+    TMXR mux;
+    TMLN ldsc [LSLA_ALL];
+    lineMap connected, receiving, sending;
+    lineMap active;    // sent a PCW since reset; only these are written
+    lineMap ready;     // input to take
+    lineMap unsent;    // output queued for the network
+    lineMap posted;    // status to write this scan
+    word18 status [LSLA_ALL];
+    uint8_t charSet [LSLA_ALL];  // xlate.h
+    int32 adapters;
+    int32 chan;        // of adapter 0
+    int32 base;        // of adapter 0's communications region
+    int32 level;
+    int32 tick;
+    int32 rate;
+    int32 flush;
+    int32 registered;  // channels claimed with the IOM, from here; or -1
+    int32 nRegistered; // and how many
+    uint64_t scans, busyScans, rxLines, rxChars, txLines, txChars;
+    uint64_t interrupts, flushes;
+  } ls =
+  {
+    .adapters = LSLA_ADAPTERS,
+    .chan = 011,
+    .base = LSLA_BASE,
+    .level = 5,
+    .tick = LSLA_TICK,
+    .rate = LSLA_RATE,
+    .flush = LSLA_FLUSH,
+    .registered = -1
+  };
+
+static UNIT lslaUnit = { UDATA (NULL, UNIT_ATTABLE | UNIT_IDLE, 0) };
+
+static word15 region (int ln)
+  {
+    return (word15) (ls . base + 01000 * (ln / LSLA_LINES) + 040 * (ln % LSLA_LINES));
+  }
+
+static bool isSet (const lineMap m, int ln)
+  {
+    return (m[ln / LSLA_LINES] >> (ln % LSLA_LINES)) & 1;
+  }
+
+static void set (lineMap m, int ln)
+  {
+    m[ln / LSLA_LINES] |= 1u << (ln % LSLA_LINES);
+  }
+
+static void clear (lineMap m, int ln)
+  {
+    m[ln / LSLA_LINES] &= ~ (1u << (ln % LSLA_LINES));
+  }
+
+// For each line in m, lowest first; m may change under it
+#define FOR_LINES(m, ln)                                                \
+  for (int a_ = 0; a_ < LSLA_ADAPTERS; a_ ++)                           \
+    for (uint32_t w_ = (m)[a_]; w_; w_ &= w_ - 1)                       \
+      for (int ln = a_ * LSLA_LINES + __builtin_ctz (w_), once_ = 1;   \
+           once_; once_ = 0)
+
+// Held until the FNP has sent the line a PCW, so that memory it has not
+// set aside for the line is left alone
+static void post (int ln, word18 bits)
+  {
+    ls . status[ln] |= bits;
+    if (isSet (ls . active, ln))
+      set (ls . posted, ln);
+  }
+
+// The ICW at 'at' has run out: move up the next one, if the FNP has set it
+static void moveUp (word15 at)
+  {
+    word18 next[2] = { cpu . M[at + 2], cpu . M[at + 3] };
+    if (! (next[1] & BITS12))
+      return;
+    dmaToMemory (at, next, 2);
+    next[1] &= ~ (word18) BITS12;
+    dmaToMemory (at + 3, & next[1], 1);
+  }
+
+// Write the scan's status words, and interrupt once for each adapter
+static void flushStatus (void)
+  {
+    for (int a = 0; a < LSLA_ADAPTERS; a ++)
+      {
+        if (! ls . posted[a])
+          continue;
+        for (uint32_t w = ls . posted[a]; w; w &= w - 1)
+          {
+            int ln = a * LSLA_LINES + __builtin_ctz (w);
+            word15 at = region (ln) + lsStatus;
+            word18 st = (cpu . M[at] & ~ (word18) lsConn) | ls . status[ln];
+            if (isSet (ls . connected, ln))
+              st |= lsConn;
+            dmaToMemory (at, & st, 1);
+            ls . status[ln] = 0;
+          }
+        ls . posted[a] = 0;
+        iom_interrupt (ls . level, a);
+        ls . interrupts ++;
+      }
+  }
+
+//
+// Input
+//
+
+// Room in the receive ICW and the next
+static unsigned room (int ln)
+  {
+    word15 rx = region (ln) + lsRxICW;
+    if (! isSet (ls . receiving, ln) || ! (cpu . M[rx + 1] & BITS12))
+      return 0;
+    return (cpu . M[rx + 1] & BITS12) + (cpu . M[rx + 3] & BITS12);
+  }
+
+static void deliver (int ln, const uint8_t * data, unsigned n, bool more)
+  {
+    word15 rx = region (ln) + lsRxICW;
+    unsigned done = 0;
+    while (done < n)
+      {
+        iomICW icw;
+        iom_get_icw (rx, & icw);
+        if (! icw . tally)
+          break;
+        unsigned k = iom_store_chars (& icw, data + done, n - done);
+        iom_put_icw (rx, & icw);
+        if (! k)
+          {
+            clear (ls . receiving, ln);
+            post (ln, lsBadICW);
+            return;
+          }
+        done += k;
+        if (icw . tally)
+          break;
+        post (ln, lsRxFull);
+        moveUp (rx);
+      }
+    ls . rxLines ++;
+    ls . rxChars += n;
+    if (! more)
+      post (ln, lsRxEnd);
+  }
+
+static void setConnected (int ln, bool on)
+  {
+    if (isSet (ls . connected, ln) == on)
+      return;
+    if (on)
+      set (ls . connected, ln);
+    else
+      {
+        clear (ls . connected, ln);
+        clear (ls . ready, ln);
+      }
+    post (ln, lsConnChg);
+  }
+
+static void replayInput (void)
+  {
+    uint8_t * p;
+    int n = rr_take (rrLine, RR_LSLA, & p, false);
+    for (int i = 0; i + 2 <= n; )
+      {
+        int ln = p[i], ev = p[i + 1];
+        i += 2;
+        if (ev == evConnect || ev == evDisconnect)
+          setConnected (ln, ev == evConnect);
+        else if (i + 3 <= n)
+          {
+            unsigned k = ((unsigned) p[i] << 8) | p[i + 1];
+            bool more = p[i + 2];
+            i += 3;
+            deliver (ln, p + i, k, more);
+            i += (int) k;
+          }
+      }
+  }
+
+// The scan's input, as logged
+static uint8_t rrBuf [LSLA_ALL * (5 + LSLA_RXMAX) + 2 * LSLA_ALL];
+static int rrLen;
+
+static void logEvent (int ln, int ev)
+  {
+    rrBuf[rrLen ++] = (uint8_t) ln;
+    rrBuf[rrLen ++] = (uint8_t) ev;
+  }
+
+static void connChange (int ln, bool on)
+  {
+    logEvent (ln, on ? evConnect : evDisconnect);
+    setConnected (ln, on);
+  }
+
+static void receive (int ln)
+  {
+    TMLN * lp = & ls . ldsc[ln];
+    unsigned max = room (ln);
+    if (max > LSLA_RXMAX)
+      max = LSLA_RXMAX;
+    if (! max || ! lp -> conn)
+      {
+        // Wait for the FNP; keep the line marked while it has input
+        if (! lp -> conn || ! tmxr_rqln (lp))
+          clear (ls . ready, ln);
+        return;
+      }
+    uint8_t * rec = rrBuf + rrLen;
+    unsigned n = 0;
+    int32 c;
+    while (n < max && (c = tmxr_getc_ln (lp)) & TMXR_VALID)
+      rec[5 + n ++] = (uint8_t) c;
+    bool more = tmxr_rqln (lp) != 0;
+    if (! more)
+      clear (ls . ready, ln);
+    if (! n)
+      return;
+    xlate (xlate_in (ls . charSet[ln]), rec + 5, n);
+    rec[0] = (uint8_t) ln;
+    rec[1] = evInput;
+    rec[2] = (uint8_t) (n >> 8);
+    rec[3] = (uint8_t) n;
+    rec[4] = more;
+    rrLen += 5 + (int) n;
+    deliver (ln, rec + 5, n, more);
+  }
+
+static void lineReady (UNUSED TMXR * mp, int32 ln)
+  {
+    set (ls . ready, ln);
+  }
+
+//
+// Output
+//
+
+// Output waits while its line is not connected or its socket is full
+static void flushLine (int ln)
+  {
+    TMLN * lp = & ls . ldsc[ln];
+    if (! lp -> conn)
+      return;
+    ls . flushes ++;
+    if (! lineout_flush (lp))
+      clear (ls . unsent, ln);
+  }
+
+static void transmit (int ln)
+  {
+    word15 tx = region (ln) + lsTxICW;
+    iomICW icw;
+    iom_get_icw (tx, & icw);
+    TMLN * lp = & ls . ldsc[ln];
+    unsigned n;
+    if (rr_replaying ())
+      {
+        uint8_t buf [LSLA_RATE * 16];
+        n = iom_load_chars (& icw, buf, (unsigned) ls . rate);
+      }
+    else
+      n = lineout_put_chars (lp, & icw, (unsigned) ls . rate,
+                             xlate_out (ls . charSet[ln]));
+    if (! n && icw . tally)
+      {
+        clear (ls . sending, ln);
+        post (ln, lsBadICW);
+        return;
+      }
+    iom_put_icw (tx, & icw);
+    if (n && ! rr_replaying ())
+      {
+        set (ls . unsent, ln);
+        if (lineout_due (lp))
+          flushLine (ln);
+      }
+    ls . txLines ++;
+    ls . txChars += n;
+    if (icw . tally)
+      return;
+    moveUp (tx);
+    if (! (cpu . M[tx + 1] & BITS12))
+      clear (ls . sending, ln);
+    post (ln, lsTxDone);
+  }
+
+//
+// Scan
+//
+
+static t_stat lslaSvc (UNIT * uptr)
+  {
+    ls . scans ++;
+    if (rr_replaying ())
+      replayInput ();
+    else if (uptr -> flags & UNIT_ATT)
+      {
+        rrLen = 0;
+        int32 ln;
+        while ((ln = muxpoll_conn (& ls . mux)) >= 0)
+          {
+            ls . ldsc[ln] . rcve = 1;
+            connChange (ln, true);
+          }
+        muxpoll_rx (& ls . mux);
+        FOR_LINES (ls . connected, c)
+          if (! ls . ldsc[c] . conn)
+            connChange (c, false);
+        FOR_LINES (ls . ready, r)
+          receive (r);
+        if (rrLen)
+          rr_record (rrLine, RR_LSLA, rrBuf, rrLen);
+      }
+    bool busy = false;
+    FOR_LINES (ls . sending, s)
+      {
+        transmit (s);
+        busy = true;
+      }
+    if (ls . scans % (uint64_t) ls . flush == 0)
+      FOR_LINES (ls . unsent, u)
+        flushLine (u);
+    for (int a = 0; a < LSLA_ADAPTERS; a ++)
+      busy |= ls . posted[a] != 0;
+    if (busy)
+      ls . busyScans ++;
+    flushStatus ();
+    return sim_clock_coschedule (uptr, ls . tick);
+  }
+
+//
+// PCWs
+//
+
+static void lslaConnect (word6 chan, word36 pcw)
+  {
+    int a = (int) chan - ls . registered;
+    int s = (int) ((pcw >> 6) & 037);
+    if (a < 0 || a >= ls . adapters || s >= LSLA_LINES)
+      return;
+    int ln = a * LSLA_LINES + s;
+    if (! isSet (ls . active, ln))
+      {
+        set (ls . active, ln);
+        if (ls . status[ln])
+          set (ls . posted, ln);
+      }
+    switch (pcw & 077)
+      {
+        case pcwReceive:
+          set (ls . receiving, ln);
+          if (isSet (ls . connected, ln) && ! rr_replaying ())
+            set (ls . ready, ln);
+          break;
+        case pcwSend:
+          set (ls . sending, ln);
+          break;
+        case pcwStop:
+          clear (ls . receiving, ln);
+          clear (ls . sending, ln);
+          break;
+        case pcwHangup:
+          if (ls . ldsc[ln] . conn && ! rr_replaying ())
+            tmxr_reset_ln (& ls . ldsc[ln]);
+          setConnected (ln, false);
+          break;
+        case pcwASCII:
+        case pcwEBCDIC:
+        case pcwBCD:
+        case pcwUpper:
+          ls . charSet[ln] = (uint8_t) (xlateASCII + (pcw & 077) - pcwASCII);
+          break;
+        default:
+          sim_debug (DBG_DEBUG, & lslaDev, "PCW %012llo?\n",
+                     (unsigned long long) pcw);
+          break;
+      }
+  }
+
+//
+// Device
+//
+
+static void unregister (void)
+  {
+    for (int a = 0; a < ls . nRegistered; a ++)
+      iom_unregister ((word6) (ls . registered + a));
+    ls . registered = -1;
+    ls . nRegistered = 0;
+  }
+
+// Snapshot state: what the FNP has asked of the lines, and the status not
+// yet written
+typedef struct
+  {
+    lineMap receiving, sending, active, posted;
+    word18 status [LSLA_ALL];
+    uint8_t charSet [LSLA_ALL];
+  } lslaState;
+
+static void lslaGet (UNUSED DEVICE * dptr, void * buf)
+  {
+    lslaState * st = buf;
+    memcpy (st -> receiving, ls . receiving, sizeof (lineMap));
+    memcpy (st -> sending, ls . sending, sizeof (lineMap));
+    memcpy (st -> active, ls . active, sizeof (lineMap));
+    memcpy (st -> posted, ls . posted, sizeof (lineMap));
+    memcpy (st -> status, ls . status, sizeof (ls . status));
+    memcpy (st -> charSet, ls . charSet, sizeof (ls . charSet));
+  }
+
+static void lslaPut (UNUSED DEVICE * dptr, const void * buf)
+  {
+    const lslaState * st = buf;
+    memcpy (ls . receiving, st -> receiving, sizeof (lineMap));
+    memcpy (ls . sending, st -> sending, sizeof (lineMap));
+    memcpy (ls . active, st -> active, sizeof (lineMap));
+    memcpy (ls . posted, st -> posted, sizeof (lineMap));
+    memcpy (ls . status, st -> status, sizeof (ls . status));
+    memcpy (ls . charSet, st -> charSet, sizeof (ls . charSet));
+  }
+
+static t_stat lslaReset (DEVICE * dptr)
+  {
+    ls . mux . ldsc = ls . ldsc;
+    ls . mux . dptr = dptr;
+    if (! (lslaUnit . flags & UNIT_ATT))
+      ls . mux . lines = ls . adapters * LSLA_LINES;
+    lslaUnit . action = lslaSvc;
+    memset (ls . receiving, 0, sizeof (lineMap));
+    memset (ls . sending, 0, sizeof (lineMap));
+    memset (ls . active, 0, sizeof (lineMap));
+    memset (ls . posted, 0, sizeof (lineMap));
+    memset (ls . status, 0, sizeof (ls . status));
+    unregister ();
+    sim_cancel (& lslaUnit);
+    t_stat r = snapshot_register (dptr, sizeof (lslaState), lslaGet, lslaPut);
+    if (r != SCPE_OK || (dptr -> flags & DEV_DIS))
+      return r;
+    ls . registered = ls . chan;
+    for (int a = 0; a < ls . adapters; a ++)
+      {
+        if (! iom_register ((word6) (ls . chan + a), lslaConnect))
+          {
+            sim_printf ("LSLA: channel %o is in use\n", ls . chan + a);
+            unregister ();
+            return SCPE_ARG;
+          }
+        ls . nRegistered ++;
+      }
+    return sim_clock_coschedule (& lslaUnit, ls . tick);
+  }
+
+static t_stat lslaAttach (UNIT * uptr, char * cptr)
+  {
+    if (! ls . mux . buffered)
+      ls . mux . buffered = LSLA_TXBUF;
+    t_stat r = tmxr_attach (& ls . mux, uptr, cptr);
+    if (r != SCPE_OK)
+      return r;
+    muxpoll_notify (& ls . mux, lineReady);
+    return muxpoll_attach (& ls . mux);
+  }
+
+static t_stat lslaDetach (UNIT * uptr)
+  {
+    if (! (uptr -> flags & UNIT_ATT))
+      return SCPE_OK;
+    muxpoll_detach (& ls . mux);
+    t_stat r = tmxr_detach (& ls . mux, uptr);
+    rrLen = 0;
+    FOR_LINES (ls . connected, ln)
+      connChange (ln, false);
+    if (rrLen)
+      rr_record (rrLine, RR_LSLA, rrBuf, rrLen);
+    flushStatus ();
+    return r;
+  }
+
+//
+// SET and SHOW
+//
+
+static t_stat lslaSetAdapters (UNUSED UNIT * uptr, UNUSED int32 value,
+                               char * cptr, UNUSED void * desc)
+  {
+    if (lslaUnit . flags & UNIT_ATT)
+      return SCPE_ALATT;
+    return setChannels (& lslaDev, & ls . adapters, 1, LSLA_ADAPTERS, 10, cptr);
+  }
+
+static t_stat lslaSetChannel (UNUSED UNIT * uptr, UNUSED int32 value,
+                              char * cptr, UNUSED void * desc)
+  {
+    return setChannels (& lslaDev, & ls . chan, 0, 077 - LSLA_ADAPTERS + 1, 8, cptr);
+  }
+
+static t_stat lslaSetBase (UNUSED UNIT * uptr, UNUSED int32 value,
+                           char * cptr, UNUSED void * desc)
+  {
+    int32 old = ls . base;
+    t_stat r = setNumber (& ls . base, 04000,
+                          MEM_SIZE - 01000 * LSLA_ADAPTERS, 8, cptr);
+    if (r == SCPE_OK && ls . base % 01000)
+      {
+        ls . base = old;
+        r = SCPE_ARG;
+      }
+    return r;
+  }
+
+static t_stat lslaSetLevel (UNUSED UNIT * uptr, UNUSED int32 value,
+                            char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& ls . level, 0, 15, 10, cptr);
+  }
+
+static t_stat lslaSetTick (UNUSED UNIT * uptr, UNUSED int32 value,
+                           char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& ls . tick, 1, 1000000, 10, cptr);
+  }
+
+static t_stat lslaSetRate (UNUSED UNIT * uptr, UNUSED int32 value,
+                           char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& ls . rate, 1, LSLA_RATE * 16, 10, cptr);
+  }
+
+static t_stat lslaSetFlush (UNUSED UNIT * uptr, UNUSED int32 value,
+                            char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& ls . flush, 1, 1000, 10, cptr);
+  }
+
+// XLATE=name for every line, or XLATE=n:name for line n
+static t_stat lslaSetXlate (UNUSED UNIT * uptr, UNUSED int32 value,
+                            char * cptr, UNUSED void * desc)
+  {
+    if (! cptr)
+      return SCPE_ARG;
+    int lo = 0, hi = LSLA_ALL - 1;
+    char * colon = strchr (cptr, ':');
+    if (colon)
+      {
+        t_stat r;
+        * colon = 0;
+        lo = hi = (int) get_uint (cptr, 10, LSLA_ALL - 1, & r);
+        if (r != SCPE_OK)
+          return r;
+        cptr = colon + 1;
+      }
+    int kind = xlate_find (cptr);
+    if (kind < 0)
+      return SCPE_ARG;
+    for (int ln = lo; ln <= hi; ln ++)
+      ls . charSet[ln] = (uint8_t) kind;
+    return SCPE_OK;
+  }
+
+static t_stat lslaShowXlate (FILE * st, UNUSED UNIT * uptr, UNUSED int32 val,
+                             UNUSED void * desc)
+  {
+    bool any = false;
+    for (int ln = 0; ln < ls . adapters * LSLA_LINES; ln ++)
+      if (ls . charSet[ln] != xlateASCII)
+        {
+          fprintf (st, "%sline %d %s", any ? ", " : "", ln,
+                   xlate_name (ls . charSet[ln]));
+          any = true;
+        }
+    if (! any)
+      fprintf (st, "all lines ASCII");
+    return SCPE_OK;
+  }
+
+static t_stat lslaShowConfig (FILE * st, UNUSED UNIT * uptr, UNUSED int32 val,
+                              UNUSED void * desc)
+  {
+    fprintf (st, "adapters=%d, channel=%o, base=%o, level=%d, tick=%d, "
+             "rate=%d, flush=%d", ls . adapters, ls . chan, ls . base,
+             ls . level, ls . tick, ls . rate, ls . flush);
+    return SCPE_OK;
+  }
+
+static t_stat lslaShowConn (FILE * st, UNIT * uptr, int32 val,
+                            UNUSED void * desc)
+  {
+    return tmxr_show_cstat (st, uptr, val, & ls . mux);
+  }
+
+static t_stat lslaDisconnect (UNIT * uptr, int32 val, char * cptr,
+                              UNUSED void * desc)
+  {
+    return tmxr_dscln (uptr, val, cptr, & ls . mux);
+  }
+
+static t_stat lslaShowCounters (FILE * st, UNUSED UNIT * uptr,
+                                UNUSED int32 val, UNUSED void * desc)
+  {
+    unsigned conn = 0;
+    for (int a = 0; a < LSLA_ADAPTERS; a ++)
+      conn += (unsigned) __builtin_popcount (ls . connected[a]);
+    fprintf (st, "%u lines connected; %llu scans, %llu with work\n", conn,
+             (unsigned long long) ls . scans,
+             (unsigned long long) ls . busyScans);
+    fprintf (st, "in  %llu characters in %llu line services\n",
+             (unsigned long long) ls . rxChars, (unsigned long long) ls . rxLines);
+    fprintf (st, "out %llu characters in %llu line services, %llu sends\n",
+             (unsigned long long) ls . txChars, (unsigned long long) ls . txLines,
+             (unsigned long long) ls . flushes);
+    fprintf (st, "%llu interrupts; ", (unsigned long long) ls . interrupts);
+    muxpoll_show (st, & ls . mux);
+    fprintf (st, "\n");
+    return SCPE_OK;
+  }
+
+static MTAB lslaMod [] =
+  {
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "ADAPTERS", lslaSetAdapters, NULL, NULL, "Adapters fitted, 1-6" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "CHANNEL", lslaSetChannel, NULL, NULL, "IOM channel of the first adapter, octal" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "BASE", lslaSetBase, NULL, NULL, "Address of the communications regions, octal, a multiple of 01000" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "LEVEL", lslaSetLevel, NULL, NULL, "Interrupt level" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "TICK", lslaSetTick, NULL, NULL, "Instructions between scans with the timer disabled" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "RATE", lslaSetRate, NULL, NULL, "Characters a line sends in a scan" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "FLUSH", lslaSetFlush, NULL, NULL, "Scans between sends to the network" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, "XLATE", "XLATE", lslaSetXlate, lslaShowXlate, NULL, "Character set, for all lines or n:name for line n" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "CONFIG", NULL, NULL, lslaShowConfig, NULL, "Adapters, channel, base, level, tick, rate and flush" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 1, "CONNECTIONS", NULL, NULL, lslaShowConn, NULL, "Line connections" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "STATISTICS", NULL, NULL, lslaShowConn, NULL, "Line statistics" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "COUNTERS", NULL, NULL, lslaShowCounters, NULL, "Scans, characters and interrupts" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "DISCONNECT", lslaDisconnect, NULL, NULL, "Disconnect a line" },
+    { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+  };
+
+static DEBTAB lslaDebug [] =
+  {
+    { "DEBUG", DBG_DEBUG },
+    { "XMT", TMXR_DBG_XMT },
+    { "RCV", TMXR_DBG_RCV },
+    { "CONNECT", TMXR_DBG_CON },
+    { NULL, 0 }
+  };
+
+DEVICE lslaDev =
+  {
+    "LSLA",           /* name */
+    & lslaUnit,       /* units */
+    NULL,             /* registers */
+    lslaMod,          /* modifiers */
+    1,                /* #units */
+    10,               /* address radix */
+    1,                /* address width */
+    1,                /* address increment */
+    10,               /* data radix */
+    1,                /* data width */
+    NULL,             /* examine routine */
+    NULL,             /* deposit routine */
+    lslaReset,        /* reset routine */
+    NULL,             /* boot routine */
+    lslaAttach,       /* attach routine */
+    lslaDetach,       /* detach routine */
+    NULL,             /* context */
+    DEV_DISABLE | DEV_DEBUG | DEV_MUX, /* flags */
+    0,                /* debug control flags */
+    lslaDebug,        /* debug flag names */
+    NULL,             /* memory size change */
+    NULL,             /* logical name */
+    NULL,             /* attach help */
+    NULL,             /* help */
+    NULL,             /* help context */
+    NULL,             /* device description */
+  };
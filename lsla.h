@@ -0,0 +1,60 @@
+// Low-speed line adapters
+//
+// Up to six LSLAs of 24 asynchronous lines each, the 144 lines of device
+// LSLA on telnet (TMXR): ATTACH LSLA <port>. SET LSLA ADAPTERS=n (1-6,
+// while detached) says how many are fitted; lines 24 * a to 24 * a + 23 are
+// adapter a's.
+//
+// Slow lines are not worth an event each. The device has a single unit,
+// which scans on each TIMER tick (see timer.h), or every TICK instructions
+// with the timer disabled (SET LSLA TICK=n): it takes the input of the
+// lines muxpoll has marked, sends up to RATE characters on each line that
+// is sending (SET LSLA RATE=n), and then writes the status words and raises
+// one interrupt for each adapter that has something to say. Between scans
+// it costs nothing, and a scan costs only the lines with work.
+//
+// Each line has a communications region like an HSLA subchannel's, 040
+// words from BASE + 01000 * a + 040 * s. BASE is 072000 by default, so the
+// six adapters' regions end at the top of memory; SET LSLA BASE=n moves
+// them (octal, a multiple of 01000).
+//
+//   +000  receive ICW          +004  send ICW
+//   +002  next receive ICW     +006  next send ICW
+//   +010  status
+//
+// with the HSLA's ICW chaining and status bits, but for frames and overrun:
+//
+//   400000  receive ICW ran out
+//   200000  end of input: the line has nothing more for now
+//   100000  send ICW ran out
+//   040000  connected
+//   020000  connected or disconnected
+//   004000  the ICW's character address is not a character
+//
+// Nothing is written to a line's region until the FNP has sent the line a
+// PCW; a connection before that is posted with the first one.
+//
+// Input that does not fit the receive ICWs waits for the FNP to set more.
+// Status changes in a scan set sublevel a of the LSLAs' interrupt level
+// (SET LSLA LEVEL=n, default 5), once.
+//
+// A line that does not carry ASCII has its characters translated (see
+// xlate.h): SET LSLA XLATE=EBCDIC for every line, XLATE=n:EBCDIC for line
+// n, or the character set PCWs.
+//
+// Adapter a takes PCWs on IOM channel CHANNEL + a (SET LSLA CHANNEL=n, 011
+// by default). Bits 30-35 are the command, bits 25-29 the line:
+//
+//   01  start receiving into the receive ICW
+//   02  start sending from the send ICW
+//   03  stop receiving and sending
+//   06  disconnect the line
+//   12  ASCII
+//   13  EBCDIC
+//   14  BCD
+//   15  upper case ASCII
+
+#define LSLA_ADAPTERS 6
+#define LSLA_LINES    24
+
+extern DEVICE lslaDev;
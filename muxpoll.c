@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "dn6600.h"
+#include "sim_tmxr.h"
+#include "evq.h"
+#include "muxpoll.h"
+
+#define MUXPOLL_MAX 16
+
+static struct
+  {
+    TMXR * mp;
+    muxReadyFn fn;
+  } notifiers [MUXPOLL_MAX];
+
+void muxpoll_notify (TMXR * mp, muxReadyFn fn)
+  {
+    int i, slot = -1;
+    for (i = 0; i < MUXPOLL_MAX; i ++)
+      {
+        if (notifiers[i].mp == mp)
+          break;
+        if (! notifiers[i].mp && slot < 0)
+          slot = i;
+      }
+    if (i == MUXPOLL_MAX)
+      i = slot;
+    if (i < 0)
+      return;
+    notifiers[i].mp = fn ? mp : NULL;
+    notifiers[i].fn = fn;
+  }
+
+// Tell the device a line has taken input: through its callback, or by
+// setting the line's input unit going, unless it or the multiplexer's own
+// poll unit is already scheduled
+static void wake (TMXR * mp, TMLN * lp)
+  {
+    for (int i = 0; i < MUXPOLL_MAX; i ++)
+      if (notifiers[i].mp == mp)
+        {
+          notifiers[i].fn (mp, (int32) (lp - mp -> ldsc));
+          return;
+        }
+    UNIT * u = lp -> uptr;
+    if (! u || u == mp -> uptr || sim_is_active (u))
+      return;
+    evq_activate (u, 0);
+  }
+
+static void pollAll (TMXR * mp)
+  {
+    tmxr_poll_rx (mp);
+    for (int32 i = 0; i < mp -> lines; i ++)
+      if (tmxr_rqln (mp -> ldsc + i))
+        wake (mp, mp -> ldsc + i);
+  }
+
+#ifdef __linux__
+
+typedef struct
+  {
+    TMXR * mp;
+    int epfd;
+    bool accept;      // the listener has been readable since it last drained
+    int32 * pending;  // lines that may have input, in the order they woke
+    uint8_t * onList;
+    int32 nPending;
+    uint64_t polls, wakeups, reads;
+  } muxState;
+
+static muxState muxes [MUXPOLL_MAX];
+
+static muxState * find (TMXR * mp)
+  {
+    for (int i = 0; i < MUXPOLL_MAX; i ++)
+      if (muxes[i].mp == mp)
+        return muxes + i;
+    return NULL;
+  }
+
+// Line n's epoll tag is n + 1; the listener's is 0.
+static void watch (muxState * m, SOCKET sock, uint32_t tag)
+  {
+    struct epoll_event ev =
+      {
+        .events = EPOLLIN | EPOLLRDHUP | EPOLLET,
+        .data.u32 = tag
+      };
+    if (epoll_ctl (m -> epfd, EPOLL_CTL_ADD, sock, & ev) < 0)
+      epoll_ctl (m -> epfd, EPOLL_CTL_MOD, sock, & ev);
+  }
+
+static void markPending (muxState * m, int32 ln)
+  {
+    if (m -> onList[ln])
+      return;
+    m -> onList[ln] = 1;
+    m -> pending[m -> nPending ++] = ln;
+  }
+
+// Edge-triggered, so each event is seen once; remember it until the
+// listener or line has been drained.
+static void gather (muxState * m)
+  {
+    struct epoll_event ev [64];
+    int n;
+    do
+      {
+        n = epoll_wait (m -> epfd, ev, 64, 0);
+        for (int i = 0; i < n; i ++)
+          {
+            m -> wakeups ++;
+            if (ev[i].data.u32 == 0)
+              m -> accept = true;
+            else
+              markPending (m, (int32) ev[i].data.u32 - 1);
+          }
+      }
+    while (n == 64);
+  }
+
+static bool readable (SOCKET sock)
+  {
+    struct pollfd pfd = { .fd = sock, .events = POLLIN };
+    return poll (& pfd, 1, 0) > 0;
+  }
+
+static bool coverable (TMXR * mp)
+  {
+    if (mp -> master == 0)
+      return false;
+    for (int32 i = 0; i < mp -> lines; i ++)
+      {
+        TMLN * lp = mp -> ldsc + i;
+        if (lp -> serport || lp -> loopback || lp -> master || lp -> destination)
+          return false;
+      }
+    return true;
+  }
+
+t_stat muxpoll_attach (TMXR * mp)
+  {
+    muxpoll_detach (mp);
+    if (! coverable (mp))
+      return SCPE_OK;
+    muxState * m = find (NULL);
+    if (! m)
+      return SCPE_OK;
+    memset (m, 0, sizeof (* m));
+    m -> pending = calloc ((size_t) mp -> lines, sizeof (int32));
+    m -> onList = calloc ((size_t) mp -> lines, sizeof (uint8_t));
+    m -> epfd = epoll_create1 (EPOLL_CLOEXEC);
+    if (! m -> pending || ! m -> onList || m -> epfd < 0)
+      {
+        free (m -> pending);
+        free (m -> onList);
+        if (m -> epfd >= 0)
+          close (m -> epfd);
+        memset (m, 0, sizeof (* m));
+        return SCPE_MEM;
+      }
+    m -> mp = mp;
+    watch (m, mp -> master, 0);
+    m -> accept = true;
+    // Lines connected before we were attached, as after a restore
+    for (int32 i = 0; i < mp -> lines; i ++)
+      if (mp -> ldsc[i].sock)
+        {
+          watch (m, mp -> ldsc[i].sock, (uint32_t) i + 1);
+          markPending (m, i);
+        }
+    return SCPE_OK;
+  }
+
+void muxpoll_detach (TMXR * mp)
+  {
+    muxState * m = find (mp);
+    if (! m)
+      return;
+    close (m -> epfd);
+    free (m -> pending);
+    free (m -> onList);
+    memset (m, 0, sizeof (* m));
+  }
+
+// tmxr_poll_conn accepts one connection a call, and no more than one a
+// connection poll interval, so the listener stays marked until it is found
+// empty.
+int32 muxpoll_conn (TMXR * mp)
+  {
+    muxState * m = find (mp);
+    if (! m)
+      return tmxr_poll_conn (mp);
+    gather (m);
+    if (! m -> accept)
+      return -1;
+    int32 ln = tmxr_poll_conn (mp);
+    if (ln >= 0)
+      {
+        watch (m, mp -> ldsc[ln].sock, (uint32_t) ln + 1);
+        markPending (m, ln);
+      }
+    else
+      m -> accept = readable (mp -> master);
+    return ln;
+  }
+
+// Read the lines that have woken, each through tmxr_poll_rx on a one-line
+// view of the multiplexer. A line stays pending while its buffer holds
+// input the device has yet to take, as tmxr_poll_rx will not read into it,
+// or while receive is disabled, and leaves once a read finds the socket
+// empty or the line gone.
+void muxpoll_rx (TMXR * mp)
+  {
+    muxState * m = find (mp);
+    if (! m)
+      {
+        pollAll (mp);
+        return;
+      }
+    m -> polls ++;
+    gather (m);
+    TMXR view = * mp;
+    view.lines = 1;
+    int32 kept = 0;
+    for (int32 i = 0; i < m -> nPending; i ++)
+      {
+        int32 ln = m -> pending[i];
+        TMLN * lp = mp -> ldsc + ln;
+        bool keep = false;
+        if (lp -> sock && (! lp -> rcve || (lp -> rxbpi && ! lp -> tsta)))
+          keep = true;  // not reading yet; the input will keep
+        else if (lp -> sock)
+          {
+            int32 before = lp -> rxcnt;
+            view.ldsc = lp;
+            tmxr_poll_rx (& view);
+            m -> reads ++;
+            if (lp -> rxcnt != before)
+              wake (mp, lp);
+            keep = lp -> sock && lp -> rxcnt != before;
+          }
+        if (keep)
+          m -> pending[kept ++] = ln;
+        else
+          m -> onList[ln] = 0;
+      }
+    m -> nPending = kept;
+  }
+
+void muxpoll_show (FILE * st, TMXR * mp)
+  {
+    muxState * m = find (mp);
+    if (! m)
+      {
+        fprintf (st, "polled by TMXR");
+        return;
+      }
+    fprintf (st, "epoll, %u pending, %llu polls, %llu wakeups, %llu line reads",
+             (unsigned) m -> nPending, (unsigned long long) m -> polls,
+             (unsigned long long) m -> wakeups, (unsigned long long) m -> reads);
+  }
+
+#else
+
+t_stat muxpoll_attach (UNUSED TMXR * mp)
+  {
+    return SCPE_OK;
+  }
+
+void muxpoll_detach (UNUSED TMXR * mp)
+  {
+  }
+
+int32 muxpoll_conn (TMXR * mp)
+  {
+    return tmxr_poll_conn (mp);
+  }
+
+void muxpoll_rx (TMXR * mp)
+  {
+    pollAll (mp);
+  }
+
+void muxpoll_show (FILE * st, UNUSED TMXR * mp)
+  {
+    fprintf (st, "polled by TMXR");
+  }
+
+#endif
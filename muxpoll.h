@@ -0,0 +1,30 @@
+// Readiness polling for multiplexers with many lines
+//
+// tmxr_poll_conn and tmxr_poll_rx look at every line of a multiplexer on
+// every poll, and read each connected one whether it has input or not; with
+// thousands of telnet lines mostly idle, the polls cost more than the
+// lines. A multiplexer registered here after tmxr_attach has its listening
+// socket and its line sockets in an edge-triggered epoll set, and the calls
+// below, which stand in for their TMXR namesakes, accept and read only when
+// the kernel has said there is something to accept or read; the cost of a
+// poll goes with the lines that are active, not with the lines attached.
+//
+// A line that takes input has its input unit (tmxr_set_line_unit) set on
+// evq to run at once, so a device need not poll its line units itself. A
+// device that services its lines in batches registers a callback instead,
+// called with each line that has taken input.
+//
+// Serial, loopback, outgoing and per-line listeners are not covered; a
+// multiplexer using any of them, or any multiplexer off Linux, is polled
+// by tmxr_poll_conn and tmxr_poll_rx as before.
+
+t_stat muxpoll_attach (TMXR * mp);
+void muxpoll_detach (TMXR * mp);
+
+int32 muxpoll_conn (TMXR * mp);
+void muxpoll_rx (TMXR * mp);
+
+typedef void (* muxReadyFn) (TMXR * mp, int32 line);
+void muxpoll_notify (TMXR * mp, muxReadyFn fn);  // NULL to go back to units
+
+void muxpoll_show (FILE * st, TMXR * mp);
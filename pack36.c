@@ -0,0 +1,99 @@
+#include <string.h>
+
+#include "pack36.h"
+
+// Each pair of words is handled with one 8-byte load or store plus one
+// byte, which keeps the loops free of per-byte shifting.
+
+#define BITS28  ((uint64_t) 01777777777)
+#define BITS36  ((uint64_t) 0777777777777)
+
+static inline uint64_t loadBE64 (const uint8_t * p)
+  {
+    uint64_t v;
+    memcpy (& v, p, sizeof (v));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64 (v);
+#endif
+    return v;
+  }
+
+static inline void storeBE64 (uint8_t * p, uint64_t v)
+  {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64 (v);
+#endif
+    memcpy (p, & v, sizeof (v));
+  }
+
+size_t pack36_size (size_t n)
+  {
+    return (n / 2) * 9 + (n & 1) * 5;
+  }
+
+size_t pack36 (uint8_t * dst, const uint64_t * src, size_t n)
+  {
+    uint8_t * p = dst;
+    size_t i;
+    for (i = 0; i + 2 <= n; i += 2, p += 9)
+      {
+        uint64_t w0 = src[i] & BITS36;
+        uint64_t w1 = src[i + 1] & BITS36;
+        storeBE64 (p, (w0 << 28) | (w1 >> 8));
+        p[8] = (uint8_t) w1;
+      }
+    if (i < n)
+      {
+        uint64_t w0 = src[i] & BITS36;
+        p[0] = (uint8_t) (w0 >> 28);
+        p[1] = (uint8_t) (w0 >> 20);
+        p[2] = (uint8_t) (w0 >> 12);
+        p[3] = (uint8_t) (w0 >> 4);
+        p[4] = (uint8_t) (w0 << 4);
+        p += 5;
+      }
+    return (size_t) (p - dst);
+  }
+
+size_t unpack36 (uint64_t * dst, const uint8_t * src, size_t n)
+  {
+    const uint8_t * p = src;
+    size_t i;
+    for (i = 0; i + 2 <= n; i += 2, p += 9)
+      {
+        uint64_t hi = loadBE64 (p);
+        dst[i] = hi >> 28;
+        dst[i + 1] = ((hi & BITS28) << 8) | p[8];
+      }
+    if (i < n)
+      {
+        dst[i] = ((uint64_t) p[0] << 28) | ((uint64_t) p[1] << 20) |
+                 ((uint64_t) p[2] << 12) | ((uint64_t) p[3] << 4) |
+                 ((uint64_t) p[4] >> 4);
+        p += 5;
+      }
+    return (size_t) (p - src);
+  }
+
+size_t unpack36_18 (uint32_t * dst, const uint8_t * src, size_t n)
+  {
+    const uint8_t * p = src;
+    size_t i;
+    for (i = 0; i + 2 <= n; i += 2, p += 9, dst += 4)
+      {
+        uint64_t hi = loadBE64 (p);
+        uint64_t w1 = ((hi & BITS28) << 8) | p[8];
+        dst[0] = (uint32_t) (hi >> 46);
+        dst[1] = (uint32_t) (hi >> 28) & 0777777;
+        dst[2] = (uint32_t) (w1 >> 18);
+        dst[3] = (uint32_t) w1 & 0777777;
+      }
+    if (i < n)
+      {
+        uint64_t w0;
+        p += unpack36 (& w0, p, 1);
+        dst[0] = (uint32_t) (w0 >> 18);
+        dst[1] = (uint32_t) w0 & 0777777;
+      }
+    return (size_t) (p - src);
+  }
@@ -0,0 +1,17 @@
+// Packed 36-bit word encoding for the coupler
+//
+// Two 36-bit words go in 9 bytes, big-endian, the first word in the high
+// 36 bits; a trailing odd word takes 5 bytes, left justified. That is 4.5
+// bytes a word rather than the 8 of a uint64_t.
+
+#include <stddef.h>
+#include <stdint.h>
+
+size_t pack36_size (size_t n);
+
+// Each returns the number of bytes produced or consumed
+size_t pack36 (uint8_t * dst, const uint64_t * src, size_t n);
+size_t unpack36 (uint64_t * dst, const uint8_t * src, size_t n);
+
+// Unpack into 18-bit halves, upper half first, as FNP memory holds them
+size_t unpack36_18 (uint32_t * dst, const uint8_t * src, size_t n);
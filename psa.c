@@ -0,0 +1,551 @@
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "dn6600.h"
+#include "dn6600_caf.h"
+#include "sim_disk.h"
+#include "iom.h"
+#include "pack36.h"
+#include "snapshot.h"
+#include "psa.h"
+#include "utils.h"
+
+#define PSA_SECTWORDS 128                  // FNP words a sector
+#define PSA_SECTBYTES 288                  // packed
+#define PSA_SECTORS   65536                // a new image's capacity
+#define PSA_MAXSECT   (MEM_SIZE / PSA_SECTWORDS)
+#define PSA_CYLINDER  64                   // sectors
+#define PSA_REGION    0500                 // in the I/O communications region
+
+#define PSA_DBG_DISK  (1U << 8)
+
+// Drive command region, words from PSA_REGION + 010 * d
+enum
+  {
+    psSector = 0,
+    psAddr = 2,
+    psCount = 3,
+    psStatus = 4
+  };
+
+enum
+  {
+    psDone     = 0400000,
+    psIOErr    = 0100000,
+    psNotReady = 0040000,
+    psRange    = 0020000,
+    psProtect  = 0010000
+  };
+
+enum
+  {
+    pcwRead = 01,
+    pcwWrite = 02,
+    pcwSeek = 03
+  };
+
+enum { opNone, opRead, opWrite, opSeek };
+
+typedef struct
+  {
+    int op;            // under way; opNone when idle
+    bool queued;       // for the worker
+    bool done;         // by the worker
+    t_stat result;
+    t_lba lba;
+    t_seccnt sects;
+    word15 addr;
+    unsigned count;
+    int32 cyl;         // where the heads are
+    uint8_t buf [PSA_MAXSECT * PSA_SECTBYTES];
+    uint64_t reads, writes, seeks, words, errors, stalls;
+  } psaDrive;
+
+static struct
+  {
+    psaDrive drive [PSA_DRIVES];
+    int32 chan;
+    int32 level;
+    int32 seek;        // instructions a cylinder
+    int32 rotate;
+    int32 xfer;        // instructions a word
+    int32 registered;  // channel claimed with the IOM, or -1
+    pthread_t worker;
+    bool started;
+    pthread_mutex_t lock;
+    pthread_cond_t work, finished;
+  } psa =
+  {
+    .chan = 017,
+    .level = 6,
+    .seek = 200,
+    .rotate = 2000,
+    .xfer = 2,
+    .registered = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .finished = PTHREAD_COND_INITIALIZER
+  };
+
+#define PSA_UNIT UDATA (NULL, UNIT_FIX | UNIT_ATTABLE | UNIT_ROABLE | UNIT_DISABLE, \
+                        (t_addr) PSA_SECTORS * PSA_SECTBYTES)
+
+static UNIT psaUnits [PSA_DRIVES] =
+  {
+    { PSA_UNIT }, { PSA_UNIT }, { PSA_UNIT }, { PSA_UNIT }
+  };
+
+static word15 region (int d)
+  {
+    return (word15) (PSA_REGION + 010 * d);
+  }
+
+static void post (int d, word18 bits)
+  {
+    word18 st = psDone | bits;
+    dmaToMemory (region (d) + psStatus, & st, 1);
+    iom_interrupt (psa . level, d);
+  }
+
+//
+// Host I/O, on the worker thread
+//
+
+static void * worker (UNUSED void * arg)
+  {
+    pthread_mutex_lock (& psa . lock);
+    for (;;)
+      {
+        int d;
+        for (d = 0; d < PSA_DRIVES; d ++)
+          if (psa . drive[d] . queued)
+            break;
+        if (d == PSA_DRIVES)
+          {
+            pthread_cond_wait (& psa . work, & psa . lock);
+            continue;
+          }
+        psaDrive * dr = & psa . drive[d];
+        dr -> queued = false;
+        pthread_mutex_unlock (& psa . lock);
+
+        t_seccnt n = 0;
+        t_stat r = dr -> op == opRead ?
+          sim_disk_rdsect (& psaUnits[d], dr -> lba, dr -> buf, & n, dr -> sects) :
+          sim_disk_wrsect (& psaUnits[d], dr -> lba, dr -> buf, & n, dr -> sects);
+        if (r == SCPE_OK && n < dr -> sects && dr -> op == opWrite)
+          r = SCPE_IOERR;
+
+        pthread_mutex_lock (& psa . lock);
+        dr -> result = r;
+        dr -> done = true;
+        pthread_cond_broadcast (& psa . finished);
+      }
+    return NULL;
+  }
+
+// Wait for the worker to finish with the drive; returns whether the CPU
+// had to
+static bool await (psaDrive * dr)
+  {
+    bool waited = false;
+    pthread_mutex_lock (& psa . lock);
+    while (dr -> queued || (dr -> op != opSeek && ! dr -> done))
+      {
+        waited = true;
+        pthread_cond_wait (& psa . finished, & psa . lock);
+      }
+    pthread_mutex_unlock (& psa . lock);
+    return waited;
+  }
+
+// A child forked by SET FNP START has no worker, only the flag saying
+// there is one; it starts its own when it is first needed. The lock and
+// conditions are made afresh, as the worker may have held them.
+static void psaForkChild (void)
+  {
+    psa . started = false;
+    pthread_mutex_init (& psa . lock, NULL);
+    pthread_cond_init (& psa . work, NULL);
+    pthread_cond_init (& psa . finished, NULL);
+  }
+
+static bool startWorker (void)
+  {
+    static bool forkHook;
+    if (! forkHook && pthread_atfork (NULL, NULL, psaForkChild) == 0)
+      forkHook = true;
+    if (psa . started)
+      return true;
+    if (pthread_create (& psa . worker, NULL, worker, NULL))
+      return false;
+    pthread_detach (psa . worker);
+    psa . started = true;
+    return true;
+  }
+
+// The drive's command ends, not having reached the worker, with r
+static void fail (psaDrive * dr, t_stat r)
+  {
+    dr -> result = r;
+    dr -> done = true;
+  }
+
+// Hand the drive's command to the worker
+static void queue (psaDrive * dr)
+  {
+    if (! startWorker ())
+      {
+        fail (dr, SCPE_IERR);
+        return;
+      }
+    pthread_mutex_lock (& psa . lock);
+    dr -> done = false;
+    dr -> queued = true;
+    pthread_cond_signal (& psa . work);
+    pthread_mutex_unlock (& psa . lock);
+  }
+
+//
+// Commands
+//
+
+// Take a write's words from memory; the worker sees only the buffer
+static void fill (psaDrive * dr)
+  {
+    uint64_t w [PSA_SECTWORDS / 2];
+    unsigned at = 0;
+    for (t_seccnt s = 0; s < dr -> sects; s ++)
+      {
+        for (int i = 0; i < PSA_SECTWORDS / 2; i ++, at += 2)
+          {
+            uint64_t hi = at < dr -> count ? cpu . M[dr -> addr + at] : 0;
+            uint64_t lo = at + 1 < dr -> count ? cpu . M[dr -> addr + at + 1] : 0;
+            w[i] = (hi << 18) | lo;
+          }
+        pack36 (dr -> buf + (size_t) s * PSA_SECTBYTES, w, PSA_SECTWORDS / 2);
+      }
+  }
+
+static t_stat psaSvc (UNIT * uptr)
+  {
+    int d = (int) (uptr - psaUnits);
+    psaDrive * dr = & psa . drive[d];
+    if (dr -> op == opNone)
+      {
+        // Nothing is known of the command any more
+        dr -> errors ++;
+        post (d, psIOErr);
+        return SCPE_OK;
+      }
+    if (await (dr))
+      dr -> stalls ++;
+    word18 st = 0;
+    if (dr -> op != opSeek && dr -> result != SCPE_OK)
+      {
+        dr -> errors ++;
+        st |= dr -> result == SCPE_UNATT ? psNotReady : psIOErr;
+      }
+    else if (dr -> op == opRead)
+      {
+        static word18 words [MEM_SIZE + PSA_SECTWORDS];
+        unpack36_18 (words, dr -> buf, (size_t) dr -> sects * PSA_SECTWORDS / 2);
+        dmaToMemory (dr -> addr, words, dr -> count);
+      }
+    dr -> op = opNone;
+    post (d, st);
+    return SCPE_OK;
+  }
+
+static void psaConnect (UNUSED word6 chan, word36 pcw)
+  {
+    int d = (int) ((pcw >> 6) & 037);
+    int cmd = (int) (pcw & 077);
+    if (d >= PSA_DRIVES)
+      return;
+    psaDrive * dr = & psa . drive[d];
+    UNIT * u = & psaUnits[d];
+    if (cmd != pcwRead && cmd != pcwWrite && cmd != pcwSeek)
+      {
+        sim_debug (DBG_DEBUG, & psaDev, "PCW %012llo?\n", (unsigned long long) pcw);
+        return;
+      }
+    if (dr -> op != opNone)
+      {
+        sim_debug (DBG_DEBUG, & psaDev, "drive %d busy\n", d);
+        return;
+      }
+    if (! (u -> flags & UNIT_ATT))
+      {
+        post (d, psNotReady);
+        return;
+      }
+    word15 r = region (d);
+    t_lba lba = (t_lba) (((uint64_t) cpu . M[r + psSector] << 18) | cpu . M[r + psSector + 1]);
+    word15 addr = (word15) (cpu . M[r + psAddr] & BITS15);
+    unsigned count = cpu . M[r + psCount] & BITS15;
+    t_seccnt sects = (t_seccnt) ((count + PSA_SECTWORDS - 1) / PSA_SECTWORDS);
+    t_lba capac = (t_lba) (u -> capac / PSA_SECTBYTES);
+    if (cmd == pcwSeek)
+      {
+        count = 0;
+        sects = 0;
+      }
+    if (lba >= capac || sects > capac - lba || (unsigned) addr + count > MEM_SIZE)
+      {
+        post (d, psRange);
+        return;
+      }
+    if (cmd == pcwWrite && (u -> flags & UNIT_RO))
+      {
+        post (d, psProtect);
+        return;
+      }
+
+    dr -> lba = lba;
+    dr -> sects = sects;
+    dr -> addr = addr;
+    dr -> count = count;
+    dr -> done = false;
+    if (cmd == pcwWrite)
+      fill (dr);
+    int32 cyl = (int32) (lba / PSA_CYLINDER);
+    int32 move = cyl > dr -> cyl ? cyl - dr -> cyl : dr -> cyl - cyl;
+    dr -> cyl = cyl;
+    int32 t = move * psa . seek + psa . rotate + (int32) count * psa . xfer;
+    if (cmd == pcwSeek)
+      {
+        dr -> op = opSeek;
+        dr -> seeks ++;
+      }
+    else
+      {
+        dr -> op = cmd == pcwRead ? opRead : opWrite;
+        if (cmd == pcwRead)
+          dr -> reads ++;
+        else
+          dr -> writes ++;
+        dr -> words += count;
+        queue (dr);
+      }
+    sim_activate (u, t > 0 ? t : 1);
+  }
+
+//
+// Device
+//
+
+// Let a command the worker has finish, and forget it
+static void drain (int d)
+  {
+    psaDrive * dr = & psa . drive[d];
+    if (dr -> op != opNone)
+      await (dr);
+    dr -> op = opNone;
+    sim_cancel (& psaUnits[d]);
+  }
+
+// Snapshot state: each drive's command and where its heads are. A read or
+// write under way is given to the worker again on restore, a write taking
+// its words from memory as restored; on a drive no longer attached it ends
+// not ready.
+typedef struct
+  {
+    int32_t op, cyl;
+    uint32_t addr, count;
+    uint64_t lba;
+    uint32_t sects, pad;
+  } psaDriveState;
+
+static void psaGet (UNUSED DEVICE * dptr, void * buf)
+  {
+    psaDriveState * st = buf;
+    for (int d = 0; d < PSA_DRIVES; d ++, st ++)
+      {
+        psaDrive * dr = & psa . drive[d];
+        st -> op = dr -> op;
+        st -> cyl = dr -> cyl;
+        st -> addr = dr -> addr;
+        st -> count = dr -> count;
+        st -> lba = dr -> lba;
+        st -> sects = dr -> sects;
+      }
+  }
+
+static void psaPut (UNUSED DEVICE * dptr, const void * buf)
+  {
+    const psaDriveState * st = buf;
+    for (int d = 0; d < PSA_DRIVES; d ++, st ++)
+      {
+        psaDrive * dr = & psa . drive[d];
+        drain (d);
+        dr -> cyl = st -> cyl;
+        dr -> addr = (word15) st -> addr;
+        dr -> count = st -> count;
+        dr -> lba = (t_lba) st -> lba;
+        dr -> sects = (t_seccnt) st -> sects;
+        dr -> op = st -> op;
+        if (dr -> op != opRead && dr -> op != opWrite)
+          continue;
+        // Not ready, as psaConnect would have said, if the image went
+        if (! (psaUnits[d] . flags & UNIT_ATT))
+          fail (dr, SCPE_UNATT);
+        else
+          {
+            if (dr -> op == opWrite)
+              fill (dr);
+            queue (dr);
+          }
+      }
+  }
+
+static t_stat psaReset (DEVICE * dptr)
+  {
+    for (int d = 0; d < PSA_DRIVES; d ++)
+      {
+        psaUnits[d] . action = psaSvc;
+        drain (d);
+        if (psaUnits[d] . flags & UNIT_ATT)
+          sim_disk_reset (& psaUnits[d]);
+      }
+    if (psa . registered >= 0)
+      iom_unregister ((word6) psa . registered);
+    psa . registered = -1;
+    t_stat r = snapshot_register (dptr, PSA_DRIVES * sizeof (psaDriveState),
+                                  psaGet, psaPut);
+    if (r != SCPE_OK || (dptr -> flags & DEV_DIS))
+      return r;
+    if (! iom_register ((word6) psa . chan, psaConnect))
+      {
+        sim_printf ("PSA: channel %o is in use\n", psa . chan);
+        return SCPE_ARG;
+      }
+    psa . registered = psa . chan;
+    return SCPE_OK;
+  }
+
+static t_stat psaAttach (UNIT * uptr, char * cptr)
+  {
+    if (! startWorker ())
+      return SCPE_IERR;
+    return sim_disk_attach (uptr, cptr, PSA_SECTBYTES, 1, FALSE, PSA_DBG_DISK,
+                            "PSA", 0, 0);
+  }
+
+static t_stat psaDetach (UNIT * uptr)
+  {
+    if (! (uptr -> flags & UNIT_ATT))
+      return SCPE_OK;
+    drain ((int) (uptr - psaUnits));
+    return sim_disk_detach (uptr);
+  }
+
+//
+// SET and SHOW
+//
+
+static t_stat psaSetChannel (UNUSED UNIT * uptr, UNUSED int32 value,
+                             char * cptr, UNUSED void * desc)
+  {
+    return setChannels (& psaDev, & psa . chan, 0, 077, 8, cptr);
+  }
+
+static t_stat psaSetLevel (UNUSED UNIT * uptr, UNUSED int32 value,
+                           char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& psa . level, 0, 15, 10, cptr);
+  }
+
+static t_stat psaSetSeek (UNUSED UNIT * uptr, UNUSED int32 value,
+                          char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& psa . seek, 0, 100000, 10, cptr);
+  }
+
+static t_stat psaSetRotate (UNUSED UNIT * uptr, UNUSED int32 value,
+                            char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& psa . rotate, 0, 1000000, 10, cptr);
+  }
+
+static t_stat psaSetXfer (UNUSED UNIT * uptr, UNUSED int32 value,
+                          char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& psa . xfer, 0, 1000, 10, cptr);
+  }
+
+static t_stat psaShowConfig (FILE * st, UNUSED UNIT * uptr, UNUSED int32 val,
+                             UNUSED void * desc)
+  {
+    fprintf (st, "channel=%o, level=%d, seek=%d, rotate=%d, xfer=%d", psa . chan,
+             psa . level, psa . seek, psa . rotate, psa . xfer);
+    return SCPE_OK;
+  }
+
+// A stall is a command the host had not finished by the time the model
+// said it was done, so that the CPU waited
+static t_stat psaShowCounters (FILE * st, UNUSED UNIT * uptr,
+                               UNUSED int32 val, UNUSED void * desc)
+  {
+    for (int d = 0; d < PSA_DRIVES; d ++)
+      {
+        psaDrive * dr = & psa . drive[d];
+        fprintf (st, "drive %d %s: %llu reads, %llu writes, %llu seeks, %llu words, %llu errors, %llu stalls\n",
+                 d, psaUnits[d] . flags & UNIT_ATT ? "attached" : "not attached",
+                 (unsigned long long) dr -> reads, (unsigned long long) dr -> writes,
+                 (unsigned long long) dr -> seeks, (unsigned long long) dr -> words,
+                 (unsigned long long) dr -> errors, (unsigned long long) dr -> stalls);
+      }
+    return SCPE_OK;
+  }
+
+static MTAB psaMod [] =
+  {
+    { MTAB_XTD | MTAB_VUN, 0, "FORMAT", "FORMAT", sim_disk_set_fmt, sim_disk_show_fmt, NULL, "Image format" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "CHANNEL", psaSetChannel, NULL, NULL, "IOM channel, octal" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "LEVEL", psaSetLevel, NULL, NULL, "Interrupt level" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "SEEK", psaSetSeek, NULL, NULL, "Instructions a cylinder the heads move" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "ROTATE", psaSetRotate, NULL, NULL, "Instructions for the sector to come round" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "XFER", psaSetXfer, NULL, NULL, "Instructions a word transferred" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "CONFIG", NULL, NULL, psaShowConfig, NULL, "Channel, level and timing" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "COUNTERS", NULL, NULL, psaShowCounters, NULL, "Commands, words and stalls by drive" },
+    { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+  };
+
+static DEBTAB psaDebug [] =
+  {
+    { "DEBUG", DBG_DEBUG },
+    { "DISK", PSA_DBG_DISK },
+    { NULL, 0 }
+  };
+
+DEVICE psaDev =
+  {
+    "PSA",            /* name */
+    psaUnits,         /* units */
+    NULL,             /* registers */
+    psaMod,           /* modifiers */
+    PSA_DRIVES,       /* #units */
+    10,               /* address radix */
+    24,               /* address width */
+    1,                /* address increment */
+    8,                /* data radix */
+    18,               /* data width */
+    NULL,             /* examine routine */
+    NULL,             /* deposit routine */
+    psaReset,         /* reset routine */
+    NULL,             /* boot routine */
+    psaAttach,        /* attach routine */
+    psaDetach,        /* detach routine */
+    NULL,             /* context */
+    DEV_DISABLE | DEV_DEBUG | DEV_DISK, /* flags */
+    0,                /* debug control flags */
+    psaDebug,         /* debug flag names */
+    NULL,             /* memory size change */
+    NULL,             /* logical name */
+    NULL,             /* attach help */
+    NULL,             /* help */
+    NULL,             /* help context */
+    NULL,             /* device description */
+  };
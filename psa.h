@@ -0,0 +1,41 @@
+// PSA mass storage interface
+//
+// Device PSA, up to four disk drives on simh disk images (sim_disk):
+// ATTACH PSA0 <file>, -R for read only. A sector is 128 FNP words, packed
+// as 64 36-bit words (see pack36.h) in 288 bytes of the image.
+//
+// Drive d has a command region of 010 words from 0500 + 010 * d, in the
+// I/O communications region:
+//
+//   +000  sector address, upper 18 bits
+//   +001  sector address, lower 18 bits
+//   +002  memory address
+//   +003  word count; a write of part of a sector fills the rest with 0
+//   +004  status
+//
+// PCWs go to IOM channel CHANNEL (SET PSA CHANNEL=n, octal, default 017).
+// Bits 30-35 are the command, bits 25-29 the drive:
+//
+//   01  read the words from the disk into memory
+//   02  write the words from memory to the disk
+//   03  seek to the sector
+//
+// A command takes SEEK instructions a cylinder of 64 sectors the heads
+// move, ROTATE for the sector to come round, and XFER a word (SET PSA
+// SEEK=n, ROTATE=n, XFER=n). The host reads or writes the image on a
+// worker thread meanwhile, so the CPU goes on running; at the end the
+// words go into memory and the status is set:
+//
+//   400000  done
+//   100000  the host could not read or write the image
+//   040000  no image attached
+//   020000  the sector or memory address is out of range
+//   010000  the image is read only
+//
+// and sublevel d of interrupt level LEVEL is set (SET PSA LEVEL=n, default
+// 6). A command for a drive that is busy is ignored. Only if the host is
+// slower than the model does the CPU wait for it.
+
+#define PSA_DRIVES 4
+
+extern DEVICE psaDev;
@@ -0,0 +1,272 @@
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dn6600.h"
+#include "replay.h"
+
+// Log file: a header, then records in the order they were consumed, each
+// padded to 8 bytes. Native byte order; a log is replayed where it was made.
+
+#define RR_MAGIC    "DN66RR\0\0"
+#define RR_VERSION  1
+#define RR_BUFSZ    (1u << 20)
+
+#define ALIGN8(n)   (((n) + 7u) & ~7u)
+
+typedef struct
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t pad;
+  } rrHdr;
+
+typedef struct
+  {
+    uint64_t icount;
+    uint16_t kind;
+    uint16_t chan;
+    uint32_t len;
+    uint8_t data[];
+  } rrRec;
+
+static struct
+  {
+    FILE * rec;
+    char * recBuf;
+    char recPath[PATH_MAX];
+    uint64_t recorded;
+
+    uint8_t * map;
+    size_t mapLen;
+    size_t pos;
+    uint64_t replayed;
+    uint64_t late;      // taken after the instruction they were due at
+
+    int64_t bias;       // rr_icount - sim_gtime, moved by reverse execution
+  } rr;
+
+static uint64_t icount (void)
+  {
+    return (uint64_t) ((int64_t) sim_gtime () + rr.bias);
+  }
+
+uint64_t rr_icount (void)
+  {
+    return icount ();
+  }
+
+void rr_set_icount (uint64_t n)
+  {
+    rr.bias = (int64_t) n - (int64_t) sim_gtime ();
+  }
+
+bool rr_recording (void)
+  {
+    return rr.rec != NULL;
+  }
+
+bool rr_replaying (void)
+  {
+    return rr.map != NULL;
+  }
+
+void rr_record (int kind, int chan, const uint8_t * data, int sz)
+  {
+    if (! rr.rec)
+      return;
+    static const uint8_t zero[8];
+    rrRec r = { icount (), (uint16_t) kind, (uint16_t) chan, (uint32_t) sz };
+    fwrite (& r, sizeof (r), 1, rr.rec);
+    if (sz)
+      fwrite (data, 1, (size_t) sz, rr.rec);
+    fwrite (zero, 1, ALIGN8 ((uint32_t) sz) - (uint32_t) sz, rr.rec);
+    rr.recorded ++;
+  }
+
+static void recordStop (void)
+  {
+    if (! rr.rec)
+      return;
+    fclose (rr.rec);
+    free (rr.recBuf);
+    rr.rec = NULL;
+    rr.recBuf = NULL;
+    sim_printf ("recorded %llu inputs\n", (unsigned long long) rr.recorded);
+  }
+
+static void replayStop (void)
+  {
+    if (! rr.map)
+      return;
+    munmap (rr.map, rr.mapLen);
+    rr.map = NULL;
+    sim_printf ("replayed %llu inputs, %llu late\n",
+                (unsigned long long) rr.replayed,
+                (unsigned long long) rr.late);
+  }
+
+static t_stat replayMap (const char * path, size_t pos)
+  {
+    int fd = open (path, O_RDONLY);
+    if (fd < 0)
+      return SCPE_OPENERR;
+    struct stat sb;
+    if (fstat (fd, & sb) < 0 || (size_t) sb.st_size < sizeof (rrHdr))
+      {
+        close (fd);
+        return SCPE_FMT;
+      }
+    uint8_t * p = mmap (NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE,
+                        fd, 0);
+    close (fd);
+    if (p == MAP_FAILED)
+      return SCPE_IOERR;
+    rrHdr * h = (rrHdr *) p;
+    if (memcmp (h -> magic, RR_MAGIC, sizeof (h -> magic)) != 0 ||
+        h -> version != RR_VERSION || pos > (size_t) sb.st_size)
+      {
+        munmap (p, (size_t) sb.st_size);
+        return SCPE_FMT;
+      }
+#ifdef MADV_SEQUENTIAL
+    madvise (p, (size_t) sb.st_size, MADV_SEQUENTIAL);
+#endif
+    rr.map = p;
+    rr.mapLen = (size_t) sb.st_size;
+    rr.pos = pos;
+    rr.replayed = 0;
+    rr.late = 0;
+    return SCPE_OK;
+  }
+
+int64_t rr_mark (void)
+  {
+    if (rr.map)
+      return (int64_t) rr.pos;
+    if (rr.rec)
+      return (int64_t) ftell (rr.rec);
+    return -1;
+  }
+
+t_stat rr_seek (int64_t mark)
+  {
+    if (mark < 0)
+      return SCPE_OK;
+    if (rr.map)
+      {
+        if ((size_t) mark > rr.mapLen)
+          return SCPE_IERR;
+        rr.pos = (size_t) mark;
+        return SCPE_OK;
+      }
+    if (! rr.rec)
+      return SCPE_IERR;
+    // Going back over recorded input: stop recording and replay the log
+    // from the mark; the live link takes over again at its end.
+    char path[PATH_MAX];
+    strcpy (path, rr.recPath);
+    recordStop ();
+    sim_printf ("replaying %s from here\n", path);
+    return replayMap (path, (size_t) mark);
+  }
+
+static rrRec * nextRec (void)
+  {
+    if (rr.pos + sizeof (rrRec) > rr.mapLen)
+      return NULL;
+    rrRec * r = (rrRec *) (rr.map + rr.pos);
+    if (rr.pos + sizeof (rrRec) + r -> len > rr.mapLen)
+      return NULL;
+    return r;
+  }
+
+int rr_take (int kind, int chan, uint8_t * * data, bool wait)
+  {
+    if (! rr.map)
+      return -1;
+    rrRec * r = nextRec ();
+    if (! r)
+      {
+        sim_printf ("end of replay\n");
+        replayStop ();
+        return -1;
+      }
+    if (r -> kind != kind || r -> chan != chan)
+      return -1;
+    uint64_t now = icount ();
+    if (! wait && r -> icount > now)
+      return -1;
+    if (r -> icount < now && ! wait)
+      rr.late ++;
+    * data = r -> data;
+    rr.pos += sizeof (rrRec) + ALIGN8 (r -> len);
+    rr.replayed ++;
+    return (int) r -> len;
+  }
+
+int64_t rr_due (int kind, int chan)
+  {
+    if (! rr.map)
+      return -1;
+    rrRec * r = nextRec ();
+    if (! r || r -> kind != kind || r -> chan != chan)
+      return -1;
+    uint64_t now = icount ();
+    return r -> icount > now ? (int64_t) (r -> icount - now) : 0;
+  }
+
+// Not in scp.h
+char * sim_trim_endspc (char * cptr);
+
+// RECORD <file> | RECORD OFF
+t_stat rr_record_cmd (UNUSED int32 flag, char * cptr)
+  {
+    if (! cptr || ! * cptr)
+      return SCPE_2FARG;
+    sim_trim_endspc (cptr);
+    recordStop ();
+    if (strcmp (cptr, "OFF") == 0 || strcmp (cptr, "off") == 0)
+      return SCPE_OK;
+    if (rr.map)
+      {
+        sim_printf ("replay in progress\n");
+        return SCPE_ARG;
+      }
+
+    if (strlen (cptr) >= sizeof (rr.recPath))
+      return SCPE_ARG;
+    rr.rec = sim_fopen (cptr, "wb");
+    if (! rr.rec)
+      return SCPE_OPENERR;
+    strcpy (rr.recPath, cptr);
+    rr.recBuf = malloc (RR_BUFSZ);
+    if (rr.recBuf)
+      setvbuf (rr.rec, rr.recBuf, _IOFBF, RR_BUFSZ);
+    rrHdr h;
+    memset (& h, 0, sizeof (h));
+    memcpy (h.magic, RR_MAGIC, sizeof (h.magic));
+    h.version = RR_VERSION;
+    fwrite (& h, sizeof (h), 1, rr.rec);
+    rr.recorded = 0;
+    return SCPE_OK;
+  }
+
+// REPLAY <file> | REPLAY OFF
+t_stat rr_replay_cmd (UNUSED int32 flag, char * cptr)
+  {
+    if (! cptr || ! * cptr)
+      return SCPE_2FARG;
+    sim_trim_endspc (cptr);
+    replayStop ();
+    if (strcmp (cptr, "OFF") == 0 || strcmp (cptr, "off") == 0)
+      return SCPE_OK;
+    if (rr.rec)
+      {
+        sim_printf ("recording in progress\n");
+        return SCPE_ARG;
+      }
+    return replayMap (cptr, sizeof (rrHdr));
+  }
@@ -0,0 +1,46 @@
+// Deterministic record and replay of external input
+//
+// RECORD <file> logs every input the FNP consumes - coupler packets, line
+// characters, timer ticks - with the instruction count at which it was
+// taken. REPLAY <file> hands the same input back at the same instruction
+// counts, without the real link or lines, so a captured run can be repeated
+// exactly and as fast as the CPU goes. Start both from the same state, e.g.
+// a snapshot taken just before recording began.
+//
+// Devices call these from the simulation thread, at the point they take
+// input:
+//
+//   if (rr_replaying ())
+//     n = rr_take (rrLine, line, & p, false);   // -1 if nothing is due
+//   else
+//     { n = <read it>; rr_record (rrLine, line, p, n); }
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum { rrCoupler = 1, rrLine = 2, rrTick = 3 };
+
+bool rr_recording (void);
+bool rr_replaying (void);
+
+// Log an input; does nothing unless recording
+void rr_record (int kind, int chan, const uint8_t * data, int sz);
+
+// Next input for kind/chan if it is due at this instruction; returns its
+// size (0 for a tick) or -1. With wait, the time is not checked, for input
+// that the CPU was blocked on. The data stays valid until replay stops.
+int rr_take (int kind, int chan, uint8_t * * data, bool wait);
+
+// Instructions until the next input, if it is for kind/chan; otherwise -1.
+// Lets a timer schedule its replayed tick.
+int64_t rr_due (int kind, int chan);
+
+// Instruction count the log is stamped with. Reverse execution winds it
+// back along with the machine, and seeks the input to where it then was.
+uint64_t rr_icount (void);
+void rr_set_icount (uint64_t n);
+int64_t rr_mark (void);       // -1 if input is neither recorded nor replayed
+t_stat rr_seek (int64_t mark);
+
+t_stat rr_record_cmd (int32 flag, char * cptr);
+t_stat rr_replay_cmd (int32 flag, char * cptr);
@@ -0,0 +1,415 @@
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "dn6600.h"
+#include "dn6600_caf.h"
+#include "coupler.h"
+#include "snapshot.h"
+#include "replay.h"
+#include "reverse.h"
+
+#define REV_PAGE      MEM_PAGE
+#define REV_MAXCK     1024
+
+// The registers follow M in cpu_t
+#define REGS_OFF      sizeof (cpu.M)
+#define REGS_SZ       (sizeof (cpu_t) - sizeof (cpu.M))
+
+typedef struct
+  {
+    uint64_t icount;
+    uint8_t regs[REGS_SZ];
+    snapshot_event ev[SNAPSHOT_MAX_EVENTS];
+    int nev;
+    uint32_t coupler;
+    uint8_t * dev;              // snapshot_dev_get
+    uint32_t devSize;
+    int64_t mark;
+    // Pages that differ from the checkpoint before
+    int npages;
+    uint16_t * pageNo;
+    word18 * pages;
+  } revCkpt;
+
+static struct
+  {
+    uint32_t interval;          // instructions between checkpoints
+    uint32_t max;               // checkpoints kept
+    revCkpt * ck[REV_MAXCK];
+    int n;
+    word18 base[MEM_SIZE];      // memory at ck[0]
+    uint64_t limit;             // LASTWRITE: only stores before this count
+    uint64_t hit;               // count just after the last such store
+    bool warned;
+  } rev =
+  {
+    .interval = 100000,
+    .max = 64,
+  };
+
+bool rev_rerunning = false;
+
+static t_stat revSvc (UNIT * uptr);
+static t_stat revStopSvc (UNIT * uptr);
+
+static UNIT revUnit [] =
+  {
+    { UDATA (& revSvc, 0, 0), 0, 0, 0, 0, 0, NULL, NULL },
+    { UDATA (& revStopSvc, 0, 0), 0, 0, 0, 0, 0, NULL, NULL },
+  };
+
+#define ckUnit   (revUnit [0])
+#define stopUnit (revUnit [1])
+
+static void ckFree (revCkpt * c)
+  {
+    free (c -> dev);
+    free (c -> pageNo);
+    free (c -> pages);
+    free (c);
+  }
+
+static void applyDelta (word18 * mem, revCkpt * c)
+  {
+    for (int i = 0; i < c -> npages; i ++)
+      memcpy (mem + c -> pageNo[i] * REV_PAGE, c -> pages + i * REV_PAGE,
+              REV_PAGE * sizeof (word18));
+  }
+
+// Memory as it was at checkpoint i
+static void memAt (word18 * mem, int i)
+  {
+    memcpy (mem, rev.base, sizeof (rev.base));
+    for (int k = 1; k <= i; k ++)
+      applyDelta (mem, rev.ck[k]);
+  }
+
+static void revDiscard (void)
+  {
+    for (int i = 0; i < rev.n; i ++)
+      ckFree (rev.ck[i]);
+    rev.n = 0;
+  }
+
+static void revTake (void)
+  {
+    if (rev.n && rev.n >= (int) rev.max)
+      {
+        // Fold the oldest delta into the base
+        applyDelta (rev.base, rev.ck[1]);
+        ckFree (rev.ck[0]);
+        memmove (rev.ck, rev.ck + 1, (size_t) (rev.n - 1) * sizeof (rev.ck[0]));
+        rev.n --;
+        revCkpt * c = rev.ck[0];
+        free (c -> pageNo);
+        free (c -> pages);
+        c -> pageNo = NULL;
+        c -> pages = NULL;
+        c -> npages = 0;
+      }
+
+    revCkpt * c = calloc (1, sizeof (revCkpt));
+    if (! c)
+      return;
+    c -> icount = rr_icount ();
+    memcpy (c -> regs, (uint8_t *) & cpu + REGS_OFF, REGS_SZ);
+    c -> nev = snapshot_get_events (c -> ev, SNAPSHOT_MAX_EVENTS);
+    c -> coupler = coupler_get_state ();
+    c -> mark = rr_mark ();
+    c -> devSize = snapshot_dev_size ();
+    if (c -> nev < 0 || ! (c -> dev = malloc (c -> devSize ? c -> devSize : 1)))
+      {
+        free (c);
+        return;
+      }
+    snapshot_dev_get (c -> dev);
+
+    // Pages stored into since the last checkpoint, or since the restore
+    // that the last one was re-run from; either way a superset of those
+    // that differ from the last checkpoint.
+    uint64_t bits[MEM_DIRTY_WORDS];
+    snapDirty (bits);
+    if (rev.n == 0)
+      memcpy (rev.base, cpu.M, sizeof (rev.base));
+    else
+      {
+        uint16_t dirty[MEM_NPAGES];
+        int nd = 0;
+        for (int w = 0; w < MEM_DIRTY_WORDS; w ++)
+          for (uint64_t b = bits[w]; b; b &= b - 1)
+            dirty[nd ++] = (uint16_t) (w * 64 + __builtin_ctzll (b));
+        if (nd)
+          {
+            c -> pageNo = malloc ((size_t) nd * sizeof (uint16_t));
+            c -> pages = malloc ((size_t) nd * REV_PAGE * sizeof (word18));
+            if (! c -> pageNo || ! c -> pages)
+              {
+                ckFree (c);
+                return;
+              }
+          }
+        for (int i = 0; i < nd; i ++)
+          {
+            word18 * src = cpu.M + dirty[i] * REV_PAGE;
+            c -> pageNo[i] = dirty[i];
+            memcpy (c -> pages + i * REV_PAGE, src, REV_PAGE * sizeof (word18));
+          }
+        c -> npages = nd;
+      }
+    rev.ck[rev.n ++] = c;
+  }
+
+static void revRestore (int i)
+  {
+    revCkpt * c = rev.ck[i];
+    uint64_t bits[MEM_DIRTY_WORDS];
+    memAt (cpu.M, i);
+    snapDirty (bits); // M is now exactly checkpoint i
+    memcpy ((uint8_t *) & cpu + REGS_OFF, c -> regs, REGS_SZ);
+    coupler_set_state (c -> coupler);
+    snapshot_dev_put (c -> dev, c -> devSize);
+    snapshot_set_events (c -> ev, c -> nev);
+    rr_seek (c -> mark);
+    rr_set_icount (c -> icount);
+  }
+
+// Drop the checkpoints that are now in the future
+static void revTruncate (void)
+  {
+    uint64_t now = rr_icount ();
+    while (rev.n > 1 && rev.ck[rev.n - 1] -> icount > now)
+      ckFree (rev.ck[-- rev.n]);
+  }
+
+// Checkpoint at or before count; -1 if history does not go back that far
+static int revFind (uint64_t count)
+  {
+    for (int i = rev.n - 1; i >= 0; i --)
+      if (rev.ck[i] -> icount <= count)
+        return i;
+    return -1;
+  }
+
+static t_stat revSvc (UNIT * uptr)
+  {
+    sim_activate (uptr, (int32) rev.interval);
+    if (! rev_rerunning)
+      revTake ();
+    return SCPE_OK;
+  }
+
+static t_stat revStopSvc (UNUSED UNIT * uptr)
+  {
+    return SCPE_STOP;
+  }
+
+// Run quietly until the instruction count reaches target
+static t_stat revRunTo (uint64_t target)
+  {
+    t_stat r = SCPE_OK;
+    rev_rerunning = true;
+    for (;;)
+      {
+        uint64_t now = rr_icount ();
+        if (now >= target)
+          break;
+        uint64_t n = target - now;
+        sim_activate (& stopUnit, n > INT32_MAX ? INT32_MAX : (int32) n);
+        r = sim_instr ();
+        sim_cancel (& stopUnit);
+        if (r != SCPE_STOP)
+          break;
+        r = SCPE_OK;
+      }
+    rev_rerunning = false;
+    return r;
+  }
+
+static t_stat revGoTo (uint64_t target)
+  {
+    int i = revFind (target);
+    if (i < 0)
+      return SCPE_ARG;
+    revRestore (i);
+    t_stat r = revRunTo (target);
+    revTruncate ();
+    return r;
+  }
+
+static bool revReady (void)
+  {
+    if (revDev.flags & DEV_DIS)
+      {
+        sim_printf ("reverse execution is off; SET REVERSE ENABLED\n");
+        return false;
+      }
+    if (! rev.n)
+      {
+        sim_printf ("no history yet\n");
+        return false;
+      }
+    if (rr_mark () < 0 && ! rev.warned)
+      {
+        sim_printf ("input is not being recorded; re-runs read live coupler and line input, and may diverge\n");
+        rev.warned = true;
+      }
+    return true;
+  }
+
+void rev_write_hit (void)
+  {
+    uint64_t now = rr_icount ();
+    if (now < rev.limit)
+      rev.hit = now;
+  }
+
+// STEP -n goes back; anything else is the usual STEP
+t_stat rev_step_cmd (int32 flag, char * cptr)
+  {
+    while (isspace ((unsigned char) * cptr))
+      cptr ++;
+    if (cptr[0] != '-' || ! isdigit ((unsigned char) cptr[1]))
+      return run_cmd (flag, cptr);
+    t_stat r;
+    uint64_t n = get_uint (cptr + 1, 10, 0xffffffff, & r);
+    if (r != SCPE_OK)
+      return r;
+    if (! revReady ())
+      return SCPE_OK;
+    uint64_t now = rr_icount ();
+    if (n > now - rev.ck[0] -> icount)
+      {
+        sim_printf ("history goes back %llu instructions\n",
+                    (unsigned long long) (now - rev.ck[0] -> icount));
+        return SCPE_ARG;
+      }
+    r = revGoTo (now - n);
+    return r != SCPE_OK ? r : SCPE_STEP;
+  }
+
+t_stat rev_lastwrite_cmd (UNUSED int32 flag, char * cptr)
+  {
+    t_stat r;
+    if (! cptr || ! * cptr)
+      return SCPE_2FARG;
+    word15 addr = (word15) get_uint (cptr, 8, MEM_SIZE - 1, & r);
+    if (r != SCPE_OK)
+      return r;
+    if (! revReady ())
+      return SCPE_OK;
+
+    // Search back a checkpoint interval at a time
+    uint64_t now = rr_icount ();
+    rev.limit = now;
+    for (int i = revFind (now); i >= 0; i --)
+      {
+        uint64_t end = i + 1 < rev.n && rev.ck[i + 1] -> icount < now ?
+                       rev.ck[i + 1] -> icount : now;
+        rev.hit = 0;
+        revRestore (i);
+        memTrapSet (addr, true);
+        r = revRunTo (end);
+        memTrapSet (addr, false);
+        if (r != SCPE_OK)
+          return r;
+        if (rev.hit)
+          {
+            r = revGoTo (rev.hit);
+            return r != SCPE_OK ? r : SCPE_STOP;
+          }
+      }
+
+    sim_printf ("no store to %05o in the last %llu instructions\n", addr,
+                (unsigned long long) (now - rev.ck[0] -> icount));
+    r = revGoTo (now);
+    return r;
+  }
+
+static t_stat revReset (DEVICE * dptr)
+  {
+    revDiscard ();
+    rev.warned = false;
+    sim_cancel (& ckUnit);
+    sim_cancel (& stopUnit);
+    if (! (dptr -> flags & DEV_DIS))
+      sim_activate (& ckUnit, 0); // history starts at the next instruction
+    return SCPE_OK;
+  }
+
+static t_stat revSetInterval (UNUSED UNIT * uptr, UNUSED int32 value,
+                              char * cptr, UNUSED void * desc)
+  {
+    if (! cptr)
+      return SCPE_ARG;
+    t_stat r;
+    uint32_t n = (uint32_t) get_uint (cptr, 10, INT32_MAX, & r);
+    if (r != SCPE_OK || n == 0)
+      return SCPE_ARG;
+    rev.interval = n;
+    return SCPE_OK;
+  }
+
+static t_stat revSetMax (UNUSED UNIT * uptr, UNUSED int32 value,
+                         char * cptr, UNUSED void * desc)
+  {
+    if (! cptr)
+      return SCPE_ARG;
+    t_stat r;
+    uint32_t n = (uint32_t) get_uint (cptr, 10, REV_MAXCK, & r);
+    if (r != SCPE_OK || n < 2)
+      return SCPE_ARG;
+    rev.max = n;
+    return revReset (& revDev);
+  }
+
+static t_stat revShow (FILE * st, UNUSED UNIT * uptr, UNUSED int32 val,
+                       UNUSED void * desc)
+  {
+    size_t pages = 0;
+    for (int i = 0; i < rev.n; i ++)
+      pages += (size_t) rev.ck[i] -> npages;
+    fprintf (st, "interval=%u, checkpoints=%d of %u, %lu pages held",
+             rev.interval, rev.n, rev.max, (unsigned long) pages);
+    if (rev.n)
+      fprintf (st, ", back %llu instructions",
+               (unsigned long long) (rr_icount () - rev.ck[0] -> icount));
+    return SCPE_OK;
+  }
+
+static MTAB revMod [] =
+  {
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "INTERVAL", revSetInterval, NULL, NULL, "Instructions between checkpoints" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "CHECKPOINTS", revSetMax, NULL, NULL, "Checkpoints kept; sets how far back you can go" },
+    { MTAB_XTD | MTAB_VDV, 0, "HISTORY", NULL, NULL, revShow, NULL, "Reverse execution history" },
+    { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+  };
+
+DEVICE revDev =
+  {
+    "REVERSE",        /* name */
+    revUnit,          /* units */
+    NULL,             /* registers */
+    revMod,           /* modifiers */
+    2,                /* #units */
+    10,               /* address radix */
+    1,                /* address width */
+    1,                /* address increment */
+    10,               /* data radix */
+    1,                /* data width */
+    NULL,             /* examine routine */
+    NULL,             /* deposit routine */
+    revReset,         /* reset routine */
+    NULL,             /* boot routine */
+    NULL,             /* attach routine */
+    NULL,             /* detach routine */
+    NULL,             /* context */
+    DEV_DISABLE | DEV_DIS, /* flags */
+    0,                /* debug control flags */
+    NULL,             /* debug flag names */
+    NULL,             /* memory size change */
+    NULL,             /* logical name */
+    NULL,             // attach help
+    NULL,             // help
+    NULL,             // help context
+    NULL,             // device description
+  };
@@ -0,0 +1,27 @@
+// Reverse execution
+//
+// With the REVERSE device enabled the CPU keeps in-memory checkpoints every
+// INTERVAL instructions: the registers, the pending events, the position in
+// the input log (see replay.h), and the 64-word pages of memory stored into
+// since the checkpoint before, as the dirty bitmap has them. Going back
+// restores the nearest checkpoint at or before the target and re-runs
+// forward to it at full speed.
+//
+//   STEP -n          back n instructions
+//   LASTWRITE addr   back to just after the last store to addr
+//
+// Coupler and line input is reproduced only while it is being recorded or
+// replayed. Otherwise re-runs read live input, and may diverge from the
+// first run.
+
+extern DEVICE revDev;
+
+// Set while re-running to a target; the CPU skips its pacing
+extern bool rev_rerunning;
+
+// Called by the memory store path when it stores to LASTWRITE's address,
+// which is marked MA_TRAP in memAttr.
+void rev_write_hit (void);
+
+t_stat rev_step_cmd (int32 flag, char * cptr);
+t_stat rev_lastwrite_cmd (int32 flag, char * cptr);
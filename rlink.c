@@ -0,0 +1,503 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "rlink.h"
+
+#define RL_MAGIC    0326
+#define RL_DATA     1
+#define RL_ACK      2
+#define RL_SYN      3
+
+#define RTO_NS      20000000ull   // 20ms initial retransmit timeout
+#define RTO_SHIFT   6             // back off to 64 * RTO
+
+#define SLOT(seq)   ((seq) % RLINK_WINDOW)
+
+struct rlink
+  {
+    pthread_mutex_t lock;
+    pthread_cond_t space;
+    rlink_send_fn send;
+    rlink_deliver_fn deliver;
+    void * ctx;
+
+    // Epochs
+    uint32_t epoch;     // ours
+    uint32_t peerEpoch; // 0 until a syn arrives
+    bool synced;        // the peer has echoed ours
+    bool synPending;    // send a syn at the next poll
+    uint64_t synNs;
+    int synTries;
+
+    // Sender
+    uint32_t sndUna;   // oldest unacknowledged
+    uint32_t sndNxt;   // next to send
+    struct
+      {
+        uint8_t * frame;
+        int sz;
+        uint64_t sentNs;
+        int tries;     // 0 until the peer is synced
+        bool acked;    // selectively
+        bool fast;     // fast retransmit already done
+      } tx[RLINK_WINDOW];
+
+    // Receiver
+    uint32_t rcvNxt;   // next expected
+    bool ackPending;
+    struct
+      {
+        uint8_t * data;
+        int sz;
+      } rx[RLINK_WINDOW];
+
+    int loss;
+    unsigned int seed;
+    uint64_t startNs;
+    rlink_stats st;
+  };
+
+static uint64_t nowNs (void)
+  {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, & ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+  }
+
+static void put32 (uint8_t * p, uint32_t v)
+  {
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+  }
+
+static uint32_t get32 (uint8_t * p)
+  {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+           ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+  }
+
+// Sequence comparison, modulo 2^32
+static bool seqLT (uint32_t a, uint32_t b)
+  {
+    return (int32_t) (a - b) < 0;
+  }
+
+// Between syns, until the peer answers; backs off like a retransmit
+static uint64_t synInterval (rlink * rl)
+  {
+    if (! rl -> synTries)
+      return 0;
+    int shift = rl -> synTries - 1;
+    if (shift > RTO_SHIFT)
+      shift = RTO_SHIFT;
+    return RTO_NS << shift;
+  }
+
+// Called with the lock held
+static void xmit (rlink * rl, uint8_t * frame, int sz)
+  {
+    if (rl -> loss && (int) (rand_r (& rl -> seed) % 100) < rl -> loss)
+      {
+        rl -> st.injectedLoss ++;
+        return;
+      }
+    rl -> send (rl -> ctx, frame, sz);
+  }
+
+static void header (rlink * rl, uint8_t * frame, int kind)
+  {
+    memset (frame, 0, RLINK_HDR_SZ);
+    frame[0] = RL_MAGIC;
+    frame[1] = (uint8_t) kind;
+    put32 (frame + 4, rl -> epoch);
+    put32 (frame + 8, rl -> peerEpoch);
+  }
+
+// Called with the lock held
+static void sendData (rlink * rl, uint32_t seq, uint64_t now)
+  {
+    int n = SLOT (seq);
+    rl -> tx[n].sentNs = now;
+    rl -> tx[n].tries ++;
+    put32 (rl -> tx[n].frame + 8, rl -> peerEpoch);
+    xmit (rl, rl -> tx[n].frame, rl -> tx[n].sz);
+  }
+
+// Called with the lock held
+static void sendSyn (rlink * rl, uint64_t now)
+  {
+    uint8_t syn[RLINK_HDR_SZ];
+    header (rl, syn, RL_SYN);
+    rl -> synNs = now;
+    rl -> synTries ++;
+    rl -> synPending = false;
+    rl -> st.synsSent ++;
+    xmit (rl, syn, sizeof (syn));
+  }
+
+// The peer has our epoch; send what has been waiting for that. Called with
+// the lock held.
+static void established (rlink * rl)
+  {
+    rl -> synced = true;
+    rl -> synTries = 0;
+    uint64_t now = nowNs ();
+    for (uint32_t seq = rl -> sndUna; seqLT (seq, rl -> sndNxt); seq ++)
+      sendData (rl, seq, now);
+  }
+
+// The peer has restarted, and has none of what it had of our frames, nor we
+// of its. Frames queued since we were last synced have not been sent, and
+// are kept. Called with the lock held.
+static void restart (rlink * rl)
+  {
+    rl -> st.restarts ++;
+    if (rl -> synced)
+      {
+        for (int i = 0; i < RLINK_WINDOW; i ++)
+          {
+            free (rl -> tx[i].frame);
+            rl -> tx[i].frame = NULL;
+          }
+        rl -> sndUna = rl -> sndNxt = 0;
+        pthread_cond_broadcast (& rl -> space);
+      }
+    for (int i = 0; i < RLINK_WINDOW; i ++)
+      {
+        free (rl -> rx[i].data);
+        rl -> rx[i].data = NULL;
+      }
+    rl -> rcvNxt = 0;
+    rl -> ackPending = false;
+    rl -> synced = false;
+  }
+
+// Called with the lock held
+static void synInput (rlink * rl, uint32_t src, uint32_t dst)
+  {
+    if (! src)
+      return;
+    if (src != rl -> peerEpoch)
+      {
+        if (rl -> peerEpoch)
+          restart (rl);
+        rl -> peerEpoch = src;
+      }
+    if (dst != rl -> epoch)
+      {
+        rl -> synPending = true; // tell it ours
+        return;
+      }
+    if (! rl -> synced)
+      established (rl);
+    rl -> ackPending = true; // which tells the peer we have its epoch
+  }
+
+rlink * rlink_create (rlink_send_fn send, rlink_deliver_fn deliver, void * ctx)
+  {
+    rlink * rl = calloc (1, sizeof (rlink));
+    if (! rl)
+      return NULL;
+    pthread_mutex_init (& rl -> lock, NULL);
+    pthread_cond_init (& rl -> space, NULL);
+    rl -> send = send;
+    rl -> deliver = deliver;
+    rl -> ctx = ctx;
+    rl -> seed = (unsigned int) nowNs () ^ (unsigned int) getpid ();
+    rl -> startNs = nowNs ();
+    do
+      rl -> epoch = ((uint32_t) rand_r (& rl -> seed) << 16) ^ (uint32_t) rand_r (& rl -> seed);
+    while (! rl -> epoch);
+    return rl;
+  }
+
+void rlink_destroy (rlink * rl)
+  {
+    if (! rl)
+      return;
+    for (int i = 0; i < RLINK_WINDOW; i ++)
+      {
+        free (rl -> tx[i].frame);
+        free (rl -> rx[i].data);
+      }
+    pthread_cond_destroy (& rl -> space);
+    pthread_mutex_destroy (& rl -> lock);
+    free (rl);
+  }
+
+static int queue (rlink * rl, uint8_t * data, int sz, bool wait)
+  {
+    uint8_t * frame = malloc ((size_t) (RLINK_HDR_SZ + sz));
+    if (! frame)
+      return -1;
+    memcpy (frame + RLINK_HDR_SZ, data, (size_t) sz);
+
+    pthread_mutex_lock (& rl -> lock);
+    while (rl -> sndNxt - rl -> sndUna >= RLINK_WINDOW)
+      {
+        if (! wait)
+          {
+            pthread_mutex_unlock (& rl -> lock);
+            free (frame);
+            return -1;
+          }
+        pthread_cond_wait (& rl -> space, & rl -> lock);
+      }
+    header (rl, frame, RL_DATA);
+    uint32_t seq = rl -> sndNxt ++;
+    put32 (frame + 12, seq);
+    int n = SLOT (seq);
+    rl -> tx[n].frame = frame;
+    rl -> tx[n].sz = RLINK_HDR_SZ + sz;
+    rl -> tx[n].tries = 0;
+    rl -> tx[n].acked = false;
+    rl -> tx[n].fast = false;
+    rl -> st.framesSent ++;
+    rl -> st.bytesSent += (uint64_t) sz;
+    if (rl -> synced)
+      sendData (rl, seq, nowNs ());
+    pthread_mutex_unlock (& rl -> lock);
+    return 0;
+  }
+
+int rlink_send (rlink * rl, uint8_t * data, int sz)
+  {
+    return queue (rl, data, sz, true);
+  }
+
+int rlink_send_nowait (rlink * rl, uint8_t * data, int sz)
+  {
+    return queue (rl, data, sz, false);
+  }
+
+// Called with the lock held
+static void ackInput (rlink * rl, uint32_t cum, uint64_t sack)
+  {
+    rl -> st.acksReceived ++;
+
+    // Cumulative part
+    if (seqLT (rl -> sndNxt, cum))
+      return; // acks something never sent
+    bool moved = false;
+    while (seqLT (rl -> sndUna, cum))
+      {
+        int n = SLOT (rl -> sndUna);
+        free (rl -> tx[n].frame);
+        rl -> tx[n].frame = NULL;
+        rl -> sndUna ++;
+        moved = true;
+      }
+    if (moved)
+      pthread_cond_broadcast (& rl -> space);
+
+    // Selective part; anything outstanding below the highest frame the
+    // receiver has is a hole, and is resent once straight away.
+    if (! sack)
+      return;
+    uint32_t highest = cum;
+    for (int i = 0; i < 64; i ++)
+      {
+        if (! (sack & (1ull << i)))
+          continue;
+        uint32_t seq = cum + 1 + (uint32_t) i;
+        if (! seqLT (seq, rl -> sndNxt))
+          break;
+        rl -> tx[SLOT (seq)].acked = true;
+        highest = seq;
+      }
+    uint64_t now = nowNs ();
+    for (uint32_t seq = rl -> sndUna; seqLT (seq, highest); seq ++)
+      {
+        int n = SLOT (seq);
+        if (rl -> tx[n].acked || rl -> tx[n].fast)
+          continue;
+        rl -> tx[n].fast = true;
+        rl -> st.fastRetransmits ++;
+        sendData (rl, seq, now);
+      }
+  }
+
+void rlink_input (rlink * rl, uint8_t * frame, int sz)
+  {
+    if (sz < RLINK_HDR_SZ || frame[0] != RL_MAGIC)
+      {
+        // Not framed; pass it through
+        rl -> deliver (rl -> ctx, frame, sz);
+        return;
+      }
+
+    pthread_mutex_lock (& rl -> lock);
+    uint32_t src = get32 (frame + 4);
+    uint32_t dst = get32 (frame + 8);
+    uint32_t seq = get32 (frame + 12);
+    if (frame[1] == RL_SYN)
+      {
+        synInput (rl, src, dst);
+        pthread_mutex_unlock (& rl -> lock);
+        return;
+      }
+    if (! src || src != rl -> peerEpoch || dst != rl -> epoch)
+      {
+        // From or for an earlier run of one end
+        rl -> st.stale ++;
+        rl -> synPending = true;
+        pthread_mutex_unlock (& rl -> lock);
+        return;
+      }
+    if (! rl -> synced)
+      established (rl);
+    if (frame[1] == RL_ACK)
+      {
+        uint64_t sack = ((uint64_t) get32 (frame + 16) << 32) | get32 (frame + 20);
+        ackInput (rl, seq, sack);
+        pthread_mutex_unlock (& rl -> lock);
+        return;
+      }
+    if (frame[1] != RL_DATA)
+      {
+        pthread_mutex_unlock (& rl -> lock);
+        return;
+      }
+
+    rl -> st.framesReceived ++;
+    rl -> ackPending = true;
+    if (seqLT (seq, rl -> rcvNxt) || seq - rl -> rcvNxt >= RLINK_WINDOW ||
+        rl -> rx[SLOT (seq)].data)
+      {
+        rl -> st.duplicates ++;
+        pthread_mutex_unlock (& rl -> lock);
+        return;
+      }
+
+    int dsz = sz - RLINK_HDR_SZ;
+    if (seq != rl -> rcvNxt)
+      {
+        // Hold it until the hole before it is filled
+        uint8_t * p = malloc ((size_t) dsz + 1);
+        if (p)
+          {
+            memcpy (p, frame + RLINK_HDR_SZ, (size_t) dsz);
+            rl -> rx[SLOT (seq)].data = p;
+            rl -> rx[SLOT (seq)].sz = dsz;
+            rl -> st.outOfOrder ++;
+          }
+        pthread_mutex_unlock (& rl -> lock);
+        return;
+      }
+
+    // In order; deliver it and anything it releases. Delivery is done
+    // unlocked, as the receiver may have to wait for buffer space.
+    rl -> rcvNxt ++;
+    rl -> st.delivered ++;
+    rl -> st.bytesDelivered += (uint64_t) dsz;
+    pthread_mutex_unlock (& rl -> lock);
+    rl -> deliver (rl -> ctx, frame + RLINK_HDR_SZ, dsz);
+
+    pthread_mutex_lock (& rl -> lock);
+    for (;;)
+      {
+        int n = SLOT (rl -> rcvNxt);
+        uint8_t * p = rl -> rx[n].data;
+        if (! p)
+          break;
+        int psz = rl -> rx[n].sz;
+        rl -> rx[n].data = NULL;
+        rl -> rcvNxt ++;
+        rl -> st.delivered ++;
+        rl -> st.bytesDelivered += (uint64_t) psz;
+        pthread_mutex_unlock (& rl -> lock);
+        rl -> deliver (rl -> ctx, p, psz);
+        free (p);
+        pthread_mutex_lock (& rl -> lock);
+      }
+    pthread_mutex_unlock (& rl -> lock);
+  }
+
+void rlink_poll (rlink * rl)
+  {
+    pthread_mutex_lock (& rl -> lock);
+    uint64_t now = nowNs ();
+
+    if (rl -> synPending ||
+        (! rl -> synced && now - rl -> synNs >= synInterval (rl)))
+      sendSyn (rl, now);
+
+    if (rl -> ackPending)
+      {
+        uint8_t ack[RLINK_HDR_SZ];
+        header (rl, ack, RL_ACK);
+        put32 (ack + 12, rl -> rcvNxt);
+        uint64_t sack = 0;
+        for (int i = 0; i < 64; i ++)
+          if (rl -> rx[SLOT (rl -> rcvNxt + 1 + (uint32_t) i)].data)
+            sack |= 1ull << i;
+        put32 (ack + 16, (uint32_t) (sack >> 32));
+        put32 (ack + 20, (uint32_t) sack);
+        rl -> ackPending = false;
+        rl -> st.acksSent ++;
+        xmit (rl, ack, sizeof (ack));
+      }
+
+    for (uint32_t seq = rl -> sndUna; rl -> synced && seqLT (seq, rl -> sndNxt); seq ++)
+      {
+        int n = SLOT (seq);
+        if (rl -> tx[n].acked)
+          continue;
+        int shift = rl -> tx[n].tries - 1;
+        if (shift > RTO_SHIFT)
+          shift = RTO_SHIFT;
+        if (now - rl -> tx[n].sentNs < (RTO_NS << shift))
+          continue;
+        rl -> st.retransmits ++;
+        sendData (rl, seq, now);
+      }
+
+    pthread_mutex_unlock (& rl -> lock);
+  }
+
+int rlink_timeout (rlink * rl)
+  {
+    pthread_mutex_lock (& rl -> lock);
+    int64_t ms = rl -> ackPending || rl -> synPending ? 0 : -1;
+    uint64_t now = nowNs ();
+    if (ms && ! rl -> synced)
+      {
+        uint64_t due = rl -> synNs + synInterval (rl);
+        ms = due > now ? (int64_t) ((due - now + 999999) / 1000000) : 0;
+      }
+    for (uint32_t seq = rl -> sndUna; ms && rl -> synced && seqLT (seq, rl -> sndNxt); seq ++)
+      {
+        int n = SLOT (seq);
+        if (rl -> tx[n].acked)
+          continue;
+        int shift = rl -> tx[n].tries - 1;
+        if (shift > RTO_SHIFT)
+          shift = RTO_SHIFT;
+        uint64_t due = rl -> tx[n].sentNs + (RTO_NS << shift);
+        int64_t left = due > now ? (int64_t) ((due - now + 999999) / 1000000) : 0;
+        if (ms < 0 || left < ms)
+          ms = left;
+      }
+    pthread_mutex_unlock (& rl -> lock);
+    return (int) ms;
+  }
+
+void rlink_set_loss (rlink * rl, int percent)
+  {
+    pthread_mutex_lock (& rl -> lock);
+    rl -> loss = percent;
+    pthread_mutex_unlock (& rl -> lock);
+  }
+
+void rlink_get_stats (rlink * rl, rlink_stats * st)
+  {
+    pthread_mutex_lock (& rl -> lock);
+    * st = rl -> st;
+    st -> elapsed = (double) (nowNs () - rl -> startNs) / 1e9;
+    pthread_mutex_unlock (& rl -> lock);
+  }
@@ -0,0 +1,82 @@
+// Reliable, sequenced framing for the coupler link
+//
+// Wraps the coupler packets in frames carrying a sequence number and has the
+// receiver answer with a cumulative acknowledgement plus a selective ack
+// bitmap, so lost frames are resent individually rather than stalling the
+// link. Packets that are not frames are passed through untouched, so a peer
+// that does not frame still works in one direction.
+//
+// Frame header (network byte order):
+//
+//   0     magic (0326)
+//   1     kind: data, ack or syn
+//   2- 3  0
+//   4- 7  the sender's epoch
+//   8-11  the receiver's epoch, as far as the sender knows it; else 0
+//  12-15  data: sequence number; ack: next sequence number expected
+//  16-23  ack: bit n set if frame (expected + 1 + n) has been received
+//
+// Each end picks a random epoch at rlink_create and numbers its frames
+// from 0. Syn frames trade epochs, and data waits until the peer has echoed
+// ours. A syn with a new epoch means the peer has restarted: both ends
+// number from 0 again, and what was in flight is dropped. A data or ack
+// frame carrying an epoch that is not current is answered with a syn.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define RLINK_HDR_SZ 24
+#define RLINK_WINDOW 512   // frames in flight; a bootload is a few hundred
+
+typedef struct
+  {
+    uint64_t framesSent;
+    uint64_t bytesSent;
+    uint64_t retransmits;      // on timeout
+    uint64_t fastRetransmits;  // on a hole in the selective acks
+    uint64_t acksSent;
+    uint64_t acksReceived;
+    uint64_t framesReceived;
+    uint64_t duplicates;
+    uint64_t outOfOrder;
+    uint64_t delivered;
+    uint64_t bytesDelivered;
+    uint64_t injectedLoss;
+    uint64_t synsSent;
+    uint64_t restarts;         // of the peer
+    uint64_t stale;            // frames for another epoch
+    double elapsed;            // seconds since rlink_create
+  } rlink_stats;
+
+typedef struct rlink rlink;
+
+// send: put a frame on the wire. deliver: hand an in-order packet up.
+typedef void (* rlink_send_fn) (void * ctx, uint8_t * frame, int sz);
+typedef void (* rlink_deliver_fn) (void * ctx, uint8_t * data, int sz);
+
+rlink * rlink_create (rlink_send_fn send, rlink_deliver_fn deliver, void * ctx);
+void rlink_destroy (rlink * rl);
+
+// Queue a packet; waits while the window is full. Must not be called from
+// the thread that calls rlink_input/rlink_poll.
+int rlink_send (rlink * rl, uint8_t * data, int sz);
+
+// As rlink_send, but returns -1 rather than wait for room; for the thread
+// that calls rlink_input/rlink_poll.
+int rlink_send_nowait (rlink * rl, uint8_t * data, int sz);
+
+// Feed a received datagram
+void rlink_input (rlink * rl, uint8_t * frame, int sz);
+
+// Send any pending ack and resend anything overdue; call after each batch
+// of input and periodically when idle.
+void rlink_poll (rlink * rl);
+
+// Milliseconds until rlink_poll has something to do: 0 if an ack is
+// waiting to go, -1 if nothing is outstanding.
+int rlink_timeout (rlink * rl);
+
+// Drop this percentage of outgoing frames, for testing
+void rlink_set_loss (rlink * rl, int percent);
+
+void rlink_get_stats (rlink * rl, rlink_stats * st);
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "shmlib.h"
+
+// Segment layout
+//
+//   header
+//   ring [shmSideHost]   host -> FNP
+//   ring [shmSideFNP]    FNP -> host
+//
+// Each side receives on the ring of the other side's number. Ring positions
+// are free running byte counts; a record is a 4 byte length followed by the
+// data, padded to 8 bytes. A record that would not fit before the end of the
+// ring is preceded by a wrap marker and placed at the start.
+
+#define SHM_MAGIC    0x444e3636 // "DN66"
+#define SHM_VERSION  2
+#define RING_SIZE    (1u << 20)
+#define RING_MASK    (RING_SIZE - 1)
+#define REC_WRAP     0xffffffffu
+#define MAXLINKS     16
+#define WAIT_NS      100000000 // a blocked receive looks up this often
+
+#define ALIGN8(n)    (((n) + 7u) & ~7u)
+
+struct shmRing
+  {
+    uint32_t head;     // consumer position
+    uint8_t pad0[60];
+    uint32_t tail;     // producer position
+    uint32_t seq;      // doorbell; bumped on every commit
+    uint32_t waiting;  // consumer is asleep on seq
+    uint8_t pad1[52];
+    uint8_t data[RING_SIZE];
+  };
+
+struct shmSeg
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ringSize;
+    uint32_t pid[2];   // of each side while attached, else 0
+    uint8_t pad[44];
+    struct shmRing ring[2];
+  };
+
+static struct
+  {
+    bool used;
+    bool creator;
+    int side;
+    char name[NAME_MAX];
+    struct shmSeg * seg;
+    struct shmRing * tx;
+    struct shmRing * rx;
+    uint32_t rxPending;   // bytes to consume at the next receive
+    uint32_t txReserved;  // bytes reserved, not yet committed
+    bool peerSeen;        // the other side has attached
+    volatile bool closing; // shmlib_shutdown
+  } shm_links[MAXLINKS];
+
+static inline uint32_t loadAcq (uint32_t * p)
+  {
+    return __atomic_load_n (p, __ATOMIC_ACQUIRE);
+  }
+
+static inline void storeRel (uint32_t * p, uint32_t v)
+  {
+    __atomic_store_n (p, v, __ATOMIC_RELEASE);
+  }
+
+static void pause10us (void)
+  {
+    struct timespec ts = { 0, 10000 };
+    nanosleep (& ts, NULL);
+  }
+
+#ifdef __linux__
+// Returns after a ring, or at most WAIT_NS
+static void doorbellWait (uint32_t * addr, uint32_t val)
+  {
+    struct timespec ts = { 0, WAIT_NS };
+    syscall (SYS_futex, addr, FUTEX_WAIT, val, & ts, NULL, 0);
+  }
+
+static void doorbellRing (uint32_t * addr)
+  {
+    syscall (SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  }
+#else
+// No cross-process futex; fall back to a short sleep.
+static void doorbellWait (uint32_t * addr, uint32_t val)
+  {
+    (void) addr;
+    (void) val;
+    pause10us ();
+  }
+
+static void doorbellRing (uint32_t * addr)
+  {
+    (void) addr;
+  }
+#endif
+
+// The other side has released the segment, or its process has gone
+static bool peerGone (int link)
+  {
+    uint32_t pid = loadAcq (& shm_links[link].seg -> pid[shm_links[link].side ^ 1]);
+    if (! pid)
+      return shm_links[link].peerSeen;
+    shm_links[link].peerSeen = true;
+    return kill ((pid_t) pid, 0) < 0 && errno == ESRCH;
+  }
+
+int shmlib_create (const char * name, int side, int32_t * pln)
+  {
+    int link;
+    for (link = 0; link < MAXLINKS; link ++)
+      if (! shm_links[link].used)
+        break;
+    if (link >= MAXLINKS)
+      return -1;
+
+    if (side != shmSideHost && side != shmSideFNP)
+      return -1;
+
+    char path[NAME_MAX];
+    snprintf (path, sizeof (path), "%s%s", name[0] == '/' ? "" : "/", name);
+
+    bool creator = true;
+    int fd = shm_open (path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST)
+      {
+        creator = false;
+        fd = shm_open (path, O_RDWR, 0600);
+      }
+    if (fd < 0)
+      {
+        perror ("shm_open");
+        return -1;
+      }
+
+    if (creator && ftruncate (fd, sizeof (struct shmSeg)) < 0)
+      {
+        perror ("ftruncate");
+        close (fd);
+        shm_unlink (path);
+        return -1;
+      }
+
+    // Give the creator up to a second to size the segment
+    struct stat sb;
+    for (int i = 0; i < 100000; i ++)
+      {
+        if (fstat (fd, & sb) == 0 && (size_t) sb.st_size >= sizeof (struct shmSeg))
+          break;
+        pause10us ();
+      }
+    if ((size_t) sb.st_size < sizeof (struct shmSeg))
+      {
+        fprintf (stderr, "shmlib_create: %s is too small\n", path);
+        close (fd);
+        return -1;
+      }
+
+    struct shmSeg * seg = mmap (NULL, sizeof (struct shmSeg),
+                                PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (seg == MAP_FAILED)
+      {
+        perror ("mmap");
+        if (creator)
+          shm_unlink (path);
+        return -1;
+      }
+
+    if (creator)
+      {
+        // A fresh segment is zero filled, so the rings are already empty.
+        seg -> version = SHM_VERSION;
+        seg -> ringSize = RING_SIZE;
+        storeRel (& seg -> magic, SHM_MAGIC);
+      }
+    else
+      {
+        for (int i = 0; i < 100000 && loadAcq (& seg -> magic) != SHM_MAGIC; i ++)
+          pause10us ();
+        if (loadAcq (& seg -> magic) != SHM_MAGIC ||
+            seg -> version != SHM_VERSION || seg -> ringSize != RING_SIZE)
+          {
+            fprintf (stderr, "shmlib_create: %s has the wrong format\n", path);
+            munmap (seg, sizeof (struct shmSeg));
+            return -1;
+          }
+      }
+
+    shm_links[link].used = true;
+    shm_links[link].creator = creator;
+    shm_links[link].side = side;
+    snprintf (shm_links[link].name, sizeof (shm_links[link].name), "%s", path);
+    shm_links[link].seg = seg;
+    shm_links[link].tx = & seg -> ring[side];
+    shm_links[link].rx = & seg -> ring[side ^ 1];
+    shm_links[link].rxPending = 0;
+    shm_links[link].txReserved = 0;
+    shm_links[link].peerSeen = false;
+    shm_links[link].closing = false;
+    storeRel (& seg -> pid[side], (uint32_t) getpid ());
+    * pln = link;
+    return 0;
+  }
+
+void shmlib_shutdown (int link)
+  {
+    if (link < 0 || link >= MAXLINKS || ! shm_links[link].used)
+      return;
+    shm_links[link].closing = true;
+    __atomic_add_fetch (& shm_links[link].rx -> seq, 1, __ATOMIC_SEQ_CST);
+    doorbellRing (& shm_links[link].rx -> seq);
+  }
+
+int shmlib_release (int link)
+  {
+    if (link < 0 || link >= MAXLINKS || ! shm_links[link].used)
+      return -1;
+    // Let the other side see we have gone
+    struct shmSeg * seg = shm_links[link].seg;
+    storeRel (& seg -> pid[shm_links[link].side], 0);
+    __atomic_add_fetch (& shm_links[link].tx -> seq, 1, __ATOMIC_SEQ_CST);
+    doorbellRing (& shm_links[link].tx -> seq);
+    munmap (seg, sizeof (struct shmSeg));
+    if (shm_links[link].side == shmSideHost)
+      shm_unlink (shm_links[link].name);
+    shm_links[link].used = false;
+    return 0;
+  }
+
+uint8_t * dn_shm_reserve (int link, uint16_t count)
+  {
+    // An empty record would read as "nothing waiting" at the other end
+    if (! count)
+      return NULL;
+    struct shmRing * r = shm_links[link].tx;
+    uint32_t need = ALIGN8 (4u + count);
+    uint32_t tail = r -> tail + shm_links[link].txReserved;
+
+    // Wait for room, including the skip to the start of the ring if the
+    // record would straddle the end.
+    for (;;)
+      {
+        uint32_t head = loadAcq (& r -> head);
+        uint32_t room = RING_SIZE - (tail - head);
+        uint32_t toEnd = RING_SIZE - (tail & RING_MASK);
+        uint32_t want = need <= toEnd ? need : need + toEnd;
+        if (want <= room)
+          break;
+        // The consumer cannot free what it has not been shown
+        if (shm_links[link].txReserved)
+          {
+            dn_shm_commit (link);
+            continue;
+          }
+        if (shm_links[link].closing || peerGone (link))
+          return NULL;
+        pause10us ();
+      }
+
+    uint32_t toEnd = RING_SIZE - (tail & RING_MASK);
+    if (need > toEnd)
+      {
+        * (uint32_t *) (r -> data + (tail & RING_MASK)) = REC_WRAP;
+        tail += toEnd;
+      }
+    * (uint32_t *) (r -> data + (tail & RING_MASK)) = count;
+    shm_links[link].txReserved = tail + need - r -> tail;
+    return r -> data + (tail & RING_MASK) + 4;
+  }
+
+void dn_shm_commit (int link)
+  {
+    struct shmRing * r = shm_links[link].tx;
+    storeRel (& r -> tail, r -> tail + shm_links[link].txReserved);
+    shm_links[link].txReserved = 0;
+    __atomic_add_fetch (& r -> seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n (& r -> waiting, __ATOMIC_SEQ_CST))
+      doorbellRing (& r -> seq);
+  }
+
+int dn_shm_send (int link, uint8_t * pdata, uint16_t count)
+  {
+    if (link < 0 || link >= MAXLINKS || ! shm_links[link].used)
+      return -1;
+    uint8_t * p = dn_shm_reserve (link, count);
+    if (! p)
+      return -1;
+    memcpy (p, pdata, count);
+    dn_shm_commit (link);
+    return 0;
+  }
+
+int dn_shm_receive (int link, uint8_t * * pdata, bool block)
+  {
+    if (link < 0 || link >= MAXLINKS || ! shm_links[link].used)
+      return -1;
+    struct shmRing * r = shm_links[link].rx;
+
+    // Release the record handed out by the previous call
+    if (shm_links[link].rxPending)
+      {
+        storeRel (& r -> head, r -> head + shm_links[link].rxPending);
+        shm_links[link].rxPending = 0;
+      }
+
+    uint32_t head = r -> head;
+    for (;;)
+      {
+        uint32_t seq = __atomic_load_n (& r -> seq, __ATOMIC_SEQ_CST);
+        if (loadAcq (& r -> tail) != head)
+          break;
+        if (! block || shm_links[link].closing)
+          return 0;
+        if (peerGone (link))
+          return -1;
+        __atomic_store_n (& r -> waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n (& r -> tail, __ATOMIC_SEQ_CST) == head)
+          doorbellWait (& r -> seq, seq);
+        __atomic_store_n (& r -> waiting, 0, __ATOMIC_SEQ_CST);
+      }
+
+    uint32_t len = * (uint32_t *) (r -> data + (head & RING_MASK));
+    if (len == REC_WRAP)
+      {
+        head += RING_SIZE - (head & RING_MASK);
+        len = * (uint32_t *) (r -> data + (head & RING_MASK));
+      }
+    * pdata = r -> data + (head & RING_MASK) + 4;
+    shm_links[link].rxPending = head + ALIGN8 (4u + len) - r -> head;
+    return (int) len;
+  }
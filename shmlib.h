@@ -0,0 +1,41 @@
+// Shared memory coupler transport
+//
+// A POSIX shared memory segment holding two single-producer/single-consumer
+// rings, one per direction, for co-located host and FNP emulators. Records
+// are never split across the end of a ring, so a receiver can be handed a
+// pointer straight into the segment and copy (or DMA) from there.
+//
+//   ATTACH COUPLER shm:<name>
+//
+// Either side may create the segment; the host side removes it on release.
+// Each side puts its pid in the segment while attached, so a blocked
+// receive or send gives up if the other side releases it or exits.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum { shmSideHost = 0, shmSideFNP = 1 };
+
+int shmlib_create (const char * name, int side, int32_t * pln);
+int shmlib_release (int link);
+
+// Wake a receive blocked on the link in another thread, and have receives
+// return 0 from now on; before shmlib_release.
+void shmlib_shutdown (int link);
+
+// Copying send; returns 0, or -1 if count is 0 or the other side has gone
+int dn_shm_send (int link, uint8_t * pdata, uint16_t count);
+
+// Zero copy send: reserve space for count bytes in the ring, fill it in,
+// then commit it. Several reservations may be committed together, with a
+// single doorbell. Returns NULL if count is 0 (records are never empty, so
+// that a receive of 0 always means none), or if the ring stays full and the
+// other side has gone.
+uint8_t * dn_shm_reserve (int link, uint16_t count);
+void dn_shm_commit (int link);
+
+// Returns the size of the next record and a pointer to it in the ring, 0
+// if none is waiting and !block or the link is shut down, or -1 if none is
+// waiting and the other side has gone. The record remains valid until the
+// next call to dn_shm_receive on the link.
+int dn_shm_receive (int link, uint8_t * * pdata, bool block);
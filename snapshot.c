@@ -0,0 +1,388 @@
+#include <unistd.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dn6600.h"
+#include "dn6600_caf.h"
+#include "coupler.h"
+#include "snapshot.h"
+#include "evq.h"
+
+// File layout, native byte order:
+//
+//   header
+//   cpu_t        at cpuOff, page aligned
+//   snapEvent    nEvents, in queue order; SCP's queue, then evq's
+//   devices      devSize bytes at devOff: for each, a snapDev and its
+//                block, padded to 8 bytes
+//
+// A change to cpu_t or to what is saved must bump SNAP_VERSION.
+
+#define SNAP_MAGIC    "DN66SNAP"
+#define SNAP_VERSION  3
+#define SNAP_ALIGN    4096
+
+typedef struct
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t cpuSize;
+    uint64_t cpuOff;
+    uint64_t evOff;
+    uint32_t nEvents;
+    uint32_t couplerState;
+    uint64_t devOff;
+    uint32_t devSize;
+    uint32_t pad;
+  } snapHdr;
+
+typedef struct
+  {
+    char dev[CBUFSIZE / 8];
+    uint32_t unit;
+    int32_t delay;
+    uint32_t queue;  // 1: evq
+  } snapEvent;
+
+typedef struct
+  {
+    char dev[CBUFSIZE / 8];
+    uint32_t size;
+    uint32_t pad;
+  } snapDev;
+
+#define DEV_PAD(n) (((n) + 7u) & ~ 7u)
+
+static struct
+  {
+    DEVICE * dptr;
+    uint32_t size;
+    snapshot_get_fn get;
+    snapshot_put_fn put;
+  } devs [32];
+static int nDevs;
+
+static uint8_t devBuf [SNAPSHOT_DEV_MAX];  // for snapshot_save
+
+// Not in scp.h
+char * get_sim_sw (char * cptr);
+char * sim_trim_endspc (char * cptr);
+
+static bool isSnapshot (const char * path)
+  {
+    snapHdr h;
+    FILE * f = sim_fopen (path, "rb");
+    if (! f)
+      return false;
+    bool rc = fread (& h, sizeof (h), 1, f) == 1 &&
+              memcmp (h.magic, SNAP_MAGIC, sizeof (h.magic)) == 0;
+    fclose (f);
+    return rc;
+  }
+
+int snapshot_get_events (snapshot_event * ev, int max)
+  {
+    int n = 0;
+    int32 accum = 0;
+
+    // As sim_activate_time; the head of the queue is counting down in
+    // sim_interval, the rest hold the delay from their predecessor.
+    for (UNIT * uptr = sim_clock_queue; uptr != QUEUE_LIST_END;
+         uptr = uptr -> next)
+      {
+        if (uptr == sim_clock_queue)
+          accum = sim_interval > 0 ? sim_interval : 0;
+        else
+          accum += uptr -> time;
+        // Only device units; not scp's own, such as STEP's timer
+        if (! find_dev_from_unit (uptr))
+          continue;
+        if (n >= max)
+          return -1;
+        ev[n].uptr = uptr;
+        ev[n].delay = accum;
+        ev[n].evq = false;
+        n ++;
+      }
+
+    UNIT * units[SNAPSHOT_MAX_EVENTS];
+    int32 delays[SNAPSHOT_MAX_EVENTS];
+    int nq = evq_get (units, delays, max - n);
+    if (nq < 0)
+      return -1;
+    for (int i = 0; i < nq; i ++, n ++)
+      {
+        ev[n].uptr = units[i];
+        ev[n].delay = delays[i];
+        ev[n].evq = true;
+      }
+    return n;
+  }
+
+void snapshot_set_events (const snapshot_event * ev, int n)
+  {
+    UNIT * uptr = sim_clock_queue;
+    while (uptr != QUEUE_LIST_END)
+      {
+        UNIT * next = uptr -> next;
+        if (find_dev_from_unit (uptr))
+          sim_cancel (uptr);
+        uptr = next;
+      }
+    evq_clear ();
+    for (int i = 0; i < n; i ++)
+      {
+        if (ev[i].evq)
+          evq_activate (ev[i].uptr, ev[i].delay);
+        else
+          sim_activate (ev[i].uptr, ev[i].delay);
+      }
+  }
+
+t_stat snapshot_register (DEVICE * dptr, uint32_t size, snapshot_get_fn get,
+                          snapshot_put_fn put)
+  {
+    int i;
+    for (i = 0; i < nDevs; i ++)
+      if (devs[i].dptr == dptr)
+        break;
+    if (i == nDevs && nDevs == (int) (sizeof (devs) / sizeof (devs[0])))
+      return SCPE_IERR;
+    uint32_t total = sizeof (snapDev) + DEV_PAD (size);
+    for (int j = 0; j < nDevs; j ++)
+      if (j != i)
+        total += sizeof (snapDev) + DEV_PAD (devs[j].size);
+    if (total > SNAPSHOT_DEV_MAX)
+      return SCPE_IERR;
+    devs[i].dptr = dptr;
+    devs[i].size = size;
+    devs[i].get = get;
+    devs[i].put = put;
+    if (i == nDevs)
+      nDevs ++;
+    return SCPE_OK;
+  }
+
+uint32_t snapshot_dev_size (void)
+  {
+    uint32_t sz = 0;
+    for (int i = 0; i < nDevs; i ++)
+      sz += sizeof (snapDev) + DEV_PAD (devs[i].size);
+    return sz;
+  }
+
+void snapshot_dev_get (uint8_t * buf)
+  {
+    for (int i = 0; i < nDevs; i ++)
+      {
+        snapDev * d = (snapDev *) buf;
+        memset (d, 0, sizeof (* d));
+        strncpy (d -> dev, devs[i].dptr -> name, sizeof (d -> dev) - 1);
+        d -> size = devs[i].size;
+        memset (buf + sizeof (* d), 0, DEV_PAD (devs[i].size));
+        devs[i].get (devs[i].dptr, buf + sizeof (* d));
+        buf += sizeof (* d) + DEV_PAD (devs[i].size);
+      }
+  }
+
+// Find the registered device of each block, in which[]; returns the count
+static int devCheck (const uint8_t * buf, uint32_t sz, int * which)
+  {
+    int n = 0;
+    for (uint32_t off = 0; off < sz; n ++)
+      {
+        const snapDev * d = (const snapDev *) (buf + off);
+        if (sz - off < sizeof (* d) || d -> size > SNAPSHOT_DEV_MAX ||
+            DEV_PAD (d -> size) > sz - off - sizeof (* d) ||
+            n == (int) (sizeof (devs) / sizeof (devs[0])))
+          return -1;
+        char name[sizeof (d -> dev) + 1];
+        memcpy (name, d -> dev, sizeof (d -> dev));
+        name[sizeof (d -> dev)] = 0;
+        int i;
+        for (i = 0; i < nDevs; i ++)
+          if (strcmp (devs[i].dptr -> name, name) == 0)
+            break;
+        if (i == nDevs || devs[i].size != d -> size)
+          {
+            sim_printf ("snapshot has %u bytes of state for device %s; "
+                        "need %u\n", d -> size, name,
+                        i == nDevs ? 0 : devs[i].size);
+            return -1;
+          }
+        which[n] = i;
+        off += (uint32_t) sizeof (* d) + DEV_PAD (d -> size);
+      }
+    return n;
+  }
+
+t_stat snapshot_dev_check (const uint8_t * buf, uint32_t sz)
+  {
+    int which [sizeof (devs) / sizeof (devs[0])];
+    return devCheck (buf, sz, which) < 0 ? SCPE_INCOMP : SCPE_OK;
+  }
+
+t_stat snapshot_dev_put (const uint8_t * buf, uint32_t sz)
+  {
+    int which [sizeof (devs) / sizeof (devs[0])];
+    int n = devCheck (buf, sz, which);
+    if (n < 0)
+      return SCPE_INCOMP;
+    for (int k = 0; k < n; k ++)
+      {
+        buf += sizeof (snapDev);
+        devs[which[k]].put (devs[which[k]].dptr, buf);
+        buf += DEV_PAD (devs[which[k]].size);
+      }
+    return SCPE_OK;
+  }
+
+t_stat snapshot_save (const char * path)
+  {
+    snapshot_event q[SNAPSHOT_MAX_EVENTS];
+    snapEvent ev[SNAPSHOT_MAX_EVENTS];
+    int nq = snapshot_get_events (q, SNAPSHOT_MAX_EVENTS);
+    if (nq < 0)
+      return SCPE_IERR;
+    uint32_t n = (uint32_t) nq;
+    for (uint32_t i = 0; i < n; i ++)
+      {
+        DEVICE * dptr = find_dev_from_unit (q[i].uptr);
+        if (! dptr)
+          return SCPE_IERR;
+        memset (& ev[i], 0, sizeof (ev[i]));
+        strncpy (ev[i].dev, dptr -> name, sizeof (ev[i].dev) - 1);
+        ev[i].unit = (uint32_t) (q[i].uptr - dptr -> units);
+        ev[i].delay = q[i].delay;
+        ev[i].queue = q[i].evq ? 1 : 0;
+      }
+
+    snapHdr h;
+    memset (& h, 0, sizeof (h));
+    memcpy (h.magic, SNAP_MAGIC, sizeof (h.magic));
+    h.version = SNAP_VERSION;
+    h.cpuSize = sizeof (cpu_t);
+    h.cpuOff = SNAP_ALIGN;
+    h.evOff = h.cpuOff + sizeof (cpu_t);
+    h.nEvents = n;
+    h.couplerState = coupler_get_state ();
+    h.devOff = (h.evOff + n * sizeof (snapEvent) + 7) & ~ (uint64_t) 7;
+    h.devSize = snapshot_dev_size ();
+    snapshot_dev_get (devBuf);
+
+    // Plain system calls, no stdio; this also runs in a forked child.
+    int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      return SCPE_OPENERR;
+    ssize_t evSz = (ssize_t) (n * sizeof (snapEvent));
+    bool ok = pwrite (fd, & h, sizeof (h), 0) == (ssize_t) sizeof (h) &&
+              pwrite (fd, & cpu, sizeof (cpu_t), (off_t) h.cpuOff) ==
+                (ssize_t) sizeof (cpu_t) &&
+              pwrite (fd, ev, (size_t) evSz, (off_t) h.evOff) == evSz &&
+              pwrite (fd, devBuf, h.devSize, (off_t) h.devOff) ==
+                (ssize_t) h.devSize;
+    if (close (fd))
+      ok = false;
+    return ok ? SCPE_OK : SCPE_IOERR;
+  }
+
+t_stat snapshot_restore (const char * path)
+  {
+    int fd = open (path, O_RDONLY);
+    if (fd < 0)
+      return SCPE_OPENERR;
+    struct stat sb;
+    if (fstat (fd, & sb) < 0 || (size_t) sb.st_size < sizeof (snapHdr))
+      {
+        close (fd);
+        return SCPE_IOERR;
+      }
+    size_t len = (size_t) sb.st_size;
+    uint8_t * p = mmap (NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (p == MAP_FAILED)
+      return SCPE_IOERR;
+
+    t_stat rc = SCPE_OK;
+    snapHdr * h = (snapHdr *) p;
+    if (memcmp (h -> magic, SNAP_MAGIC, sizeof (h -> magic)) != 0)
+      rc = SCPE_FMT;
+    else if (h -> version != SNAP_VERSION || h -> cpuSize != sizeof (cpu_t))
+      {
+        sim_printf ("snapshot is version %u, cpu %u bytes; need %u, %u\n",
+                    h -> version, h -> cpuSize, SNAP_VERSION,
+                    (uint32_t) sizeof (cpu_t));
+        rc = SCPE_INCOMP;
+      }
+    else if (h -> nEvents > SNAPSHOT_MAX_EVENTS ||
+             h -> evOff + h -> nEvents * sizeof (snapEvent) > len ||
+             h -> cpuOff + sizeof (cpu_t) > len ||
+             h -> devOff > len || h -> devSize > len - h -> devOff)
+      rc = SCPE_FMT;
+    if (rc != SCPE_OK)
+      goto done;
+
+    // Resolve every event before changing anything
+    snapEvent * ev = (snapEvent *) (p + h -> evOff);
+    snapshot_event q[SNAPSHOT_MAX_EVENTS];
+    for (uint32_t i = 0; i < h -> nEvents; i ++)
+      {
+        char name[sizeof (ev[i].dev) + 1];
+        memcpy (name, ev[i].dev, sizeof (ev[i].dev));
+        name[sizeof (ev[i].dev)] = 0;
+        DEVICE * dptr = find_dev (name);
+        if (! dptr || ev[i].unit >= dptr -> numunits)
+          {
+            sim_printf ("snapshot event for unknown unit %s%u\n", name,
+                        ev[i].unit);
+            rc = SCPE_INCOMP;
+            goto done;
+          }
+        q[i].uptr = dptr -> units + ev[i].unit;
+        q[i].delay = ev[i].delay;
+        q[i].evq = ev[i].queue == 1;
+      }
+
+    rc = snapshot_dev_check (p + h -> devOff, h -> devSize);
+    if (rc != SCPE_OK)
+      goto done;
+
+    memcpy (& cpu, p + h -> cpuOff, sizeof (cpu_t));
+    markAllDirty ();
+    coupler_set_state (h -> couplerState);
+    snapshot_dev_put (p + h -> devOff, h -> devSize);
+
+    snapshot_set_events (q, (int) h -> nEvents);
+
+done:
+    munmap (p, len);
+    return rc;
+  }
+
+t_stat snapshot_save_cmd (int32 flag, char * cptr)
+  {
+    char * args = cptr;
+    if ((cptr = get_sim_sw (cptr)) == NULL)
+      return SCPE_INVSW;
+    if (sim_switches & SWMASK ('S'))
+      return save_cmd (flag, args);
+    if (* cptr == 0)
+      return SCPE_2FARG;
+    sim_trim_endspc (cptr);
+    return snapshot_save (cptr);
+  }
+
+t_stat snapshot_restore_cmd (int32 flag, char * cptr)
+  {
+    char * args = cptr;
+    if ((cptr = get_sim_sw (cptr)) == NULL)
+      return SCPE_INVSW;
+    if (* cptr == 0)
+      return SCPE_2FARG;
+    sim_trim_endspc (cptr);
+    if (! isSnapshot (cptr))
+      return restore_cmd (flag, args);
+    return snapshot_restore (cptr);
+  }
@@ -0,0 +1,54 @@
+// Whole machine snapshots
+//
+// SAVE writes the CPU state and memory, the coupler task register, the
+// pending events and the registered device state (below) as a fixed layout
+// binary file that RESTORE maps and copies back in one pass, so an FNP can
+// be brought back to a booted state without repeating the bootload. SAVE -S
+// writes the standard simh format instead, and RESTORE falls back to it for
+// any file that is not a snapshot.
+
+t_stat snapshot_save_cmd (int32 flag, char * cptr);
+t_stat snapshot_restore_cmd (int32 flag, char * cptr);
+
+// Uses no stdio or allocation, so it may be called in a forked child
+t_stat snapshot_save (const char * path);
+t_stat snapshot_restore (const char * path);
+
+// The pending events, with their delays from now: SCP's, then those on
+// the line event queue (see evq.h)
+#define SNAPSHOT_MAX_EVENTS 1024
+
+typedef struct
+  {
+    UNIT * uptr;
+    int32 delay;
+    bool evq;
+  } snapshot_event;
+
+int snapshot_get_events (snapshot_event * ev, int max); // -1 if too many
+void snapshot_set_events (const snapshot_event * ev, int n);
+
+// Device state
+//
+// What a device keeps outside memory and its events, such as the lines an
+// adapter has been told to receive on, it registers at reset as a block of
+// fixed size, with functions to copy the block out and back. SAVE, CKPT and
+// REVERSE keep the blocks, and restore puts them back once memory is back
+// and before the events. Neither function may use stdio or allocate.
+
+#define SNAPSHOT_DEV_MAX 65536   // all the blocks, with their headers
+
+typedef void (* snapshot_get_fn) (DEVICE * dptr, void * buf);
+typedef void (* snapshot_put_fn) (DEVICE * dptr, const void * buf);
+
+// Registering a device again replaces its entry
+t_stat snapshot_register (DEVICE * dptr, uint32_t size, snapshot_get_fn get,
+                          snapshot_put_fn put);
+
+// The blocks as laid out in a snapshot file: the size, then copy them into
+// a buffer of that size. snapshot_dev_put checks every block, as
+// snapshot_dev_check does, before it puts any back.
+uint32_t snapshot_dev_size (void);
+void snapshot_dev_get (uint8_t * buf);
+t_stat snapshot_dev_check (const uint8_t * buf, uint32_t sz);
+t_stat snapshot_dev_put (const uint8_t * buf, uint32_t sz);
@@ -0,0 +1,505 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dn6600.h"
+#include "dn6600_caf.h"
+#include "sim_tape.h"
+#include "iom.h"
+#include "pack36.h"
+#include "snapshot.h"
+#include "tcu.h"
+#include "utils.h"
+
+#define TCU_MAXREC  65536               // bytes
+#define TCU_REGION  0540                // in the I/O communications region
+
+#define TCU_DBG_TAPE (1U << 8)
+
+// Command region, words from TCU_REGION
+enum
+  {
+    tcRecord = 0,
+    tcAddr = 1,
+    tcCount = 2,
+    tcStatus = 3,
+    tcRead = 4
+  };
+
+enum
+  {
+    tcDone     = 0400000,
+    tcMark     = 0200000,
+    tcIOErr    = 0100000,
+    tcNotReady = 0040000,
+    tcEnd      = 0020000,
+    tcLong     = 0010000
+  };
+
+enum
+  {
+    pcwRead = 01,
+    pcwRewind = 03,
+    pcwSeek = 04,
+    pcwForward = 05,
+    pcwBack = 06
+  };
+
+typedef struct
+  {
+    t_addr pos;
+    t_mtrlnt len;
+    bool mark;
+  } tcuRecord;
+
+static struct
+  {
+    tcuRecord * index;
+    uint32 recs, size;
+    t_addr end;        // where the indexed records end
+    bool whole;        // the index reaches the end of the medium
+    uint32 cur;        // record the tape is at
+    bool busy;
+    bool reading;
+    word18 status;     // of the command under way
+    t_mtrlnt bc;
+    uint8_t buf [TCU_MAXREC];
+    int32 chan;
+    int32 level;
+    int32 move;        // instructions a record passed
+    int32 xfer;        // instructions a byte read
+    int32 registered;  // channel claimed with the IOM, or -1
+    uint64_t reads, bytes, spaces, seeks, rewinds, passed;
+  } tcu =
+  {
+    .chan = 020,
+    .level = 7,
+    .move = 500,
+    .xfer = 20,
+    .registered = -1
+  };
+
+static UNIT tcuUnit = { UDATA (NULL, UNIT_ATTABLE | UNIT_ROABLE, 0) };
+
+static void post (word18 bits)
+  {
+    word18 st = tcDone | bits;
+    dmaToMemory (TCU_REGION + tcStatus, & st, 1);
+    iom_interrupt (tcu . level, 0);
+  }
+
+//
+// Record index
+//
+
+static bool indexAdd (t_addr pos, t_mtrlnt len, bool mark)
+  {
+    if (tcu . recs == tcu . size)
+      {
+        uint32 size = tcu . size ? 2 * tcu . size : 1024;
+        tcuRecord * p = realloc (tcu . index, size * sizeof (tcuRecord));
+        if (! p)
+          return false;
+        tcu . index = p;
+        tcu . size = size;
+      }
+    tcu . index[tcu . recs ++] = (tcuRecord) { pos, len, mark };
+    return true;
+  }
+
+// Walk the image once, by record headers
+static void indexBuild (UNIT * u)
+  {
+    tcu . recs = 0;
+    sim_tape_rewind (u);
+    for (;;)
+      {
+        t_addr pos = u -> pos;
+        t_mtrlnt bc = 0;
+        t_stat st = sim_tape_sprecf (u, & bc);
+        if ((st == MTSE_OK || st == MTSE_TMK) &&
+            indexAdd (pos, bc, st == MTSE_TMK))
+          continue;
+        tcu . end = pos;
+        tcu . whole = st == MTSE_EOM || st == MTSE_LEOT;
+        break;
+      }
+    sim_tape_rewind (u);
+    tcu . cur = 0;
+  }
+
+// Put the tape at record n of the index, or its end, as sim_tape_rewind
+// puts it at 0
+static void goTo (UNIT * u, uint32 n)
+  {
+    u -> pos = n < tcu . recs ? tcu . index[n] . pos : tcu . end;
+    MT_CLR_PNU (u);
+    tcu . passed += n > tcu . cur ? n - tcu . cur : tcu . cur - n;
+    tcu . cur = n;
+  }
+
+//
+// Commands
+//
+
+static t_stat tcuSvc (UNUSED UNIT * uptr)
+  {
+    if (! tcu . busy)
+      return SCPE_OK;
+    tcu . busy = false;
+    word18 n = 0;
+    if (tcu . reading && ! (tcu . status & (tcIOErr | tcEnd | tcMark)))
+      {
+        static word18 words [TCU_MAXREC * 4 / 9 + 4];
+        size_t n36 = 2 * (tcu . bc / 9) + (tcu . bc % 9 >= 5);
+        unpack36_18 (words, tcu . buf, n36);
+        word15 addr = (word15) (cpu . M[TCU_REGION + tcAddr] & BITS15);
+        unsigned count = cpu . M[TCU_REGION + tcCount] & BITS15;
+        n = (word18) (2 * n36);
+        if (n > count)
+          {
+            n = count;
+            tcu . status |= tcLong;
+          }
+        if (addr + n > MEM_SIZE)
+          n = MEM_SIZE - addr;
+        dmaToMemory (addr, words, n);
+      }
+    dmaToMemory (TCU_REGION + tcRead, & n, 1);
+    post (tcu . status);
+    return SCPE_OK;
+  }
+
+// Passing n records and reading bc bytes
+static void finish (uint32 n, t_mtrlnt bc)
+  {
+    int64_t t = (int64_t) n * tcu . move + (int64_t) bc * tcu . xfer;
+    sim_activate (& tcuUnit, t < 1 ? 1 : t > INT32_MAX ? INT32_MAX : (int32) t);
+  }
+
+// sim_tape's callback for a read or a space forward
+static void tcuMoved (UNIT * u, t_stat st)
+  {
+    switch (st)
+      {
+        case MTSE_OK:
+          break;
+        case MTSE_TMK:
+          tcu . status |= tcMark;
+          break;
+        case MTSE_EOM:
+        case MTSE_LEOT:
+          tcu . status |= tcEnd;
+          break;
+        default:
+          tcu . status |= tcIOErr;
+          break;
+      }
+    if (tcu . reading && st == MTSE_OK)
+      tcu . bytes += tcu . bc;
+    if (st == MTSE_OK || st == MTSE_TMK)
+      goTo (u, tcu . cur + 1);
+    else
+      goTo (u, tcu . cur);
+    finish (1, tcu . reading ? tcu . bc : 0);
+  }
+
+static void tcuConnect (UNUSED word6 chan, word36 pcw)
+  {
+    UNIT * u = & tcuUnit;
+    int cmd = (int) (pcw & 077);
+    if (tcu . busy)
+      {
+        sim_debug (DBG_DEBUG, & tcuDev, "busy\n");
+        return;
+      }
+    if (! (u -> flags & UNIT_ATT))
+      {
+        post (tcNotReady);
+        return;
+      }
+    tcu . busy = true;
+    tcu . status = 0;
+    tcu . reading = false;
+    tcu . bc = 0;
+    switch (cmd)
+      {
+        case pcwRead:
+          tcu . reads ++;
+          tcu . reading = true;
+          if (tcu . cur >= tcu . recs)
+            {
+              tcu . status = tcu . whole ? tcEnd : tcIOErr;
+              finish (0, 0);
+              break;
+            }
+          goTo (u, tcu . cur);
+          sim_tape_rdrecf_a (u, tcu . buf, & tcu . bc, TCU_MAXREC, tcuMoved);
+          break;
+
+        case pcwForward:
+          tcu . spaces ++;
+          if (tcu . cur >= tcu . recs)
+            {
+              tcu . status = tcu . whole ? tcEnd : tcIOErr;
+              finish (0, 0);
+              break;
+            }
+          goTo (u, tcu . cur);
+          sim_tape_sprecf_a (u, & tcu . bc, tcuMoved);
+          break;
+
+        case pcwBack:
+          tcu . spaces ++;
+          if (tcu . cur == 0)
+            tcu . status = tcEnd;
+          else
+            {
+              goTo (u, tcu . cur - 1);
+              if (tcu . index[tcu . cur] . mark)
+                tcu . status = tcMark;
+            }
+          finish (1, 0);
+          break;
+
+        case pcwRewind:
+          {
+            tcu . rewinds ++;
+            uint32 n = tcu . cur;
+            goTo (u, 0);
+            finish (n, 0);
+            break;
+          }
+
+        case pcwSeek:
+          {
+            tcu . seeks ++;
+            uint32 n = cpu . M[TCU_REGION + tcRecord];
+            if (n > tcu . recs)
+              {
+                tcu . status = tcu . whole ? tcEnd : tcIOErr;
+                n = tcu . recs;
+              }
+            uint32 d = n > tcu . cur ? n - tcu . cur : tcu . cur - n;
+            goTo (u, n);
+            finish (d, 0);
+            break;
+          }
+
+        default:
+          sim_debug (DBG_DEBUG, & tcuDev, "PCW %012llo?\n", (unsigned long long) pcw);
+          tcu . busy = false;
+          break;
+      }
+  }
+
+//
+// Device
+//
+
+// Snapshot state: where the tape is and the command under way. A read's
+// bytes are not kept; restore reads the record again.
+typedef struct
+  {
+    uint32_t cur, bc;
+    uint32_t status;
+    uint8_t busy, reading, pad[2];
+  } tcuState;
+
+static void tcuGet (UNUSED DEVICE * dptr, void * buf)
+  {
+    tcuState * st = buf;
+    st -> cur = tcu . cur;
+    st -> bc = tcu . bc;
+    st -> status = tcu . status;
+    st -> busy = tcu . busy;
+    st -> reading = tcu . reading;
+  }
+
+static void tcuPut (UNUSED DEVICE * dptr, const void * buf)
+  {
+    const tcuState * st = buf;
+    UNIT * u = & tcuUnit;
+    tcu . busy = st -> busy;
+    tcu . reading = st -> reading;
+    tcu . status = (word18) st -> status;
+    tcu . bc = st -> bc;
+    if (! (u -> flags & UNIT_ATT))
+      {
+        tcu . cur = 0;
+        tcu . status |= tcNotReady;
+        return;
+      }
+    uint32 cur = st -> cur <= tcu . recs ? st -> cur : tcu . recs;
+    if (tcu . busy && tcu . reading && ! (tcu . status & (tcIOErr | tcEnd | tcMark)))
+      {
+        t_mtrlnt bc = 0;
+        if (cur == 0 || cur != st -> cur)
+          tcu . status |= tcIOErr;
+        else
+          {
+            u -> pos = tcu . index[cur - 1] . pos;
+            MT_CLR_PNU (u);
+            if (sim_tape_rdrecf (u, tcu . buf, & bc, TCU_MAXREC) != MTSE_OK ||
+                bc != tcu . bc)
+              tcu . status |= tcIOErr;
+          }
+      }
+    tcu . cur = cur;
+    goTo (u, cur);
+  }
+
+static t_stat tcuReset (DEVICE * dptr)
+  {
+    tcuUnit . action = tcuSvc;
+    sim_cancel (& tcuUnit);
+    tcu . busy = false;
+    if (tcuUnit . flags & UNIT_ATT)
+      sim_tape_reset (& tcuUnit);
+    if (tcu . registered >= 0)
+      iom_unregister ((word6) tcu . registered);
+    tcu . registered = -1;
+    t_stat r = snapshot_register (dptr, sizeof (tcuState), tcuGet, tcuPut);
+    if (r != SCPE_OK || (dptr -> flags & DEV_DIS))
+      return r;
+    if (! iom_register ((word6) tcu . chan, tcuConnect))
+      {
+        sim_printf ("TCU: channel %o is in use\n", tcu . chan);
+        return SCPE_ARG;
+      }
+    tcu . registered = tcu . chan;
+    return SCPE_OK;
+  }
+
+static t_stat tcuAttach (UNIT * uptr, char * cptr)
+  {
+    t_stat r = sim_tape_attach_ex (uptr, cptr, TCU_DBG_TAPE, 0);
+    if (r != SCPE_OK)
+      return r;
+    indexBuild (uptr);
+    return SCPE_OK;
+  }
+
+static t_stat tcuDetach (UNIT * uptr)
+  {
+    if (! (uptr -> flags & UNIT_ATT))
+      return SCPE_OK;
+    sim_cancel (uptr);
+    tcu . busy = false;
+    free (tcu . index);
+    tcu . index = NULL;
+    tcu . recs = tcu . size = 0;
+    tcu . cur = 0;
+    return sim_tape_detach (uptr);
+  }
+
+//
+// SET and SHOW
+//
+
+static t_stat tcuSetChannel (UNUSED UNIT * uptr, UNUSED int32 value,
+                             char * cptr, UNUSED void * desc)
+  {
+    return setChannels (& tcuDev, & tcu . chan, 0, 077, 8, cptr);
+  }
+
+static t_stat tcuSetLevel (UNUSED UNIT * uptr, UNUSED int32 value,
+                           char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& tcu . level, 0, 15, 10, cptr);
+  }
+
+static t_stat tcuSetMove (UNUSED UNIT * uptr, UNUSED int32 value,
+                          char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& tcu . move, 0, 1000000, 10, cptr);
+  }
+
+static t_stat tcuSetXfer (UNUSED UNIT * uptr, UNUSED int32 value,
+                          char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& tcu . xfer, 0, 10000, 10, cptr);
+  }
+
+static t_stat tcuShowConfig (FILE * st, UNUSED UNIT * uptr, UNUSED int32 val,
+                             UNUSED void * desc)
+  {
+    fprintf (st, "channel=%o, level=%d, move=%d, xfer=%d", tcu . chan,
+             tcu . level, tcu . move, tcu . xfer);
+    return SCPE_OK;
+  }
+
+static t_stat tcuShowIndex (FILE * st, UNUSED UNIT * uptr, UNUSED int32 val,
+                            UNUSED void * desc)
+  {
+    uint32 marks = 0;
+    for (uint32 i = 0; i < tcu . recs; i ++)
+      marks += tcu . index[i] . mark;
+    fprintf (st, "%u records, %u of them tape marks, %s; at record %u\n",
+             tcu . recs, marks, tcu . whole ? "to the end" : "to a bad record",
+             tcu . cur);
+    return SCPE_OK;
+  }
+
+static t_stat tcuShowCounters (FILE * st, UNUSED UNIT * uptr,
+                               UNUSED int32 val, UNUSED void * desc)
+  {
+    fprintf (st, "%llu reads, %llu bytes; %llu spaces, %llu seeks, %llu rewinds; %llu records passed\n",
+             (unsigned long long) tcu . reads, (unsigned long long) tcu . bytes,
+             (unsigned long long) tcu . spaces, (unsigned long long) tcu . seeks,
+             (unsigned long long) tcu . rewinds, (unsigned long long) tcu . passed);
+    return SCPE_OK;
+  }
+
+static MTAB tcuMod [] =
+  {
+    { MTAB_XTD | MTAB_VUN, 0, "FORMAT", "FORMAT", sim_tape_set_fmt, sim_tape_show_fmt, NULL, "Image format" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "CHANNEL", tcuSetChannel, NULL, NULL, "IOM channel, octal" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "LEVEL", tcuSetLevel, NULL, NULL, "Interrupt level" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "MOVE", tcuSetMove, NULL, NULL, "Instructions a record passed" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "XFER", tcuSetXfer, NULL, NULL, "Instructions a byte read" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "CONFIG", NULL, NULL, tcuShowConfig, NULL, "Channel, level and timing" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "INDEX", NULL, NULL, tcuShowIndex, NULL, "The cassette's record index" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "COUNTERS", NULL, NULL, tcuShowCounters, NULL, "Commands and records passed" },
+    { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+  };
+
+static DEBTAB tcuDebug [] =
+  {
+    { "DEBUG", DBG_DEBUG },
+    { "TAPE", TCU_DBG_TAPE },
+    { "DATA", MTSE_DBG_DAT },
+    { "POS", MTSE_DBG_POS },
+    { "STR", MTSE_DBG_STR },
+    { NULL, 0 }
+  };
+
+DEVICE tcuDev =
+  {
+    "TCU",            /* name */
+    & tcuUnit,        /* units */
+    NULL,             /* registers */
+    tcuMod,           /* modifiers */
+    1,                /* #units */
+    10,               /* address radix */
+    31,               /* address width */
+    1,                /* address increment */
+    8,                /* data radix */
+    8,                /* data width */
+    NULL,             /* examine routine */
+    NULL,             /* deposit routine */
+    tcuReset,         /* reset routine */
+    NULL,             /* boot routine */
+    tcuAttach,        /* attach routine */
+    tcuDetach,        /* detach routine */
+    NULL,             /* context */
+    DEV_DISABLE | DEV_DEBUG | DEV_TAPE, /* flags */
+    0,                /* debug control flags */
+    tcuDebug,         /* debug flag names */
+    NULL,             /* memory size change */
+    NULL,             /* logical name */
+    NULL,             /* attach help */
+    NULL,             /* help */
+    NULL,             /* help context */
+    NULL,             /* device description */
+  };
@@ -0,0 +1,43 @@
+// TCU T&D cassette adaptor
+//
+// Device TCU, one cassette drive on a simh tape image (sim_tape): ATTACH
+// TCU <file>. A record's bytes are packed 36-bit words (see pack36.h),
+// which go into memory as 18-bit halves. The cassette is only read.
+//
+// At attach the image is walked once, reading only the record headers, for
+// an index of where each record and tape mark starts, so rewinding,
+// spacing back and going to record n take no further walks, however large
+// the image.
+//
+// The command region is the 010 words from 0540, in the I/O communications
+// region:
+//
+//   +000  record number, for a seek
+//   +001  memory address
+//   +002  word count
+//   +003  status
+//   +004  words read
+//
+// PCWs go to IOM channel CHANNEL (SET TCU CHANNEL=n, octal, default 020);
+// bits 30-35 are the command:
+//
+//   01  read the next record; words past the count are dropped
+//   03  rewind
+//   04  go to the record numbered at +000, counting tape marks, from 0
+//   05  space forward a record
+//   06  space back a record
+//
+// A command takes MOVE instructions a record the tape passes and, for a
+// read, XFER a byte (SET TCU MOVE=n, XFER=n). It then sets the status:
+//
+//   400000  done
+//   200000  a tape mark was read or passed
+//   100000  the image could not be read
+//   040000  no image attached
+//   020000  the end of the tape, or the start of it for a space back
+//   010000  the record was longer than the word count
+//
+// and sublevel 0 of interrupt level LEVEL (SET TCU LEVEL=n, default 7). A
+// command while one is under way is ignored.
+
+extern DEVICE tcuDev;
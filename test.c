@@ -1,11 +1,28 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
 
 #include "udplib.h"
+#include "shmlib.h"
 #include "ipc.h"
+#include "rlink.h"
+#include "pack36.h"
+#include "bootcache.h"
 
 // Emulate the Multics bootstrap sequence
+//
+//   test [-r] [-n] [-d] [link]
+//
+// link is given to udp_create, as for ATTACH COUPLER on the FNP (default
+// 4421:4431), or is shm:<name> to be the host side of a shared memory link
+// (ATTACH COUPLER shm:<name> on the FNP). -r frames the traffic with rlink, for an FNP with SET
+// COUPLER RELIABLE. Capabilities are traded first (see ipc.h), and word36
+// payloads are packed if the FNP offers it too; -n does not offer it. -d
+// sends the GICB as a delta boot (see bootcache.h): a manifest of block
+// digests, then only the blocks the FNP does not already hold.
 
 // Multics DMA's the following code into the FNP
 
@@ -352,15 +369,376 @@ static uint64_t gicb [TALLY] =
   };
 
 
+#define PKT_SZ 17000
+#define INQ 16
+#define WAIT_MS 30000
+#define BOOT_PCW 0100452000070 // the FNP only logs it
+#define GICB_ADDR 04000         // where a delta boot loads it
+
+static int udpLink;
+static bool shm; // udpLink is a shmlib link
+static rlink * rl;
+static bool offerPack = true;
+static bool delta;
+static int peerCaps = -1; // until the FNP announces
+static bool capsAgreed;    // the exchange has been acknowledged
+
+// Packets received, until the boot sequence takes them
+static struct
+  {
+    uint8_t data[PKT_SZ];
+    int sz;
+  } inq[INQ];
+static unsigned int inHead, inTail;
+
+static int ourCaps (void)
+  {
+    return offerPack ? capPack36 : 0;
+  }
+
+static int linkSend (uint8_t * data, int sz)
+  {
+    if (shm)
+      return dn_shm_send (udpLink, data, (uint16_t) sz);
+    return dn_udp_send (udpLink, data, (uint16_t) sz, PFLG_FINAL);
+  }
+
+// Framed like the data with -r, as on the FNP (see ipc.h); returns true
+// if the packet went
+static bool sendCaps (int kind)
+  {
+    uint8_t caps[capsSz] = { capsMagic, capsVersion, (uint8_t) ourCaps (), (uint8_t) kind };
+    if (rl)
+      return rlink_send_nowait (rl, caps, capsSz) == 0;
+    return linkSend (caps, capsSz) == 0;
+  }
+
+// Returns true if the packet was a capabilities packet, and consumes it
+static bool capsInput (uint8_t * data, int sz)
+  {
+    if (sz < capsSz || data[0] != capsMagic || data[1] != capsVersion)
+      return false;
+    peerCaps = data[2];
+    switch (data[3])
+      {
+        case capsAnnounce:
+          capsAgreed = false;
+          sendCaps (capsReply);
+          break;
+        case capsReply:
+          capsAgreed = sendCaps (capsAck);
+          break;
+        case capsAck:
+          capsAgreed = true;
+          break;
+      }
+    return true;
+  }
+
+static bool packed (void)
+  {
+    return capsAgreed && (ourCaps () & peerCaps & capPack36) != 0;
+  }
+
+static void enqueue (uint8_t * data, int sz)
+  {
+    if (capsInput (data, sz))
+      return;
+    if (inTail - inHead == INQ || sz > PKT_SZ)
+      {
+        printf ("dropped a packet of %d bytes\n", sz);
+        return;
+      }
+    memcpy (inq[inTail % INQ].data, data, (size_t) sz);
+    inq[inTail % INQ].sz = sz;
+    inTail ++;
+  }
+
+static void xmitFrame (void * ctx, uint8_t * frame, int sz)
+  {
+    (void) ctx;
+    int rc = dn_udp_send (udpLink, frame, (uint16_t) sz, PFLG_FINAL);
+    if (rc)
+      printf ("dn_udp_send returned %d\n", rc);
+  }
+
+static void deliver (void * ctx, uint8_t * data, int sz)
+  {
+    (void) ctx;
+    enqueue (data, sz);
+  }
+
+static int hostSend (uint8_t * data, int sz)
+  {
+    if (rl)
+      return rlink_send (rl, data, sz);
+    return linkSend (data, sz);
+  }
+
+// Take in whatever the link has, and keep rlink's acks and resends going
+static void service (void)
+  {
+    static uint8_t frame[RLINK_HDR_SZ + PKT_SZ];
+    int sz;
+    if (shm)
+      {
+        uint8_t * rec;
+        while ((sz = dn_shm_receive (udpLink, & rec, false)) > 0)
+          enqueue (rec, sz);
+        if (sz < 0)
+          printf ("dn_shm_receive returned %d\n", sz);
+        return;
+      }
+    while ((sz = dn_udp_receive (udpLink, frame, sizeof (frame))) > 0)
+      {
+        if (rl)
+          rlink_input (rl, frame, sz);
+        else
+          enqueue (frame, sz);
+      }
+    if (sz < 0)
+      printf ("dn_udp_receive returned %d\n", sz);
+    if (rl)
+      rlink_poll (rl);
+  }
+
+static void pause1ms (void)
+  {
+    struct timespec ts = { 0, 1000000 };
+    nanosleep (& ts, NULL);
+  }
+
+// Wait for a packet with the given command, dropping others; returns its
+// size, or 0 after WAIT_MS
+static int await (int cmd, uint8_t * * pktp)
+  {
+    static uint8_t pkt[PKT_SZ];
+    for (int ms = 0; ms < WAIT_MS; ms ++)
+      {
+        service ();
+        while (inHead != inTail)
+          {
+            int sz = inq[inHead % INQ].sz;
+            memcpy (pkt, inq[inHead % INQ].data, (size_t) sz);
+            inHead ++;
+            if (sz > 0 && pkt[0] == cmd)
+              {
+                * pktp = pkt;
+                return sz;
+              }
+            printf ("got cmd %u; expected %d\n", pkt[0], cmd);
+          }
+        pause1ms ();
+      }
+    return 0;
+  }
+
+static void put16 (uint8_t * p, uint32_t v)
+  {
+    p[0] = (uint8_t) (v >> 8);
+    p[1] = (uint8_t) v;
+  }
+
+static void put32 (uint8_t * p, uint32_t v)
+  {
+    put16 (p, v >> 16);
+    put16 (p + 2, v);
+  }
+
+// Send the GICB as a manifest, then the blocks the FNP asks for
+static bool deltaBoot (void)
+  {
+    enum { nblk = (TALLY + BC_WORDS - 1) / BC_WORDS };
+    static uint64_t blocks[nblk][BC_WORDS]; // the last padded with zeros
+    static uint8_t manifest[12 + BC_HASH_SZ * nblk];
+    memcpy (blocks, gicb, sizeof (gicb));
+    manifest[0] = BC_MAGIC;
+    manifest[1] = BC_MANIFEST;
+    put16 (manifest + 2, nblk);
+    put32 (manifest + 4, TALLY);
+    put32 (manifest + 8, GICB_ADDR);
+    for (int b = 0; b < nblk; b ++)
+      bootcache_hash (blocks[b], manifest + 12 + BC_HASH_SZ * b);
+    hostSend (manifest, sizeof (manifest));
+
+    uint8_t * pkt;
+    int sz;
+    while ((sz = await (BC_MAGIC, & pkt)) && (sz < 4 || pkt[1] != BC_NEED))
+      ;
+    if (! sz || sz < 4 + (nblk + 7) / 8)
+      {
+        printf ("no need list from the FNP\n");
+        return false;
+      }
+    int sent = 0;
+    for (int b = 0; b < nblk; b ++)
+      {
+        if (! (pkt[4 + b / 8] & (0200 >> (b % 8))))
+          continue;
+        uint8_t blk[4 + BC_WORDS * sizeof (uint64_t)];
+        size_t n;
+        blk[0] = BC_MAGIC;
+        blk[1] = BC_BLOCK;
+        put16 (blk + 2, (uint32_t) b);
+        if (packed ())
+          n = pack36 (blk + 4, blocks[b], BC_WORDS);
+        else
+          {
+            memcpy (blk + 4, blocks[b], sizeof (blocks[b]));
+            n = sizeof (blocks[b]);
+          }
+        hostSend (blk, (int) (4 + n));
+        sent ++;
+      }
+    printf ("delta boot: sent %d of %d blocks\n", sent, nblk);
+    return true;
+  }
+
+// Until everything sent has been acknowledged
+static void drain (void)
+  {
+    for (int ms = 0; rl && ms < WAIT_MS; ms ++)
+      {
+        service ();
+        if (rlink_timeout (rl) < 0)
+          return;
+        pause1ms ();
+      }
+  }
+
 int main (int argc, char * argv [])
   {
-    int link;
-    int ret = udp_create ("4421:4431", & link);
-    if (ret != 0)
+    const char * where = "4421:4431";
+    bool reliable = false;
+    for (int i = 1; i < argc; i ++)
+      {
+        if (strcmp (argv[i], "-r") == 0)
+          reliable = true;
+        else if (strcmp (argv[i], "-n") == 0)
+          offerPack = false;
+        else if (strcmp (argv[i], "-d") == 0)
+          delta = true;
+        else
+          where = argv[i];
+      }
+
+    int ret;
+    if (strncmp (where, "shm:", 4) == 0)
+      {
+        // rlink is for lossy links only, as on the FNP
+        if (reliable)
+          {
+            printf ("-r is for UDP links\n");
+            exit (1);
+          }
+        shm = true;
+        ret = shmlib_create (where + 4, shmSideHost, & udpLink);
+        if (ret != 0)
+          {
+            printf ("shmlib_create return %d\n", ret);
+            exit (1);
+          }
+      }
+    else
+      {
+        char buf[256];
+        snprintf (buf, sizeof (buf), "%s", where); // udp_create writes on it
+        ret = udp_create (buf, & udpLink);
+        if (ret != 0)
+          {
+            printf ("udp_create return %d\n", ret);
+            exit (1);
+          }
+      }
+    if (reliable)
+      {
+        rl = rlink_create (xmitFrame, deliver, NULL);
+        if (! rl)
+          {
+            printf ("rlink_create failed\n");
+            exit (1);
+          }
+      }
+
+    // Trade capabilities before any word36 goes out, until the exchange
+    // has been acknowledged one way or the other; an FNP that never
+    // answers gets 8 bytes a word. rlink delivers the announcement, so it
+    // is only repeated on a bare link.
+    for (int i = 0; i < 5 && ! capsAgreed; i ++)
+      {
+        if (i == 0 || ! rl)
+          sendCaps (capsAnnounce);
+        for (int ms = 0; ms < 200 && ! capsAgreed; ms ++)
+          {
+            service ();
+            pause1ms ();
+          }
+      }
+    printf ("word36 encoding: %s\n", packed () ? "packed" : "8 bytes");
+
+    // Bootload; the FNP answers with an Input Stored Boot IOLD. Packed,
+    // the PCW follows the command byte directly.
+    uint8_t bootPkt[sizeof (dn_bootload)];
+    int bootSz;
+    if (packed ())
+      {
+        uint64_t pcw = BOOT_PCW;
+        bootPkt[0] = dn_cmd_bootload;
+        bootSz = 1 + (int) pack36 (bootPkt + 1, & pcw, 1);
+      }
+    else
+      {
+        dn_bootload boot;
+        memset (& boot, 0, sizeof (boot));
+        boot.cmd = dn_cmd_bootload;
+        boot.dia_pcw = BOOT_PCW;
+        memcpy (bootPkt, & boot, sizeof (boot));
+        bootSz = sizeof (boot);
+      }
+    hostSend (bootPkt, bootSz);
+    uint8_t * pkt;
+    if (! await (dn_cmd_ISB_IOLD, & pkt))
       {
-        printf ("udp_create return %d\n", ret);
+        printf ("no Input Stored Boot from the FNP\n");
         exit (1);
       }
+
+    // Then the GICB
+    if (delta)
+      {
+        if (! deltaBoot ())
+          exit (1);
+      }
+    else
+      {
+        static uint8_t gicbPkt[1 + TALLY * sizeof (uint64_t)];
+        gicbPkt[0] = dn_cmd_buffer;
+        size_t n;
+        if (packed ())
+          n = pack36 (gicbPkt + 1, gicb, TALLY);
+        else
+          {
+            memcpy (gicbPkt + 1, gicb, sizeof (gicb));
+            n = sizeof (gicb);
+          }
+        hostSend (gicbPkt, (int) (1 + n));
+      }
+    drain ();
+    printf ("bootload sent\n");
+
+    if (rl)
+      {
+        rlink_stats st;
+        rlink_get_stats (rl, & st);
+        printf ("%llu frames sent, %llu resent, %llu syns; %llu delivered\n",
+                (unsigned long long) st.framesSent,
+                (unsigned long long) (st.retransmits + st.fastRetransmits),
+                (unsigned long long) st.synsSent, (unsigned long long) st.delivered);
+        rlink_destroy (rl);
+      }
+    if (shm)
+      shmlib_release (udpLink);
+    else
+      udp_release (udpLink);
     return 0;
   }
-
@@ -0,0 +1,193 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "dn6600.h"
+#include "dn6600_caf.h"
+#include "iom.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "timer.h"
+#include "utils.h"
+
+#define TIMER_TMR   0       // simh calibrated timer; the one lines coschedule on
+#define TIMER_RATE  1000    // ticks a second
+#define TIMER_INIT  10000   // instructions a tick, until calibrated
+#define TIMER_CELL  0450    // the first word after the fault vectors
+
+static struct
+  {
+    int32 rate;
+    int32 cell;
+    int32 level;
+    int32 sublevel;
+    int32 interval;    // instructions to the next tick
+    uint64_t ticks, interrupts, replayed;
+  } tm =
+  {
+    .rate = TIMER_RATE,
+    .cell = TIMER_CELL,
+    .level = 3,
+    .sublevel = 0,
+    .interval = TIMER_INIT
+  };
+
+static UNIT timerUnit = { UDATA (NULL, 0, 0) };
+
+static void tick (void)
+  {
+    tm . ticks ++;
+    word18 w [2] = { (cpu . M[tm . cell] + 1) & BITS18, cpu . M[tm . cell + 1] };
+    if (w[1])
+      {
+        if (-- w[1] == 0)
+          {
+            iom_interrupt (tm . level, tm . sublevel);
+            tm . interrupts ++;
+          }
+        dmaToMemory ((word15) tm . cell, w, 2);
+      }
+    else
+      dmaToMemory ((word15) tm . cell, w, 1);
+  }
+
+static t_stat timerSvc (UNIT * uptr)
+  {
+    if (rr_replaying ())
+      {
+        uint8_t * p;
+        int n = rr_take (rrTick, 0, & p, false);
+        if (n < 0)
+          {
+            // Not yet; wait for it
+            int64_t due = rr_due (rrTick, 0);
+            if (due > 0)
+              return sim_activate (uptr, (int32) due);
+          }
+        if (n == 4)
+          {
+            tm . interval = (int32) (((uint32) p[0] << 24) | ((uint32) p[1] << 16) |
+                                     ((uint32) p[2] << 8) | p[3]);
+            tm . replayed ++;
+          }
+      }
+    else
+      {
+        tm . interval = sim_rtcn_calb (tm . rate, TIMER_TMR);
+        uint8_t b [4] = { (uint8_t) (tm . interval >> 24), (uint8_t) (tm . interval >> 16),
+                          (uint8_t) (tm . interval >> 8), (uint8_t) tm . interval };
+        rr_record (rrTick, 0, b, 4);
+      }
+    tick ();
+    return sim_activate (uptr, tm . interval);
+  }
+
+// Snapshot state: the tick's length, which the pending tick was set from
+static void timerGet (UNUSED DEVICE * dptr, void * buf)
+  {
+    memcpy (buf, & tm . interval, sizeof (tm . interval));
+  }
+
+static void timerPut (UNUSED DEVICE * dptr, const void * buf)
+  {
+    memcpy (& tm . interval, buf, sizeof (tm . interval));
+  }
+
+static t_stat timerReset (DEVICE * dptr)
+  {
+    timerUnit . action = timerSvc;
+    sim_cancel (& timerUnit);
+    t_stat r = snapshot_register (dptr, sizeof (tm . interval), timerGet,
+                                  timerPut);
+    if (r != SCPE_OK || (dptr -> flags & DEV_DIS))
+      return r;
+    tm . interval = sim_rtcn_init_unit (& timerUnit, TIMER_INIT, TIMER_TMR);
+    return sim_activate (& timerUnit, tm . interval);
+  }
+
+//
+// SET and SHOW
+//
+
+static t_stat timerSetRate (UNUSED UNIT * uptr, UNUSED int32 value,
+                            char * cptr, UNUSED void * desc)
+  {
+    t_stat r = setNumber (& tm . rate, 1, 10000, 10, cptr);
+    return r != SCPE_OK ? r : timerReset (& timerDev);
+  }
+
+static t_stat timerSetCell (UNUSED UNIT * uptr, UNUSED int32 value,
+                            char * cptr, UNUSED void * desc)
+  {
+    // Not in the vectors, cells and fault words below it
+    return setNumber (& tm . cell, TIMER_CELL, MEM_SIZE - 2, 8, cptr);
+  }
+
+static t_stat timerSetLevel (UNUSED UNIT * uptr, UNUSED int32 value,
+                             char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& tm . level, 0, 15, 10, cptr);
+  }
+
+static t_stat timerSetSublevel (UNUSED UNIT * uptr, UNUSED int32 value,
+                                char * cptr, UNUSED void * desc)
+  {
+    return setNumber (& tm . sublevel, 0, 17, 10, cptr);
+  }
+
+static t_stat timerShowConfig (FILE * st, UNUSED UNIT * uptr, UNUSED int32 val,
+                               UNUSED void * desc)
+  {
+    fprintf (st, "rate=%d, cell=%o, level=%d, sublevel=%d", tm . rate, tm . cell,
+             tm . level, tm . sublevel);
+    return SCPE_OK;
+  }
+
+static t_stat timerShowCounters (FILE * st, UNUSED UNIT * uptr,
+                                 UNUSED int32 val, UNUSED void * desc)
+  {
+    fprintf (st, "%llu ticks, %llu replayed, %llu interrupts; %d instructions a tick\n",
+             (unsigned long long) tm . ticks, (unsigned long long) tm . replayed,
+             (unsigned long long) tm . interrupts, tm . interval);
+    return SCPE_OK;
+  }
+
+static MTAB timerMod [] =
+  {
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "RATE", timerSetRate, NULL, NULL, "Ticks a second" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "CELL", timerSetCell, NULL, NULL, "Address of the elapsed timer, octal, 0450 or above; the interval timer follows" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "LEVEL", timerSetLevel, NULL, NULL, "Interrupt level" },
+    { MTAB_XTD | MTAB_VDV | MTAB_VALR, 0, NULL, "SUBLEVEL", timerSetSublevel, NULL, NULL, "Interrupt sublevel" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "CONFIG", NULL, NULL, timerShowConfig, NULL, "Rate, cell, level and sublevel" },
+    { MTAB_XTD | MTAB_VDV | MTAB_NMO, 0, "COUNTERS", NULL, NULL, timerShowCounters, NULL, "Ticks and interrupts" },
+    { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
+  };
+
+DEVICE timerDev =
+  {
+    "TIMER",          /* name */
+    & timerUnit,      /* units */
+    NULL,             /* registers */
+    timerMod,         /* modifiers */
+    1,                /* #units */
+    10,               /* address radix */
+    1,                /* address width */
+    1,                /* address increment */
+    10,               /* data radix */
+    1,                /* data width */
+    NULL,             /* examine routine */
+    NULL,             /* deposit routine */
+    timerReset,       /* reset routine */
+    NULL,             /* boot routine */
+    NULL,             /* attach routine */
+    NULL,             /* detach routine */
+    NULL,             /* context */
+    DEV_DISABLE,      /* flags */
+    0,                /* debug control flags */
+    NULL,             /* debug flag names */
+    NULL,             /* memory size change */
+    NULL,             /* logical name */
+    NULL,             /* attach help */
+    NULL,             /* help */
+    NULL,             /* help context */
+    NULL,             /* device description */
+  };
@@ -0,0 +1,21 @@
+// Elapsed and interval timer
+//
+// Device TIMER is the FNP's clock: RATE ticks a second of wall time (SET
+// TIMER RATE=n, default 1000), calibrated by simh to the instruction rate,
+// so it costs the host one event a tick. Each tick it
+//
+//   adds one to the elapsed timer, the word at CELL (SET TIMER CELL=n,
+//   octal, default 0450; not below that, where the interrupt and fault
+//   vectors are), modulo 2^18
+//   counts down the interval timer, the word at CELL + 1, if the FNP has
+//   set it; when it reaches 0 it sets sublevel SUBLEVEL of interrupt level
+//   LEVEL (SET TIMER LEVEL=n, SUBLEVEL=n; default 3 and 0)
+//
+// The line adapters' polls are coscheduled with the tick, so they run just
+// after it rather than on events of their own; with the timer disabled
+// they poll every so many instructions instead.
+//
+// Ticks are recorded for replay (see replay.h), with the calibrated
+// interval to the next one, and replayed at the same instruction counts.
+
+extern DEVICE timerDev;
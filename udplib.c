@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sim_defs.h"
+#include "udplib.h"
+
+#define UDP_MAGIC    0x444e3636 // "DN66"
+#define UDP_HDR_SZ   12
+#define MAXLINKS     16
+#define BATCH_MAX    64 // datagrams per recvmmsg/sendmmsg
+
+static struct
+  {
+    bool used;
+    int sock;
+    struct sockaddr_storage remote;
+    socklen_t remoteLen;
+    uint32_t txSeq;
+  } udp_links[MAXLINKS];
+
+static void putHdr (uint8_t * h, uint32_t seq, uint16_t count, uint16_t flags)
+  {
+    uint32_t magic = htonl (UDP_MAGIC);
+    seq = htonl (seq);
+    count = htons (count);
+    flags = htons (flags);
+    memcpy (h, & magic, 4);
+    memcpy (h + 4, & seq, 4);
+    memcpy (h + 8, & count, 2);
+    memcpy (h + 10, & flags, 2);
+  }
+
+// Whether a datagram of sz bytes starting with header h is good
+static bool hdrOK (const uint8_t * h, int sz)
+  {
+    uint32_t magic;
+    uint16_t count;
+    memcpy (& magic, h, 4);
+    memcpy (& count, h + 8, 2);
+    return sz >= UDP_HDR_SZ && ntohl (magic) == UDP_MAGIC &&
+           ntohs (count) == sz - UDP_HDR_SZ;
+  }
+
+static bool validLink (int link)
+  {
+    return link >= 0 && link < MAXLINKS && udp_links[link].used;
+  }
+
+// "llll:rrrr" or "llll:[host]:rrrr"
+static int parse (const char * premote, char * lport, char * host, char * rport)
+  {
+    const char * c1 = strchr (premote, ':');
+    const char * c2 = strrchr (premote, ':');
+    if (! c1 || c1 == premote || ! c2[1] || c1 - premote >= 16 ||
+        strlen (c2 + 1) >= 16 || c2 - c1 > 256)
+      return -1;
+    snprintf (lport, 16, "%.*s", (int) (c1 - premote), premote);
+    if (c2 - c1 > 1)
+      snprintf (host, 256, "%.*s", (int) (c2 - c1 - 1), c1 + 1);
+    else
+      strcpy (host, "localhost");
+    strcpy (rport, c2 + 1);
+    return 0;
+  }
+
+int udp_create (const char * premote, int32_t * pln)
+  {
+    char lport[16], host[256], rport[16];
+    if (parse (premote, lport, host, rport))
+      return SCPE_ARG;
+
+    int link;
+    for (link = 0; link < MAXLINKS; link ++)
+      if (! udp_links[link].used)
+        break;
+    if (link == MAXLINKS)
+      return SCPE_IERR;
+
+    struct addrinfo hints, * res;
+    memset (& hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo (host, rport, & hints, & res))
+      return SCPE_ARG;
+
+    int s = socket (res -> ai_family, SOCK_DGRAM, 0);
+    if (s < 0)
+      {
+        freeaddrinfo (res);
+        return SCPE_OPENERR;
+      }
+    // Bound to the same family as the peer, on any address
+    struct sockaddr_storage local;
+    memset (& local, 0, sizeof (local));
+    char * end;
+    long lp = strtol (lport, & end, 10);
+    if (* end || lp <= 0 || lp > 65535)
+      {
+        close (s);
+        freeaddrinfo (res);
+        return SCPE_ARG;
+      }
+    if (res -> ai_family == AF_INET6)
+      {
+        struct sockaddr_in6 * a = (struct sockaddr_in6 *) & local;
+        a -> sin6_family = AF_INET6;
+        a -> sin6_addr = in6addr_any;
+        a -> sin6_port = htons ((uint16_t) lp);
+      }
+    else
+      {
+        struct sockaddr_in * a = (struct sockaddr_in *) & local;
+        a -> sin_family = AF_INET;
+        a -> sin_addr.s_addr = htonl (INADDR_ANY);
+        a -> sin_port = htons ((uint16_t) lp);
+      }
+    if (bind (s, (struct sockaddr *) & local, res -> ai_addrlen) ||
+        fcntl (s, F_SETFL, O_NONBLOCK))
+      {
+        close (s);
+        freeaddrinfo (res);
+        return SCPE_OPENERR;
+      }
+
+    udp_links[link].used = true;
+    udp_links[link].sock = s;
+    memcpy (& udp_links[link].remote, res -> ai_addr, res -> ai_addrlen);
+    udp_links[link].remoteLen = res -> ai_addrlen;
+    udp_links[link].txSeq = 0;
+    freeaddrinfo (res);
+    * pln = link;
+    return SCPE_OK;
+  }
+
+int udp_release (int link)
+  {
+    if (! validLink (link))
+      return -1;
+    close (udp_links[link].sock);
+    udp_links[link].used = false;
+    return 0;
+  }
+
+int udp_fd (int link)
+  {
+    return validLink (link) ? udp_links[link].sock : -1;
+  }
+
+int dn_udp_send (int link, uint8_t * pdata, uint16_t count, uint16_t flags)
+  {
+    if (! validLink (link))
+      return -1;
+    uint8_t hdr[UDP_HDR_SZ];
+    putHdr (hdr, udp_links[link].txSeq ++, count, flags);
+    struct iovec iov[2] = { { hdr, UDP_HDR_SZ }, { pdata, count } };
+    struct msghdr msg =
+      {
+        .msg_name = & udp_links[link].remote,
+        .msg_namelen = udp_links[link].remoteLen,
+        .msg_iov = iov,
+        .msg_iovlen = 2
+      };
+    ssize_t n = sendmsg (udp_links[link].sock, & msg, 0);
+    // A peer that is not listening yet is the same as a lost datagram
+    if (n < 0 && errno == ECONNREFUSED)
+      return 0;
+    return n == UDP_HDR_SZ + count ? 0 : -1;
+  }
+
+int dn_udp_receive (int link, uint8_t * pdata, uint16_t maxbuf)
+  {
+    if (! validLink (link))
+      return -1;
+    for (;;)
+      {
+        uint8_t hdr[UDP_HDR_SZ];
+        struct iovec iov[2] = { { hdr, UDP_HDR_SZ }, { pdata, maxbuf } };
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+        ssize_t n = recvmsg (udp_links[link].sock, & msg, 0);
+        if (n < 0)
+          return errno == EAGAIN || errno == EWOULDBLOCK ||
+                 errno == ECONNREFUSED || errno == EINTR ? 0 : -1;
+        if (! (msg.msg_flags & MSG_TRUNC) && hdrOK (hdr, (int) n))
+          return (int) n - UDP_HDR_SZ;
+      }
+  }
+
+#ifdef __linux__
+int dn_udp_receive_many (int link, uint8_t * * bufs, uint16_t maxbuf, int * szs, int n)
+  {
+    if (! validLink (link))
+      return -1;
+    if (n > BATCH_MAX)
+      n = BATCH_MAX;
+    uint8_t hdrs[BATCH_MAX][UDP_HDR_SZ];
+    struct iovec iov[BATCH_MAX][2];
+    struct mmsghdr msgs[BATCH_MAX];
+    memset (msgs, 0, sizeof (struct mmsghdr) * (size_t) n);
+    for (int i = 0; i < n; i ++)
+      {
+        iov[i][0] = (struct iovec) { hdrs[i], UDP_HDR_SZ };
+        iov[i][1] = (struct iovec) { bufs[i], maxbuf };
+        msgs[i].msg_hdr.msg_iov = iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+      }
+    int got = recvmmsg (udp_links[link].sock, msgs, (unsigned int) n, 0, NULL);
+    if (got < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK ||
+             errno == ECONNREFUSED || errno == EINTR ? 0 : -1;
+    for (int i = 0; i < got; i ++)
+      {
+        int sz = (int) msgs[i].msg_len;
+        szs[i] = ! (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) && hdrOK (hdrs[i], sz) ?
+                 sz - UDP_HDR_SZ : 0;
+      }
+    return got;
+  }
+
+int dn_udp_send_many (int link, uint8_t * * bufs, const uint16_t * counts, int n, uint16_t flags)
+  {
+    if (! validLink (link))
+      return -1;
+    while (n > 0)
+      {
+        int m = n < BATCH_MAX ? n : BATCH_MAX;
+        uint8_t hdrs[BATCH_MAX][UDP_HDR_SZ];
+        struct iovec iov[BATCH_MAX][2];
+        struct mmsghdr msgs[BATCH_MAX];
+        memset (msgs, 0, sizeof (struct mmsghdr) * (size_t) m);
+        for (int i = 0; i < m; i ++)
+          {
+            putHdr (hdrs[i], udp_links[link].txSeq ++, counts[i], flags);
+            iov[i][0] = (struct iovec) { hdrs[i], UDP_HDR_SZ };
+            iov[i][1] = (struct iovec) { bufs[i], counts[i] };
+            msgs[i].msg_hdr.msg_name = & udp_links[link].remote;
+            msgs[i].msg_hdr.msg_namelen = udp_links[link].remoteLen;
+            msgs[i].msg_hdr.msg_iov = iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 2;
+          }
+        int sent = sendmmsg (udp_links[link].sock, msgs, (unsigned int) m, 0);
+        if (sent < 0 && errno == ECONNREFUSED)
+          sent = 1; // lost, as in dn_udp_send
+        else if (sent <= 0)
+          return -1;
+        bufs += sent;
+        counts += sent;
+        n -= sent;
+      }
+    return 0;
+  }
+#else
+int dn_udp_receive_many (int link, uint8_t * * bufs, uint16_t maxbuf, int * szs, int n)
+  {
+    int got;
+    for (got = 0; got < n; got ++)
+      {
+        int sz = dn_udp_receive (link, bufs[got], maxbuf);
+        if (sz < 0)
+          return got ? got : -1;
+        if (! sz)
+          break;
+        szs[got] = sz;
+      }
+    return got;
+  }
+
+int dn_udp_send_many (int link, uint8_t * * bufs, const uint16_t * counts, int n, uint16_t flags)
+  {
+    for (int i = 0; i < n; i ++)
+      if (dn_udp_send (link, bufs[i], counts[i], flags))
+        return -1;
+    return 0;
+  }
+#endif
@@ -0,0 +1,58 @@
+// UDP coupler transport
+//
+// A link is a UDP socket bound to a local port, sending to the peer's:
+//
+//   ATTACH COUPLER <local port>:[<host>:]<remote port>
+//
+// the host being localhost if it is left out or empty (6632::4500). Each
+// datagram carries a 12 byte header ahead of the data, in network byte
+// order:
+//
+//   0- 3  magic ("DN66")
+//   4- 7  the sender's datagram count, from 0 at udp_create
+//   8- 9  the number of data bytes
+//  10-11  flags (PFLG_)
+//
+// Datagrams with another magic or a count that does not match their size
+// are dropped. Receives never block; a caller that wants to wait polls the
+// link's socket (udp_fd).
+
+#include <stdint.h>
+
+#define NOLINK (-1)
+
+#define PFLG_FINAL 00001  // the last datagram of a transfer
+
+enum { dn_cmd_bootload = 1, dn_cmd_ISB_IOLD = 2, dn_cmd_buffer = 3 };
+
+typedef struct
+  {
+    uint8_t cmd;
+    uint64_t dia_pcw;
+  } dn_bootload;
+
+typedef struct
+  {
+    uint8_t cmd;
+  } dn_ids_iold;
+
+// Returns an SCP status; the link number in * pln
+int udp_create (const char * premote, int32_t * pln);
+int udp_release (int link);
+
+// The socket, for poll(); the link still owns it
+int udp_fd (int link);
+
+// Returns 0, or -1 if the datagram could not be sent
+int dn_udp_send (int link, uint8_t * pdata, uint16_t count, uint16_t flags);
+
+// Returns the size of the next datagram, copied to pdata; 0 if none is
+// waiting, or -1 on an error
+int dn_udp_receive (int link, uint8_t * pdata, uint16_t maxbuf);
+
+// Batched forms, a single recvmmsg/sendmmsg on Linux. Receive takes up to n
+// waiting datagrams into bufs, each of maxbuf bytes, and returns how many
+// it took (0 if none, -1 on an error); szs has their sizes, 0 for one that
+// was dropped. Send returns 0, or -1 if a datagram could not be sent.
+int dn_udp_receive_many (int link, uint8_t * * bufs, uint16_t maxbuf, int * szs, int n);
+int dn_udp_send_many (int link, uint8_t * * bufs, const uint16_t * counts, int n, uint16_t flags);
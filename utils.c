@@ -362,3 +362,36 @@ void cmp18(word18 oP1, word18 oP2, word18 *flags)
       }
   }
 
+
+/*
+ * SET helpers for the devices
+ */
+
+// Set * p from cptr, read in radix, if it is within lo..hi
+t_stat setNumber (int32 * p, int32 lo, int32 hi, int radix, char * cptr)
+  {
+    t_stat r;
+    if (! cptr)
+      return SCPE_ARG;
+    int32 n = (int32) get_uint (cptr, radix, (t_value) hi, & r);
+    if (r != SCPE_OK)
+      return r;
+    if (n < lo)
+      return SCPE_ARG;
+    * p = n;
+    return SCPE_OK;
+  }
+
+// A setting that moves the device's IOM channels: the device is reset to
+// claim them, and the old value put back if they are taken
+t_stat setChannels (DEVICE * dptr, int32 * p, int32 lo, int32 hi, int radix,
+                    char * cptr)
+  {
+    int32 old = * p;
+    t_stat r = setNumber (p, lo, hi, radix, cptr);
+    if (r != SCPE_OK || (r = dptr -> reset (dptr)) == SCPE_OK)
+      return r;
+    * p = old;
+    dptr -> reset (dptr);
+    return r;
+  }
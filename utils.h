@@ -4,3 +4,7 @@ word36 Add18b (word18 op1, word18 op2, word1 carryin, word18 flagsToSet, word18
 word18 Sub18b (word18 op1, word18 op2, word1 carryin, word18 flagsToSet, word18 * flags, bool * ovf);
 void cmp18 (word18 oP1, word18 oP2, word18 * flags);
 
+
+t_stat setNumber (int32 * p, int32 lo, int32 hi, int radix, char * cptr);
+t_stat setChannels (DEVICE * dptr, int32 * p, int32 lo, int32 hi, int radix,
+                    char * cptr);
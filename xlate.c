@@ -0,0 +1,132 @@
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+
+#include "xlate.h"
+
+// EBCDIC, code page 037, for the characters ASCII has
+static const uint8_t ebcdicPairs [] [2] =
+  {
+    // EBCDIC, ASCII
+    { 0x00, 0x00 }, { 0x01, 0x01 }, { 0x02, 0x02 }, { 0x03, 0x03 },
+    { 0x37, 0x04 }, { 0x2d, 0x05 }, { 0x2e, 0x06 }, { 0x2f, 0x07 },
+    { 0x16, 0x08 }, { 0x05, 0x09 }, { 0x25, 0x0a }, { 0x0b, 0x0b },
+    { 0x0c, 0x0c }, { 0x0d, 0x0d }, { 0x0e, 0x0e }, { 0x0f, 0x0f },
+    { 0x10, 0x10 }, { 0x11, 0x11 }, { 0x12, 0x12 }, { 0x13, 0x13 },
+    { 0x3c, 0x14 }, { 0x3d, 0x15 }, { 0x32, 0x16 }, { 0x26, 0x17 },
+    { 0x18, 0x18 }, { 0x19, 0x19 }, { 0x3f, 0x1a }, { 0x27, 0x1b },
+    { 0x1c, 0x1c }, { 0x1d, 0x1d }, { 0x1e, 0x1e }, { 0x1f, 0x1f },
+    { 0x40, ' ' }, { 0x5a, '!' }, { 0x7f, '"' }, { 0x7b, '#' },
+    { 0x5b, '$' }, { 0x6c, '%' }, { 0x50, '&' }, { 0x7d, '\'' },
+    { 0x4d, '(' }, { 0x5d, ')' }, { 0x5c, '*' }, { 0x4e, '+' },
+    { 0x6b, ',' }, { 0x60, '-' }, { 0x4b, '.' }, { 0x61, '/' },
+    { 0x7a, ':' }, { 0x5e, ';' }, { 0x4c, '<' }, { 0x7e, '=' },
+    { 0x6e, '>' }, { 0x6f, '?' }, { 0x7c, '@' }, { 0xba, '[' },
+    { 0xe0, '\\' }, { 0xbb, ']' }, { 0xb0, '^' }, { 0x6d, '_' },
+    { 0x79, '`' }, { 0xc0, '{' }, { 0x4f, '|' }, { 0xd0, '}' },
+    { 0xa1, '~' }, { 0x07, 0x7f }
+  };
+
+// GE BCD, by code
+static const char bcd [64] =
+  "0123456789[#@:>? ABCDEFGHI&.](<\\^JKLMNOPQR-$*);'+/STUVWXYZ_,%=\"!";
+
+static uint8_t tables [xlateKinds] [2] [256];
+
+static void build (void)
+  {
+    static bool built = false;
+    if (built)
+      return;
+    uint8_t (* t) [256];
+
+    t = tables[xlateEBCDIC];
+    memset (t[0], 0x1a, 256);  // SUB
+    memset (t[1], 0x3f, 256);
+    for (size_t i = 0; i < sizeof (ebcdicPairs) / sizeof (ebcdicPairs[0]); i ++)
+      {
+        t[0][ebcdicPairs[i][0]] = ebcdicPairs[i][1];
+        t[1][ebcdicPairs[i][1]] = ebcdicPairs[i][0];
+      }
+    for (int i = 0; i < 26; i ++)
+      {
+        uint8_t e = (uint8_t) (i < 9 ? i : i < 18 ? i + 7 : i + 15);
+        t[0][0xc1 + e] = (uint8_t) ('A' + i);
+        t[0][0x81 + e] = (uint8_t) ('a' + i);
+        t[1]['A' + i] = (uint8_t) (0xc1 + e);
+        t[1]['a' + i] = (uint8_t) (0x81 + e);
+      }
+    for (int i = 0; i < 10; i ++)
+      {
+        t[0][0xf0 + i] = (uint8_t) ('0' + i);
+        t[1]['0' + i] = (uint8_t) (0xf0 + i);
+      }
+
+    t = tables[xlateBCD];
+    memset (t[0], '?', 256);
+    memset (t[1], 017, 256);    // '?'
+    for (int i = 0; i < 64; i ++)
+      {
+        t[0][i] = (uint8_t) bcd[i];
+        t[1][(uint8_t) bcd[i]] = (uint8_t) i;
+      }
+    for (int i = 0; i < 26; i ++)
+      t[1]['a' + i] = t[1]['A' + i];
+
+    t = tables[xlateUpper];
+    for (int i = 0; i < 256; i ++)
+      t[0][i] = t[1][i] = (uint8_t) (i >= 'a' && i <= 'z' ? i - 'a' + 'A' : i);
+
+    built = true;
+  }
+
+const uint8_t * xlate_in (int kind)
+  {
+    if (kind <= xlateASCII || kind >= xlateKinds)
+      return NULL;
+    build ();
+    return tables[kind][0];
+  }
+
+const uint8_t * xlate_out (int kind)
+  {
+    if (kind <= xlateASCII || kind >= xlateKinds)
+      return NULL;
+    build ();
+    return tables[kind][1];
+  }
+
+// Byte lookups have no vector form short of AVX-512 VBMI, so the loop is
+// unrolled for the loads to overlap
+void xlate (const uint8_t * table, uint8_t * buf, size_t n)
+  {
+    if (! table)
+      return;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+      {
+        uint8_t a = table[buf[i]], b = table[buf[i + 1]];
+        uint8_t c = table[buf[i + 2]], d = table[buf[i + 3]];
+        uint8_t e = table[buf[i + 4]], f = table[buf[i + 5]];
+        uint8_t g = table[buf[i + 6]], h = table[buf[i + 7]];
+        buf[i] = a; buf[i + 1] = b; buf[i + 2] = c; buf[i + 3] = d;
+        buf[i + 4] = e; buf[i + 5] = f; buf[i + 6] = g; buf[i + 7] = h;
+      }
+    for (; i < n; i ++)
+      buf[i] = table[buf[i]];
+  }
+
+static const char * names [xlateKinds] = { "ASCII", "EBCDIC", "BCD", "UPPER" };
+
+int xlate_find (const char * name)
+  {
+    for (int i = 0; i < xlateKinds; i ++)
+      if (strcasecmp (name, names[i]) == 0)
+        return i;
+    return -1;
+  }
+
+const char * xlate_name (int kind)
+  {
+    return kind >= 0 && kind < xlateKinds ? names[kind] : "?";
+  }
@@ -0,0 +1,29 @@
+// Character set translation for line devices
+//
+// A line whose terminal or host does not speak ASCII has its characters
+// translated on the way in, before they go into FNP memory, and on the way
+// out, after they come from it, a whole buffer at a time, so the FNP
+// handles ASCII whatever the line carries:
+//
+//   ASCII   as they are
+//   EBCDIC  EBCDIC (code page 037) on the line; characters it lacks become
+//           SUB
+//   BCD     GE 6-bit BCD on the line; lower case goes out as upper
+//   UPPER   ASCII, lower case folded to upper both ways, for terminals
+//           that have none
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum { xlateASCII, xlateEBCDIC, xlateBCD, xlateUpper, xlateKinds };
+
+// Tables from the line and to it; NULL for xlateASCII
+const uint8_t * xlate_in (int kind);
+const uint8_t * xlate_out (int kind);
+
+// Translate n characters in place; a NULL table leaves them
+void xlate (const uint8_t * table, uint8_t * buf, size_t n);
+
+// By name, or -1
+int xlate_find (const char * name);
+const char * xlate_name (int kind);